@@ -14,6 +14,11 @@
  *    Ian Craggs - initial contribution
  *******************************************************************************/
 
+// Publishes PAYLOAD once, behind a latency probe header (see probe_clock.h)
+// so that MQTTAsync_subscribe can report how long it took to arrive.
+
+#include "probe_clock.h"
+#include "reconnect_backoff.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -35,21 +40,31 @@
 #define PAYLOAD     "Hello World!"
 #define QOS         1
 #define TIMEOUT     10000L
+#define PUBLISHER_ID 2
+#define RECONNECT_INITIAL_MS 100
+#define RECONNECT_MAX_MS     10000
 
 int finished = 0;
+reconnect_backoff backoff;
 
-void connlost(void *context, char *cause)
+void onConnect(void* context, MQTTAsync_successData* response);
+void onConnectFailure(void* context, MQTTAsync_failureData* response);
+
+// Called on the client's thread after a lost connection or a failed
+// reconnect: waits out the backoff delay, then tries again.
+void reconnect(MQTTAsync client)
 {
-	MQTTAsync client = (MQTTAsync)context;
 	MQTTAsync_connectOptions conn_opts = MQTTAsync_connectOptions_initializer;
+	int64_t delay = reconnect_backoff_next(&backoff);
 	int rc;
 
-	printf("\nConnection lost\n");
-	printf("     cause: %s\n", cause);
-
-	printf("Reconnecting\n");
+	printf("Reconnecting in %lld ms\n", (long long)delay);
+	reconnect_backoff_sleep(delay);
 	conn_opts.keepAliveInterval = 20;
 	conn_opts.cleansession = 1;
+	conn_opts.onSuccess = onConnect;
+	conn_opts.onFailure = onConnectFailure;
+	conn_opts.context = client;
 	if ((rc = MQTTAsync_connect(client, &conn_opts)) != MQTTASYNC_SUCCESS)
 	{
 		printf("Failed to start connect, return code %d\n", rc);
@@ -57,6 +72,13 @@ void connlost(void *context, char *cause)
 	}
 }
 
+void connlost(void *context, char *cause)
+{
+	printf("\nConnection lost\n");
+	printf("     cause: %s\n", cause);
+	reconnect((MQTTAsync)context);
+}
+
 void onDisconnectFailure(void* context, MQTTAsync_failureData* response)
 {
 	printf("Disconnect failed\n");
@@ -107,7 +129,11 @@ void onSend(void* context, MQTTAsync_successData* response)
 void onConnectFailure(void* context, MQTTAsync_failureData* response)
 {
 	printf("Connect failed, rc %d\n", response ? response->code : 0);
-	finished = 1;
+	// Only the first connect gives up; a lost connection is retried.
+	if (backoff.attempts > 0)
+		reconnect((MQTTAsync)context);
+	else
+		finished = 1;
 }
 
 
@@ -116,14 +142,23 @@ void onConnect(void* context, MQTTAsync_successData* response)
 	MQTTAsync client = (MQTTAsync)context;
 	MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
 	MQTTAsync_message pubmsg = MQTTAsync_message_initializer;
+	probe_header h;
+	char buf[PROBE_HEADER_SIZE + sizeof(PAYLOAD) - 1];
 	int rc;
 
 	printf("Successful connection\n");
+	reconnect_backoff_reset(&backoff);
+	h.publisher_id = PUBLISHER_ID;
+	h.seq = 0;
+	h.clock = PROBE_CLOCK_MONOTONIC;
+	h.send_ns = probe_monotonic_ns();
+	probe_encode(buf, &h);
+	memcpy(buf + PROBE_HEADER_SIZE, PAYLOAD, sizeof(PAYLOAD) - 1);
 	opts.onSuccess = onSend;
 	opts.onFailure = onSendFailure;
 	opts.context = client;
-	pubmsg.payload = PAYLOAD;
-	pubmsg.payloadlen = (int)strlen(PAYLOAD);
+	pubmsg.payload = buf;
+	pubmsg.payloadlen = (int)sizeof(buf);
 	pubmsg.qos = QOS;
 	pubmsg.retained = 0;
 	if ((rc = MQTTAsync_sendMessage(client, TOPIC, &pubmsg, &opts)) != MQTTASYNC_SUCCESS)
@@ -151,12 +186,13 @@ int main(int argc, char* argv[])
 		exit(EXIT_FAILURE);
 	}
 
-	if ((rc = MQTTAsync_setCallbacks(client, NULL, connlost, messageArrived, NULL)) != MQTTASYNC_SUCCESS)
+	if ((rc = MQTTAsync_setCallbacks(client, client, connlost, messageArrived, NULL)) != MQTTASYNC_SUCCESS)
 	{
 		printf("Failed to set callback, return code %d\n", rc);
 		exit(EXIT_FAILURE);
 	}
 
+	reconnect_backoff_init(&backoff, RECONNECT_INITIAL_MS, RECONNECT_MAX_MS);
 	conn_opts.keepAliveInterval = 20;
 	conn_opts.cleansession = 1;
 	conn_opts.onSuccess = onConnect;
@@ -17,9 +17,18 @@
 
 // This is a somewhat contrived example to show an application that publishes
 // continuously, like a data acquisition app might do. In this case, though,
-// we don't have a sensor to read, so we use the system time as the number
-// of milliseconds since the epoch to simulate a data input.
-
+// we don't have a sensor to read, so we publish a latency probe (see
+// probe_clock.h) stamped with the current time to simulate a data input.
+//
+// Usage: MQTTAsync_publish_time [--realtime]
+//
+// Probes are stamped with the monotonic clock, which MQTTAsync_subscribe can
+// compare against on the same host; --realtime stamps wall clock time for a
+// subscriber elsewhere. Either way the publisher answers clock sync requests
+// on SYNC_TOPIC, so a subscriber can measure the offset between the clocks.
+
+#include "probe_clock.h"
+#include "reconnect_backoff.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -48,25 +57,38 @@
 
 #define CLIENTID        "ExampleClientTimePub"
 #define TOPIC           "hello_mqtt"
+#define SYNC_TOPIC      "hello_mqtt/sync"
+#define SYNC_REPLY_TOPIC "hello_mqtt/sync/reply"
 #define QOS             1
 #define TIMEOUT         10000L
 #define SAMPLE_PERIOD   1000L    // in ms
+#define PUBLISHER_ID    1
+#define RECONNECT_INITIAL_MS 100
+#define RECONNECT_MAX_MS     10000
 
 volatile int finished = 0;
 volatile int connected = 0;
+probe_clock_id probe_clock = PROBE_CLOCK_MONOTONIC;
+reconnect_backoff backoff;
 
-void connlost(void *context, char *cause)
+void onConnect(void* context, MQTTAsync_successData* response);
+void onConnectFailure(void* context, MQTTAsync_failureData* response);
+
+// Called on the client's thread after a lost connection or a failed
+// reconnect: waits out the backoff delay, then tries again.
+void reconnect(MQTTAsync client)
 {
-	MQTTAsync client = (MQTTAsync)context;
 	MQTTAsync_connectOptions conn_opts = MQTTAsync_connectOptions_initializer;
+	int64_t delay = reconnect_backoff_next(&backoff);
 	int rc;
 
-	printf("\nConnection lost\n");
-	printf("     cause: %s\n", cause);
-
-	printf("Reconnecting\n");
+	printf("Reconnecting in %lld ms\n", (long long)delay);
+	reconnect_backoff_sleep(delay);
 	conn_opts.keepAliveInterval = 20;
 	conn_opts.cleansession = 1;
+	conn_opts.onSuccess = onConnect;
+	conn_opts.onFailure = onConnectFailure;
+	conn_opts.context = client;
 	if ((rc = MQTTAsync_connect(client, &conn_opts)) != MQTTASYNC_SUCCESS)
 	{
 		printf("Failed to start connect, return code %d\n", rc);
@@ -74,6 +96,14 @@ void connlost(void *context, char *cause)
 	}
 }
 
+void connlost(void *context, char *cause)
+{
+	connected = 0;
+	printf("\nConnection lost\n");
+	printf("     cause: %s\n", cause);
+	reconnect((MQTTAsync)context);
+}
+
 void onDisconnectFailure(void* context, MQTTAsync_failureData* response)
 {
 	printf("Disconnect failed\n");
@@ -112,34 +142,46 @@ void onSend(void* context, MQTTAsync_successData* response)
 void onConnectFailure(void* context, MQTTAsync_failureData* response)
 {
 	printf("Connect failed, rc %d\n", response ? response->code : 0);
-	finished = 1;
+	// Only the first connect gives up; a lost connection is retried.
+	if (backoff.attempts > 0)
+		reconnect((MQTTAsync)context);
+	else
+		finished = 1;
 }
 
 
 void onConnect(void* context, MQTTAsync_successData* response)
 {
+	MQTTAsync client = (MQTTAsync)context;
+	int rc;
+
 	printf("Successful connection\n");
+	reconnect_backoff_reset(&backoff);
+	if ((rc = MQTTAsync_subscribe(client, SYNC_TOPIC, 0, NULL)) != MQTTASYNC_SUCCESS)
+		printf("Failed to subscribe to %s, return code %d\n", SYNC_TOPIC, rc);
 	connected = 1;
 }
 
+// Clock sync requests: stamp receipt and reply time, and echo the request.
 int messageArrived(void* context, char* topicName, int topicLen, MQTTAsync_message* m)
 {
-	/* not expecting any messages */
-	return 1;
-}
+	MQTTAsync client = (MQTTAsync)context;
+	MQTTAsync_message reply = MQTTAsync_message_initializer;
+	probe_sync_msg sync;
+	char buf[PROBE_SYNC_SIZE];
 
-int64_t getTime(void)
-{
-    #if defined(_WIN32)
-//		FILETIME ft;
-//		GetSystemTimeAsFileTime(&ft);
-//		return ((((int64_t) ft.dwHighDateTime) << 8) + ft.dwLowDateTime) / 10000;
-    return GetTickCount64();
-	#else
-		struct timespec ts;
-		clock_gettime(CLOCK_REALTIME, &ts);
-		return ((int64_t) ts.tv_sec * 1000) + ((int64_t) ts.tv_nsec / 1000000);
-	#endif
+	if (probe_sync_decode(m->payload, m->payloadlen, &sync))
+	{
+		probe_sync_answer(&sync, probe_now_ns(sync.clock));
+		probe_sync_encode(buf, &sync);
+		reply.payload = buf;
+		reply.payloadlen = PROBE_SYNC_SIZE;
+		reply.qos = 0;
+		MQTTAsync_sendMessage(client, SYNC_REPLY_TOPIC, &reply, NULL);
+	}
+	MQTTAsync_freeMessage(&m);
+	MQTTAsync_free(topicName);
+	return 1;
 }
 
 int main(int argc, char* argv[])
@@ -151,6 +193,10 @@ int main(int argc, char* argv[])
 	MQTTAsync_responseOptions pub_opts = MQTTAsync_responseOptions_initializer;
 
 	int rc;
+	uint64_t seq = 0;
+
+	if (argc > 1 && strcmp(argv[1], "--realtime") == 0)
+		probe_clock = PROBE_CLOCK_REALTIME;
 
 	if ((rc = MQTTAsync_create(&client, ADDRESS, CLIENTID, MQTTCLIENT_PERSISTENCE_NONE, NULL)) != MQTTASYNC_SUCCESS)
 	{
@@ -158,12 +204,13 @@ int main(int argc, char* argv[])
 		exit(EXIT_FAILURE);
 	}
 
-	if ((rc = MQTTAsync_setCallbacks(client, NULL, connlost, messageArrived, NULL)) != MQTTASYNC_SUCCESS)
+	if ((rc = MQTTAsync_setCallbacks(client, client, connlost, messageArrived, NULL)) != MQTTASYNC_SUCCESS)
 	{
 		printf("Failed to set callback, return code %d\n", rc);
 		exit(EXIT_FAILURE);
 	}
 
+	reconnect_backoff_init(&backoff, RECONNECT_INITIAL_MS, RECONNECT_MAX_MS);
 	conn_opts.keepAliveInterval = 20;
 	conn_opts.cleansession = 1;
 	conn_opts.onSuccess = onConnect;
@@ -184,18 +231,33 @@ int main(int argc, char* argv[])
 	}
 
 	while (!finished) {
-		int64_t t = getTime();
+		probe_header h;
+		char buf[PROBE_HEADER_SIZE];
+
+		// Nothing to send to while a reconnect is pending.
+		if (!connected)
+		{
+			#if defined(_WIN32)
+				Sleep(100);
+			#else
+				usleep(100000L);
+			#endif
+			continue;
+		}
 
-		char buf[256];
-		int n = snprintf(buf, sizeof(buf), "%lld", (long long) t);
-		printf("%s\n", buf);
+		h.publisher_id = PUBLISHER_ID;
+		h.seq = seq++;
+		h.clock = probe_clock;
+		h.send_ns = probe_now_ns(probe_clock);
+		probe_encode(buf, &h);
+		printf("seq %llu sent %lld\n", (unsigned long long) h.seq, (long long) h.send_ns);
 
 		pub_opts.onSuccess = onSend;
 		pub_opts.onFailure = onSendFailure;
 		pub_opts.context = client;
 
 		pubmsg.payload = buf;
-		pubmsg.payloadlen = n;
+		pubmsg.payloadlen = PROBE_HEADER_SIZE;
 		pubmsg.qos = QOS;
 		pubmsg.retained = 0;
 
@@ -14,6 +14,20 @@
  *    Ian Craggs - initial contribution
  *******************************************************************************/
 
+// Prints every message on TOPIC; latency probes (see probe_clock.h), as sent
+// by MQTTAsync_publish_time and MQTTAsync_publish, are decoded and their
+// latency printed.
+//
+// Usage: MQTTAsync_subscribe [--calibrate [--realtime]]
+//
+// With --calibrate the subscriber first exchanges SYNC_ROUNDS clock sync
+// messages with MQTTAsync_publish_time and adds the measured offset between
+// the two clocks (monotonic, or realtime with --realtime) to the latency of
+// probes stamped on that clock. Use it when the publisher runs on another
+// host; on the same host the monotonic clock is shared and needs no offset.
+
+#include "probe_clock.h"
+#include "reconnect_backoff.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -21,6 +35,7 @@
 #include <stdint.h>
 
 #if !defined(_WIN32)
+#include <pthread.h>
 #include <unistd.h>
 #else
 #include <windows.h>
@@ -30,49 +45,60 @@
 #include <OsWrapper.h>
 #endif
 
-int64_t getTime(void)
-{
-    #if defined(_WIN32)
-//		FILETIME ft;
-//		GetSystemTimeAsFileTime(&ft);
-//		return ((((int64_t) ft.dwHighDateTime) << 8) + ft.dwLowDateTime) / 10000;
-    return GetTickCount64();
-    #else
-        struct timespec ts;
-        clock_gettime(CLOCK_REALTIME, &ts);
-        return ((int64_t) ts.tv_sec * 1000) + ((int64_t) ts.tv_nsec / 1000000);
-    #endif
-}
-
 #define ADDRESS     "tcp://localhost:1883"
 #define CLIENTID    "ExampleClientSub"
 #define TOPIC       "hello_mqtt"
+#define SYNC_TOPIC  "hello_mqtt/sync"
+#define SYNC_REPLY_TOPIC "hello_mqtt/sync/reply"
+#define SYNC_ROUNDS 16
 #define PAYLOAD     "Hello World!"
 #define QOS         1
 #define TIMEOUT     10000L
+#define RECONNECT_INITIAL_MS 100
+#define RECONNECT_MAX_MS     10000
 
 int disc_finished = 0;
 int subscribed = 0;
 int finished = 0;
 
+int calibrate = 0;
+probe_clock_id sync_clock = PROBE_CLOCK_MONOTONIC;
+
+// Clock sync state: written by main() and by msgarrvd() on the client's
+// thread, so only touched with sync_mutex held.
+int calibrated = 0;
+uint32_t requester_id;
+probe_offset_estimator offset;
+uint32_t sync_replies = 0;
+#if defined(_WIN32)
+SRWLOCK sync_mutex = SRWLOCK_INIT;
+#define sync_lock() AcquireSRWLockExclusive(&sync_mutex)
+#define sync_unlock() ReleaseSRWLockExclusive(&sync_mutex)
+#else
+pthread_mutex_t sync_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define sync_lock() pthread_mutex_lock(&sync_mutex)
+#define sync_unlock() pthread_mutex_unlock(&sync_mutex)
+#endif
+reconnect_backoff backoff;
+
 void onConnect(void* context, MQTTAsync_successData* response);
 void onConnectFailure(void* context, MQTTAsync_failureData* response);
 
-void connlost(void *context, char *cause)
+// Called on the client's thread after a lost connection or a failed
+// reconnect: waits out the backoff delay, then tries again.
+void reconnect(MQTTAsync client)
 {
-	MQTTAsync client = (MQTTAsync)context;
 	MQTTAsync_connectOptions conn_opts = MQTTAsync_connectOptions_initializer;
+	int64_t delay = reconnect_backoff_next(&backoff);
 	int rc;
 
-	printf("\nConnection lost\n");
-	if (cause)
-		printf("     cause: %s\n", cause);
-
-	printf("Reconnecting\n");
+	printf("Reconnecting in %lld ms\n", (long long)delay);
+	reconnect_backoff_sleep(delay);
 	conn_opts.keepAliveInterval = 20;
 	conn_opts.cleansession = 1;
 	conn_opts.onSuccess = onConnect;
 	conn_opts.onFailure = onConnectFailure;
+	conn_opts.context = client;
 	if ((rc = MQTTAsync_connect(client, &conn_opts)) != MQTTASYNC_SUCCESS)
 	{
 		printf("Failed to start connect, return code %d\n", rc);
@@ -80,13 +106,60 @@ void connlost(void *context, char *cause)
 	}
 }
 
+void connlost(void *context, char *cause)
+{
+	printf("\nConnection lost\n");
+	if (cause)
+		printf("     cause: %s\n", cause);
+	reconnect((MQTTAsync)context);
+}
+
 
 int msgarrvd(void *context, char *topicName, int topicLen, MQTTAsync_message *message)
 {
-    printf("Message arrived\n");
-    printf("     topic: %s\n", topicName);
-    printf("   message: %.*s\n", message->payloadlen, (char*)message->payload);
-    printf("   now: %lld\n",getTime());
+    probe_header h;
+    probe_sync_msg sync;
+
+    if (strcmp(topicName, SYNC_REPLY_TOPIC) == 0)
+    {
+        if (probe_sync_decode(message->payload, message->payloadlen, &sync))
+        {
+            int64_t t4 = probe_now_ns(sync.clock);
+            sync_lock();
+            if (sync.requester_id == requester_id)
+            {
+                probe_offset_add(&offset, &sync, t4);
+                sync_replies++;
+            }
+            sync_unlock();
+        }
+    }
+    else if (probe_decode(message->payload, message->payloadlen, &h))
+    {
+        int64_t off;
+        int64_t latency;
+
+        sync_lock();
+        off = calibrated && h.clock == sync_clock ? offset.offset_ns : 0;
+        sync_unlock();
+        latency = probe_latency_ns(&h, off);
+
+        printf("Probe arrived\n");
+        printf("     topic: %s\n", topicName);
+        printf(" publisher: %u seq: %llu clock: %s\n", h.publisher_id,
+               (unsigned long long)h.seq,
+               h.clock == PROBE_CLOCK_REALTIME ? "realtime" : "monotonic");
+        printf("   latency: %.3f ms\n", latency * 1e-6);
+        if (message->payloadlen > PROBE_HEADER_SIZE)
+            printf("   message: %.*s\n", message->payloadlen - PROBE_HEADER_SIZE,
+                   (char*)message->payload + PROBE_HEADER_SIZE);
+    }
+    else
+    {
+        printf("Message arrived\n");
+        printf("     topic: %s\n", topicName);
+        printf("   message: %.*s\n", message->payloadlen, (char*)message->payload);
+    }
     MQTTAsync_freeMessage(&message);
     MQTTAsync_free(topicName);
     return 1;
@@ -119,8 +192,12 @@ void onSubscribeFailure(void* context, MQTTAsync_failureData* response)
 
 void onConnectFailure(void* context, MQTTAsync_failureData* response)
 {
-	printf("Connect failed, rc %d\n", response->code);
-	finished = 1;
+	printf("Connect failed, rc %d\n", response ? response->code : 0);
+	// Only the first connect gives up; a lost connection is retried.
+	if (backoff.attempts > 0)
+		reconnect((MQTTAsync)context);
+	else
+		finished = 1;
 }
 
 
@@ -131,6 +208,7 @@ void onConnect(void* context, MQTTAsync_successData* response)
 	int rc;
 
 	printf("Successful connection\n");
+	reconnect_backoff_reset(&backoff);
 
 	printf("Subscribing to topic %s\nfor client %s using QoS%d\n\n"
            "Press Q<Enter> to quit\n\n", TOPIC, CLIENTID, QOS);
@@ -145,6 +223,66 @@ void onConnect(void* context, MQTTAsync_successData* response)
 }
 
 
+// Sends SYNC_ROUNDS sync requests and keeps the lowest-rtt offset estimate.
+// Returns 0 if no reply came back, i.e. no MQTTAsync_publish_time is running.
+int calibrate_clock(MQTTAsync client)
+{
+	MQTTAsync_message msg = MQTTAsync_message_initializer;
+	probe_sync_msg sync;
+	probe_offset_estimator result;
+	char buf[PROBE_SYNC_SIZE];
+	uint32_t id = (uint32_t)probe_monotonic_ns();
+	uint32_t replies;
+	int i;
+	int rc;
+
+	sync_lock();
+	probe_offset_init(&offset);
+	requester_id = id;
+	sync_replies = 0;
+	sync_unlock();
+	if ((rc = MQTTAsync_subscribe(client, SYNC_REPLY_TOPIC, 0, NULL)) != MQTTASYNC_SUCCESS)
+	{
+		printf("Failed to subscribe to %s, return code %d\n", SYNC_REPLY_TOPIC, rc);
+		return 0;
+	}
+	// Lets the subscription settle before the first request.
+	#if defined(_WIN32)
+		Sleep(500);
+	#else
+		usleep(500000L);
+	#endif
+	for (i = 0; i < SYNC_ROUNDS; ++i)
+	{
+		sync.requester_id = id;
+		sync.clock = sync_clock;
+		sync.t1 = probe_now_ns(sync_clock);
+		sync.t2 = sync.t3 = 0;
+		probe_sync_encode(buf, &sync);
+		msg.payload = buf;
+		msg.payloadlen = PROBE_SYNC_SIZE;
+		msg.qos = 0;
+		MQTTAsync_sendMessage(client, SYNC_TOPIC, &msg, NULL);
+		#if defined(_WIN32)
+			Sleep(100);
+		#else
+			usleep(100000L);
+		#endif
+	}
+	sync_lock();
+	result = offset;
+	replies = sync_replies;
+	sync_unlock();
+	if (replies == 0)
+	{
+		printf("No clock sync replies; is MQTTAsync_publish_time running?\n");
+		return 0;
+	}
+	printf("Clock offset %.3f ms (rtt %.3f ms, %u replies)\n\n",
+	       result.offset_ns * 1e-6, result.rtt_ns * 1e-6, replies);
+	return 1;
+}
+
 int main(int argc, char* argv[])
 {
 	MQTTAsync client;
@@ -152,6 +290,15 @@ int main(int argc, char* argv[])
 	MQTTAsync_disconnectOptions disc_opts = MQTTAsync_disconnectOptions_initializer;
 	int rc;
 	int ch;
+	int i;
+
+	for (i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--calibrate") == 0)
+			calibrate = 1;
+		else if (strcmp(argv[i], "--realtime") == 0)
+			sync_clock = PROBE_CLOCK_REALTIME;
+	}
 
 	if ((rc = MQTTAsync_create(&client, ADDRESS, CLIENTID, MQTTCLIENT_PERSISTENCE_NONE, NULL))
 			!= MQTTASYNC_SUCCESS)
@@ -168,6 +315,7 @@ int main(int argc, char* argv[])
 		goto destroy_exit;
 	}
 
+	reconnect_backoff_init(&backoff, RECONNECT_INITIAL_MS, RECONNECT_MAX_MS);
 	conn_opts.keepAliveInterval = 20;
 	conn_opts.cleansession = 1;
 	conn_opts.onSuccess = onConnect;
@@ -190,6 +338,13 @@ int main(int argc, char* argv[])
 	if (finished)
 		goto exit;
 
+	if (calibrate && calibrate_clock(client))
+	{
+		sync_lock();
+		calibrated = 1;
+		sync_unlock();
+	}
+
 	do 
 	{
 		ch = getchar();
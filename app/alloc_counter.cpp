@@ -0,0 +1,51 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "alloc_counter.hpp"
+#include <atomic>
+#include <cstddef>
+
+namespace {
+std::atomic<std::uint64_t> alloc_count{0};
+std::atomic<std::uint64_t> alloc_bytes{0};
+// Plain data, so reaching it from inside malloc never allocates.
+thread_local alloc_stats thread_allocs;
+
+void note(std::size_t size) {
+  alloc_count.fetch_add(1, std::memory_order_relaxed);
+  alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+  ++thread_allocs.count;
+  thread_allocs.bytes += size;
+}
+} // namespace
+
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t n, std::size_t size);
+void *__libc_realloc(void *p, std::size_t size);
+
+void *malloc(std::size_t size) noexcept {
+  note(size);
+  return __libc_malloc(size);
+}
+
+void *calloc(std::size_t n, std::size_t size) noexcept {
+  note(n * size);
+  return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, std::size_t size) noexcept {
+  note(size);
+  return __libc_realloc(p, size);
+}
+}
+
+alloc_stats allocations() {
+  return {alloc_count.load(std::memory_order_relaxed),
+          alloc_bytes.load(std::memory_order_relaxed)};
+}
+
+alloc_stats thread_allocations() { return thread_allocs; }
@@ -0,0 +1,35 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstdint>
+
+// Heap allocations made by the whole process so far.
+//
+// Counted by interposing glibc's malloc, calloc and realloc, which also back
+// operator new, so C and C++ client libraries are measured alike. Only
+// programs that link alloc_counter.cpp count; memalign and friends are not
+// counted.
+struct alloc_stats {
+  std::uint64_t count = 0;
+  std::uint64_t bytes = 0;
+};
+
+inline alloc_stats operator-(const alloc_stats &a, const alloc_stats &b) {
+  return {a.count - b.count, a.bytes - b.bytes};
+}
+
+inline alloc_stats &operator+=(alloc_stats &a, const alloc_stats &b) {
+  a.count += b.count;
+  a.bytes += b.bytes;
+  return a;
+}
+
+alloc_stats allocations();
+
+// Heap allocations made by the calling thread so far.
+alloc_stats thread_allocations();
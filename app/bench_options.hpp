@@ -0,0 +1,76 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Minimal "--name=value" command line lookup shared by the benchmarks.
+// A bare "--name" is treated as "--name=1" so boolean switches read naturally.
+class bench_options {
+public:
+  bench_options(int argc, char **argv) {
+    for (int i = 1; i < argc; ++i) {
+      std::string_view arg = argv[i];
+      if (arg.substr(0, 2) != "--") {
+        continue;
+      }
+      arg.remove_prefix(2);
+      auto eq = arg.find('=');
+      if (eq == std::string_view::npos) {
+        args_.push_back({std::string(arg), "1"});
+      } else {
+        args_.push_back(
+            {std::string(arg.substr(0, eq)), std::string(arg.substr(eq + 1))});
+      }
+    }
+  }
+
+  bool has(std::string_view name) const { return find(name) != nullptr; }
+
+  std::string get(std::string_view name, const char *def) const {
+    auto v = find(name);
+    return v ? *v : def;
+  }
+  std::string get(std::string_view name, const std::string &def) const {
+    auto v = find(name);
+    return v ? *v : def;
+  }
+  long long get(std::string_view name, long long def) const {
+    auto v = find(name);
+    return v ? std::strtoll(v->c_str(), nullptr, 0) : def;
+  }
+  int get(std::string_view name, int def) const {
+    return static_cast<int>(get(name, static_cast<long long>(def)));
+  }
+  std::size_t get(std::string_view name, std::size_t def) const {
+    return static_cast<std::size_t>(get(name, static_cast<long long>(def)));
+  }
+  double get(std::string_view name, double def) const {
+    auto v = find(name);
+    return v ? std::strtod(v->c_str(), nullptr) : def;
+  }
+  bool get(std::string_view name, bool def) const {
+    auto v = find(name);
+    return v ? (*v != "0" && *v != "false") : def;
+  }
+
+private:
+  const std::string *find(std::string_view name) const {
+    // Last occurrence wins, like most command line tools.
+    for (auto it = args_.rbegin(); it != args_.rend(); ++it) {
+      if (it->first == name) {
+        return &it->second;
+      }
+    }
+    return nullptr;
+  }
+
+  std::vector<std::pair<std::string, std::string>> args_;
+};
@@ -0,0 +1,63 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// A broker address from --broker and friends:
+//   tcp://host:port, host:port or host   TCP (default port 1883)
+//   unix:///run/mqtt.sock                Unix domain socket at /run/mqtt.sock
+//   unix:mqtt.sock                       ... at a path relative to the cwd
+struct broker_address {
+  std::string host = "localhost";
+  std::uint16_t port = 1883;
+  std::string unix_path;
+
+  bool is_unix() const { return !unix_path.empty(); }
+
+  static std::optional<broker_address> parse(std::string_view url) {
+    broker_address a;
+    if (url.substr(0, 5) == "unix:") {
+      url.remove_prefix(5);
+      if (url.substr(0, 2) == "//") {
+        url.remove_prefix(2);
+      }
+      if (url.empty()) {
+        return std::nullopt;
+      }
+      a.unix_path = std::string(url);
+      return a;
+    }
+    if (url.substr(0, 6) == "tcp://") {
+      url.remove_prefix(6);
+    }
+    auto colon = url.rfind(':');
+    if (colon != std::string_view::npos) {
+      auto port = url.substr(colon + 1);
+      auto [end, ec] =
+          std::from_chars(port.data(), port.data() + port.size(), a.port);
+      if (ec != std::errc() || end != port.data() + port.size()) {
+        return std::nullopt;
+      }
+      url = url.substr(0, colon);
+    }
+    if (url.empty()) {
+      return std::nullopt;
+    }
+    a.host = std::string(url);
+    return a;
+  }
+
+  std::string describe() const {
+    return is_unix() ? "unix://" + unix_path
+                     : "tcp://" + host + ":" + std::to_string(port);
+  }
+};
@@ -0,0 +1,95 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One MQTT client library behind the interface mqtt_compare drives.
+//
+// Every adapter opens two connections to the broker, one publishing and one
+// subscribing to the workload topic, so each library is measured doing the
+// same work with its own threading model. Adapters live in separate
+// translation units, one library each, and this header includes neither;
+// mqtt_cpp is built with MQTT_NS=mqtt_cpp so that its symbols stay clear of
+// Paho C++'s namespace mqtt in the linked binary. Failures while starting
+// are thrown as std::runtime_error.
+
+struct workload {
+  std::string host = "localhost";
+  std::uint16_t port = 1883;
+  // Broker's Unix domain socket, for the clients that connect over one.
+  std::string unix_path;
+  std::string topic = "bench/compare";
+  int qos = 0;
+  std::size_t payload_size = 0;
+  double rate = 1000;
+  bool poisson = false;
+  double warmup = 1;
+  double duration = 10;
+};
+
+class client_adapter {
+public:
+  // Called on a library thread with the payload of every message received on
+  // the workload topic; the data is only valid during the call.
+  using receive_handler =
+      std::function<void(const char *data, std::size_t size)>;
+
+  virtual ~client_adapter() = default;
+
+  virtual const char *name() const = 0;
+  // Connects both connections and subscribes. Returns once messages
+  // published afterwards will be delivered.
+  virtual void start(const workload &w, receive_handler on_receive) = 0;
+  // Publishes one payload; called from a single harness thread. Returns
+  // false if the library refused the message.
+  virtual bool publish(std::string_view payload) = 0;
+  virtual void stop() = 0;
+};
+
+std::unique_ptr<client_adapter> make_mqtt_cpp_async_adapter();
+std::unique_ptr<client_adapter> make_mqtt_cpp_sync_adapter();
+std::unique_ptr<client_adapter> make_mqtt_cpp_uds_adapter();
+std::unique_ptr<client_adapter> make_paho_cpp_sync_adapter();
+std::unique_ptr<client_adapter> make_paho_cpp_async_adapter();
+std::unique_ptr<client_adapter> make_paho_c_async_adapter();
+
+inline const std::vector<std::string> &client_adapter_names() {
+  static const std::vector<std::string> names{
+      "mqtt_cpp_async", "mqtt_cpp_sync", "mqtt_cpp_uds", "paho_cpp_sync",
+      "paho_cpp_async", "paho_c_async"};
+  return names;
+}
+
+inline std::unique_ptr<client_adapter>
+make_client_adapter(std::string_view name) {
+  if (name == "mqtt_cpp_async") {
+    return make_mqtt_cpp_async_adapter();
+  }
+  if (name == "mqtt_cpp_sync") {
+    return make_mqtt_cpp_sync_adapter();
+  }
+  if (name == "mqtt_cpp_uds") {
+    return make_mqtt_cpp_uds_adapter();
+  }
+  if (name == "paho_cpp_sync") {
+    return make_paho_cpp_sync_adapter();
+  }
+  if (name == "paho_cpp_async") {
+    return make_paho_cpp_async_adapter();
+  }
+  if (name == "paho_c_async") {
+    return make_paho_c_async_adapter();
+  }
+  return nullptr;
+}
@@ -0,0 +1,188 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "client_adapter.hpp"
+#include "mqtt_client_cpp.hpp"
+#include "shared_payload.hpp"
+#include "spdlog/spdlog.h"
+#include "uds_transport.hpp"
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+using client_t = decltype(MQTT_NS::make_async_client(
+    std::declval<boost::asio::io_context &>(), std::string(),
+    std::uint16_t()));
+using sync_client_t = decltype(MQTT_NS::make_sync_client(
+    std::declval<boost::asio::io_context &>(), std::string(),
+    std::uint16_t()));
+
+// Async uses async_connect/subscribe/publish; sync uses the blocking calls,
+// which write on the io_context thread before returning. Unix runs the async
+// client over the workload's Unix domain socket instead of TCP.
+template <bool Async, bool Unix = false>
+class mqtt_cpp_adapter : public client_adapter {
+public:
+  static_assert(Async || !Unix, "the Unix domain socket client is async");
+  using c_t = std::conditional_t<
+      Unix, std::shared_ptr<uds_client>,
+      std::conditional_t<Async, client_t, sync_client_t>>;
+  using packet_id_t = typename std::remove_reference_t<
+      decltype(*std::declval<c_t>())>::packet_id_t;
+
+  ~mqtt_cpp_adapter() override { stop(); }
+
+  const char *name() const override {
+    return Unix ? "mqtt_cpp_uds" : Async ? "mqtt_cpp_async" : "mqtt_cpp_sync";
+  }
+
+  void start(const workload &w, receive_handler on_receive) override {
+    topic_ = MQTT_NS::allocate_buffer(w.topic.begin(), w.topic.end());
+    qos_ = static_cast<MQTT_NS::qos>(w.qos);
+    std::promise<void> pub_ready, sub_ready;
+    auto pub_done = pub_ready.get_future();
+    auto sub_done = sub_ready.get_future();
+
+    pub_.c = make(pub_.ioc, w, "compare_pub");
+    pub_.c->set_connack_handler(
+        [&pub_ready](bool, MQTT_NS::connect_return_code rc) {
+          if (rc == MQTT_NS::connect_return_code::accepted) {
+            pub_ready.set_value();
+          }
+          return true;
+        });
+
+    sub_.c = make(sub_.ioc, w, "compare_sub");
+    sub_.c->set_connack_handler(
+        [this](bool, MQTT_NS::connect_return_code rc) {
+          if (rc == MQTT_NS::connect_return_code::accepted) {
+            if constexpr (Async) {
+              sub_.c->async_subscribe(std::string(topic_), qos_);
+            } else {
+              sub_.c->subscribe(std::string(topic_), qos_);
+            }
+          }
+          return true;
+        });
+    sub_.c->set_suback_handler(
+        [&sub_ready](packet_id_t, std::vector<MQTT_NS::suback_return_code>) {
+          sub_ready.set_value();
+          return true;
+        });
+    sub_.c->set_publish_handler(
+        [on_receive](MQTT_NS::optional<packet_id_t>, MQTT_NS::publish_options,
+                     MQTT_NS::buffer, MQTT_NS::buffer contents) {
+          on_receive(contents.data(), contents.size());
+          return true;
+        });
+
+    pub_.run();
+    sub_.run();
+    using namespace std::chrono_literals;
+    if (pub_done.wait_for(10s) != std::future_status::ready ||
+        sub_done.wait_for(10s) != std::future_status::ready) {
+      stop();
+      throw std::runtime_error("timed out connecting");
+    }
+  }
+
+  bool publish(std::string_view payload) override {
+    // The client is not thread-safe, so the payload is copied over to the
+    // io_context thread, once: the shared buffer goes to the socket as is.
+    boost::asio::post(pub_.ioc, [this, p = make_shared_payload(payload)] {
+      if constexpr (Async) {
+        pub_.c->async_publish(topic_, p, qos_);
+      } else {
+        pub_.c->publish(topic_, p, qos_);
+      }
+    });
+    return true;
+  }
+
+  void stop() override {
+    pub_.stop();
+    sub_.stop();
+  }
+
+private:
+  struct connection {
+    boost::asio::io_context ioc;
+    c_t c;
+    std::thread thread;
+
+    void run() {
+      boost::asio::post(ioc, [this] {
+        if constexpr (Async) {
+          c->async_connect();
+        } else {
+          c->connect();
+        }
+      });
+      thread = std::thread([this] { ioc.run(); });
+    }
+
+    void stop() {
+      if (!thread.joinable()) {
+        return;
+      }
+      boost::asio::post(ioc, [this] {
+        if constexpr (Async) {
+          c->async_disconnect();
+        } else {
+          c->disconnect();
+        }
+      });
+      // run() returns once the broker has closed the connection.
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      ioc.stop();
+      thread.join();
+    }
+  };
+
+  static c_t make(boost::asio::io_context &ioc, const workload &w,
+                  const char *id) {
+    c_t c;
+    if constexpr (Unix) {
+      if (w.unix_path.empty()) {
+        throw std::runtime_error("no Unix domain socket to connect to");
+      }
+      c = make_uds_client(ioc, w.unix_path);
+    } else if constexpr (Async) {
+      c = MQTT_NS::make_async_client(ioc, w.host, w.port);
+    } else {
+      c = MQTT_NS::make_sync_client(ioc, w.host, w.port);
+    }
+    c->set_client_id(id);
+    c->set_keep_alive_sec(30);
+    c->set_clean_session(true);
+    c->set_error_handler([id](MQTT_NS::error_code ec) {
+      spdlog::error("{}: {}", id, ec.message());
+    });
+    return c;
+  }
+
+  MQTT_NS::buffer topic_;
+  MQTT_NS::qos qos_ = MQTT_NS::qos::at_most_once;
+  connection pub_;
+  connection sub_;
+};
+
+} // namespace
+
+std::unique_ptr<client_adapter> make_mqtt_cpp_async_adapter() {
+  return std::make_unique<mqtt_cpp_adapter<true>>();
+}
+
+std::unique_ptr<client_adapter> make_mqtt_cpp_sync_adapter() {
+  return std::make_unique<mqtt_cpp_adapter<false>>();
+}
+
+std::unique_ptr<client_adapter> make_mqtt_cpp_uds_adapter() {
+  return std::make_unique<mqtt_cpp_adapter<true, true>>();
+}
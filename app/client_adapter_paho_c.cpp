@@ -0,0 +1,137 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "client_adapter.hpp"
+#include "MQTTAsync.h"
+#include <chrono>
+#include <future>
+#include <stdexcept>
+
+namespace {
+
+// Completion of one MQTTAsync request, for the blocking start()/stop().
+struct request {
+  std::promise<bool> done;
+
+  static void on_success(void *context, MQTTAsync_successData *) {
+    static_cast<request *>(context)->done.set_value(true);
+  }
+  static void on_failure(void *context, MQTTAsync_failureData *) {
+    static_cast<request *>(context)->done.set_value(false);
+  }
+
+  bool wait() {
+    auto f = done.get_future();
+    return f.wait_for(std::chrono::seconds(10)) == std::future_status::ready &&
+           f.get();
+  }
+};
+
+// Paho C MQTTAsync: MQTTAsync_sendMessage() copies the message onto the
+// library's command queue and returns.
+class paho_c_async_adapter : public client_adapter {
+public:
+  ~paho_c_async_adapter() override {
+    stop();
+    for (auto c : {&pub_, &sub_}) {
+      if (*c) {
+        MQTTAsync_destroy(c);
+      }
+    }
+  }
+
+  const char *name() const override { return "paho_c_async"; }
+
+  void start(const workload &w, receive_handler on_receive) override {
+    topic_ = w.topic;
+    qos_ = w.qos;
+    on_receive_ = std::move(on_receive);
+    auto uri = "tcp://" + w.host + ":" + std::to_string(w.port);
+    if (MQTTAsync_create(&pub_, uri.c_str(), "compare_pub",
+                         MQTTCLIENT_PERSISTENCE_NONE,
+                         nullptr) != MQTTASYNC_SUCCESS ||
+        MQTTAsync_create(&sub_, uri.c_str(), "compare_sub",
+                         MQTTCLIENT_PERSISTENCE_NONE,
+                         nullptr) != MQTTASYNC_SUCCESS) {
+      throw std::runtime_error("MQTTAsync_create failed");
+    }
+    MQTTAsync_setCallbacks(sub_, this, nullptr, &message_arrived, nullptr);
+    connect(pub_);
+    connect(sub_);
+
+    request r;
+    MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
+    opts.onSuccess = &request::on_success;
+    opts.onFailure = &request::on_failure;
+    opts.context = &r;
+    if (MQTTAsync_subscribe(sub_, topic_.c_str(), qos_, &opts) !=
+            MQTTASYNC_SUCCESS ||
+        !r.wait()) {
+      throw std::runtime_error("subscribe failed");
+    }
+  }
+
+  bool publish(std::string_view payload) override {
+    MQTTAsync_message msg = MQTTAsync_message_initializer;
+    msg.payload = const_cast<char *>(payload.data());
+    msg.payloadlen = static_cast<int>(payload.size());
+    msg.qos = qos_;
+    return MQTTAsync_sendMessage(pub_, topic_.c_str(), &msg, nullptr) ==
+           MQTTASYNC_SUCCESS;
+  }
+
+  void stop() override {
+    for (auto c : {pub_, sub_}) {
+      if (c && MQTTAsync_isConnected(c)) {
+        request r;
+        MQTTAsync_disconnectOptions opts =
+            MQTTAsync_disconnectOptions_initializer;
+        opts.onSuccess = &request::on_success;
+        opts.onFailure = &request::on_failure;
+        opts.context = &r;
+        if (MQTTAsync_disconnect(c, &opts) == MQTTASYNC_SUCCESS) {
+          r.wait();
+        }
+      }
+    }
+  }
+
+private:
+  static void connect(MQTTAsync c) {
+    request r;
+    MQTTAsync_connectOptions opts = MQTTAsync_connectOptions_initializer;
+    opts.keepAliveInterval = 30;
+    opts.cleansession = 1;
+    opts.onSuccess = &request::on_success;
+    opts.onFailure = &request::on_failure;
+    opts.context = &r;
+    if (MQTTAsync_connect(c, &opts) != MQTTASYNC_SUCCESS || !r.wait()) {
+      throw std::runtime_error("connect failed");
+    }
+  }
+
+  static int message_arrived(void *context, char *topic, int,
+                             MQTTAsync_message *msg) {
+    auto self = static_cast<paho_c_async_adapter *>(context);
+    self->on_receive_(static_cast<const char *>(msg->payload),
+                      static_cast<std::size_t>(msg->payloadlen));
+    MQTTAsync_freeMessage(&msg);
+    MQTTAsync_free(topic);
+    return 1;
+  }
+
+  std::string topic_;
+  int qos_ = 0;
+  receive_handler on_receive_;
+  MQTTAsync pub_ = nullptr;
+  MQTTAsync sub_ = nullptr;
+};
+
+} // namespace
+
+std::unique_ptr<client_adapter> make_paho_c_async_adapter() {
+  return std::make_unique<paho_c_async_adapter>();
+}
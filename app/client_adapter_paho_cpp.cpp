@@ -0,0 +1,152 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "client_adapter.hpp"
+#include "mqtt/async_client.h"
+#include "mqtt/client.h"
+#include <chrono>
+#include <stdexcept>
+
+namespace {
+
+mqtt::connect_options connect_options() {
+  return mqtt::connect_options_builder()
+      .keep_alive_interval(std::chrono::seconds(30))
+      .clean_session(true)
+      .finalize();
+}
+
+std::string server_uri(const workload &w) {
+  return "tcp://" + w.host + ":" + std::to_string(w.port);
+}
+
+class receive_callback : public mqtt::callback {
+public:
+  void message_arrived(mqtt::const_message_ptr msg) override {
+    auto &payload = msg->get_payload();
+    on_receive(payload.data(), payload.size());
+  }
+
+  client_adapter::receive_handler on_receive;
+};
+
+// mqtt::client: publish() blocks until the message is handed to the socket
+// (QoS 0) or acknowledged.
+class paho_cpp_sync_adapter : public client_adapter {
+public:
+  ~paho_cpp_sync_adapter() override { stop(); }
+
+  const char *name() const override { return "paho_cpp_sync"; }
+
+  void start(const workload &w, receive_handler on_receive) override {
+    topic_ = w.topic;
+    qos_ = w.qos;
+    callback_.on_receive = std::move(on_receive);
+    try {
+      pub_ = std::make_unique<mqtt::client>(server_uri(w), "compare_pub");
+      sub_ = std::make_unique<mqtt::client>(server_uri(w), "compare_sub");
+      sub_->set_callback(callback_);
+      pub_->connect(connect_options());
+      sub_->connect(connect_options());
+      sub_->subscribe(topic_, qos_);
+    } catch (const mqtt::exception &e) {
+      throw std::runtime_error(e.what());
+    }
+  }
+
+  bool publish(std::string_view payload) override {
+    try {
+      pub_->publish(
+          mqtt::make_message(topic_, payload.data(), payload.size(), qos_,
+                             false));
+      return true;
+    } catch (const mqtt::exception &) {
+      return false;
+    }
+  }
+
+  void stop() override {
+    for (auto c : {pub_.get(), sub_.get()}) {
+      if (c && c->is_connected()) {
+        try {
+          c->disconnect();
+        } catch (const mqtt::exception &) {
+        }
+      }
+    }
+  }
+
+private:
+  std::string topic_;
+  int qos_ = 0;
+  receive_callback callback_;
+  std::unique_ptr<mqtt::client> pub_;
+  std::unique_ptr<mqtt::client> sub_;
+};
+
+// mqtt::async_client: publish() queues the message and returns a token,
+// which is not waited on.
+class paho_cpp_async_adapter : public client_adapter {
+public:
+  ~paho_cpp_async_adapter() override { stop(); }
+
+  const char *name() const override { return "paho_cpp_async"; }
+
+  void start(const workload &w, receive_handler on_receive) override {
+    topic_ = w.topic;
+    qos_ = w.qos;
+    callback_.on_receive = std::move(on_receive);
+    try {
+      pub_ =
+          std::make_unique<mqtt::async_client>(server_uri(w), "compare_pub");
+      sub_ =
+          std::make_unique<mqtt::async_client>(server_uri(w), "compare_sub");
+      sub_->set_callback(callback_);
+      pub_->connect(connect_options())->wait();
+      sub_->connect(connect_options())->wait();
+      sub_->subscribe(topic_, qos_)->wait();
+    } catch (const mqtt::exception &e) {
+      throw std::runtime_error(e.what());
+    }
+  }
+
+  bool publish(std::string_view payload) override {
+    try {
+      pub_->publish(topic_, payload.data(), payload.size(), qos_, false);
+      return true;
+    } catch (const mqtt::exception &) {
+      return false;
+    }
+  }
+
+  void stop() override {
+    for (auto c : {pub_.get(), sub_.get()}) {
+      if (c && c->is_connected()) {
+        try {
+          c->disconnect()->wait();
+        } catch (const mqtt::exception &) {
+        }
+      }
+    }
+  }
+
+private:
+  std::string topic_;
+  int qos_ = 0;
+  receive_callback callback_;
+  std::unique_ptr<mqtt::async_client> pub_;
+  std::unique_ptr<mqtt::async_client> sub_;
+};
+
+} // namespace
+
+std::unique_ptr<client_adapter> make_paho_cpp_sync_adapter() {
+  return std::make_unique<paho_cpp_sync_adapter>();
+}
+
+std::unique_ptr<client_adapter> make_paho_cpp_async_adapter() {
+  return std::make_unique<paho_cpp_async_adapter>();
+}
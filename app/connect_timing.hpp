@@ -0,0 +1,239 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "probe_payload.hpp"
+#include <boost/asio/connect.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/ssl/stream.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/beast/websocket/ssl.hpp>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// The transports an MQTT connection can run over.
+enum class transport { tcp, tls, ws, wss };
+
+inline const char *to_string(transport t) {
+  switch (t) {
+  case transport::tcp:
+    return "tcp";
+  case transport::tls:
+    return "tls";
+  case transport::ws:
+    return "ws";
+  case transport::wss:
+    return "wss";
+  }
+  return "?";
+}
+
+inline std::optional<transport> parse_transport(std::string_view name) {
+  for (auto t : {transport::tcp, transport::tls, transport::ws,
+                 transport::wss}) {
+    if (name == to_string(t)) {
+      return t;
+    }
+  }
+  return std::nullopt;
+}
+
+inline bool uses_tls(transport t) {
+  return t == transport::tls || t == transport::wss;
+}
+
+inline bool uses_ws(transport t) {
+  return t == transport::ws || t == transport::wss;
+}
+
+// Time spent in each step of bringing up one MQTT connection.
+struct connect_phases {
+  std::int64_t tcp_ns = 0;
+  std::int64_t tls_ns = 0;
+  std::int64_t ws_ns = 0;
+  // CONNECT written until CONNACK read.
+  std::int64_t mqtt_ns = 0;
+  std::int64_t total_ns = 0;
+  bool resumed = false;
+};
+
+// Connects to an MQTT broker step by step with blocking Asio/Beast calls, so
+// every step is timed on its own: TCP, TLS handshake, WebSocket upgrade, and
+// the CONNECT/CONNACK exchange, then disconnects cleanly. mqtt_cpp's clients
+// hide their socket until the handshake is done, which is why this talks the
+// few bytes of MQTT it needs itself.
+//
+// For TLS it keeps the session of the last connection; connect(true) offers
+// it to the server (a TLS 1.2 session id, or a TLS 1.3 ticket, which arrives
+// after the handshake and is picked up while reading CONNACK), and
+// connect_phases::resumed tells whether the server took it. Errors are
+// thrown as boost::system::system_error or std::runtime_error.
+class connect_prober {
+public:
+  connect_prober(transport t, std::string host, std::uint16_t port,
+                 boost::asio::ssl::context *tls = nullptr)
+      : transport_(t), host_(std::move(host)), port_(port), tls_(tls) {
+    if (uses_tls(t) && !tls) {
+      throw std::runtime_error("connect_prober: TLS needs an ssl::context");
+    }
+  }
+
+  connect_phases connect(bool resume, std::string_view client_id = "probe") {
+    namespace websocket = boost::beast::websocket;
+    using tcp = boost::asio::ip::tcp;
+    connect_phases p;
+    boost::asio::io_context ioc;
+    tcp::resolver resolver(ioc);
+    auto endpoints = resolver.resolve(host_, std::to_string(port_));
+
+    auto start = get_ns();
+    auto mark = start;
+    auto lap = [&mark] {
+      auto now = get_ns();
+      auto d = now - mark;
+      mark = now;
+      return d;
+    };
+    auto connect_packet = make_connect(client_id);
+    const std::array<char, 2> disconnect_packet{'\xe0', '\x00'};
+
+    if (!uses_tls(transport_)) {
+      tcp::socket socket(ioc);
+      boost::asio::connect(socket, endpoints);
+      socket.set_option(tcp::no_delay(true));
+      p.tcp_ns = lap();
+      if (transport_ == transport::ws) {
+        websocket::stream<tcp::socket &> ws(socket);
+        ws_handshake(ws);
+        p.ws_ns = lap();
+        p.mqtt_ns = exchange_ws(ws, connect_packet);
+        ws.write(boost::asio::buffer(disconnect_packet));
+        close_ws(ws);
+      } else {
+        p.mqtt_ns = exchange(socket, connect_packet);
+        boost::asio::write(socket, boost::asio::buffer(disconnect_packet));
+      }
+      p.total_ns = get_ns() - start;
+      return p;
+    }
+
+    boost::asio::ssl::stream<tcp::socket> stream(ioc, *tls_);
+    boost::asio::connect(stream.lowest_layer(), endpoints);
+    stream.lowest_layer().set_option(tcp::no_delay(true));
+    p.tcp_ns = lap();
+    SSL_set_tlsext_host_name(stream.native_handle(), host_.c_str());
+    if (resume && session_) {
+      SSL_set_session(stream.native_handle(), session_.get());
+    }
+    stream.handshake(boost::asio::ssl::stream_base::client);
+    p.tls_ns = lap();
+    p.resumed = SSL_session_reused(stream.native_handle()) == 1;
+    if (transport_ == transport::wss) {
+      websocket::stream<boost::asio::ssl::stream<tcp::socket> &> ws(stream);
+      ws_handshake(ws);
+      p.ws_ns = lap();
+      p.mqtt_ns = exchange_ws(ws, connect_packet);
+      keep_session(stream);
+      ws.write(boost::asio::buffer(disconnect_packet));
+      close_ws(ws);
+    } else {
+      p.mqtt_ns = exchange(stream, connect_packet);
+      keep_session(stream);
+      boost::asio::write(stream, boost::asio::buffer(disconnect_packet));
+    }
+    boost::system::error_code ec;
+    stream.shutdown(ec);
+    p.total_ns = get_ns() - start;
+    return p;
+  }
+
+private:
+  struct session_free {
+    void operator()(SSL_SESSION *s) const { SSL_SESSION_free(s); }
+  };
+
+  // MQTT 3.1.1 CONNECT, clean session, 30 s keep alive.
+  static std::string make_connect(std::string_view client_id) {
+    std::string body("\x00\x04MQTT\x04\x02\x00\x1e", 10);
+    body += static_cast<char>(client_id.size() >> 8);
+    body += static_cast<char>(client_id.size() & 0xff);
+    body += client_id;
+    std::string packet(1, '\x10');
+    for (auto n = body.size();;) {
+      char byte = static_cast<char>(n % 128);
+      n /= 128;
+      packet += n ? static_cast<char>(byte | 0x80) : byte;
+      if (!n) {
+        break;
+      }
+    }
+    return packet + body;
+  }
+
+  static void check_connack(const char *p, std::size_t n) {
+    if (n < 4 || p[0] != '\x20' || p[1] != '\x02' || p[3] != 0) {
+      throw std::runtime_error("connect_prober: CONNACK refused");
+    }
+  }
+
+  template <typename Stream>
+  static std::int64_t exchange(Stream &s, const std::string &connect) {
+    auto start = get_ns();
+    boost::asio::write(s, boost::asio::buffer(connect));
+    std::array<char, 4> connack;
+    boost::asio::read(s, boost::asio::buffer(connack));
+    check_connack(connack.data(), connack.size());
+    return get_ns() - start;
+  }
+
+  template <typename Ws> void ws_handshake(Ws &ws) {
+    namespace websocket = boost::beast::websocket;
+    ws.set_option(websocket::stream_base::decorator(
+        [](websocket::request_type &req) {
+          req.set(boost::beast::http::field::sec_websocket_protocol, "mqtt");
+        }));
+    ws.handshake(host_ + ":" + std::to_string(port_), "/");
+    ws.binary(true);
+  }
+
+  template <typename Ws>
+  static std::int64_t exchange_ws(Ws &ws, const std::string &connect) {
+    auto start = get_ns();
+    ws.write(boost::asio::buffer(connect));
+    boost::beast::flat_buffer buf;
+    ws.read(buf);
+    auto data = buf.data();
+    check_connack(static_cast<const char *>(data.data()), data.size());
+    return get_ns() - start;
+  }
+
+  template <typename Ws> static void close_ws(Ws &ws) {
+    boost::system::error_code ec;
+    ws.close(boost::beast::websocket::close_code::normal, ec);
+  }
+
+  template <typename Stream> void keep_session(Stream &stream) {
+    if (auto *s = SSL_get1_session(stream.native_handle())) {
+      session_.reset(s);
+    }
+  }
+
+  transport transport_;
+  std::string host_;
+  std::uint16_t port_;
+  boost::asio::ssl::context *tls_;
+  std::unique_ptr<SSL_SESSION, session_free> session_;
+};
@@ -0,0 +1,52 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <chrono>
+#include <sys/resource.h>
+#include <time.h>
+
+// Process and thread CPU time, for reporting CPU cost next to throughput.
+inline double process_cpu_seconds() {
+  rusage ru{};
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+         (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+}
+
+inline double thread_cpu_seconds() {
+  timespec ts{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Process CPU and wall time elapsed since construction (or restart()).
+class cpu_meter {
+public:
+  cpu_meter() { restart(); }
+
+  void restart() {
+    cpu_start_ = process_cpu_seconds();
+    wall_start_ = std::chrono::steady_clock::now();
+  }
+
+  double cpu_seconds() const { return process_cpu_seconds() - cpu_start_; }
+  double wall_seconds() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         wall_start_)
+        .count();
+  }
+  // Average number of cores kept busy.
+  double cores() const {
+    auto wall = wall_seconds();
+    return wall > 0 ? cpu_seconds() / wall : 0;
+  }
+
+private:
+  double cpu_start_;
+  std::chrono::steady_clock::time_point wall_start_;
+};
@@ -0,0 +1,537 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "gateway.hpp"
+#include "metrics.hpp"
+#include "mqtt_client_cpp.hpp"
+#include "probe_payload.hpp"
+#include "received_msg.hpp"
+#include "reconnect_engine.hpp"
+#include "shared_payload.hpp"
+#include "spdlog/spdlog.h"
+#include "topic_router.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <thread>
+
+namespace {
+
+using client_t = decltype(MQTT_NS::make_async_client(
+    std::declval<boost::asio::io_context &>(), std::string(),
+    std::uint16_t()));
+using packet_id_t =
+    std::remove_reference_t<decltype(*std::declval<client_t>())>::packet_id_t;
+
+constexpr std::size_t _BATCH = 256;
+
+// The payload to republish for a received message; may be a slice of the
+// message's own buffer, which costs no copy.
+using transform_t = std::function<MQTT_NS::buffer(const received_msg &)>;
+
+// A received message bound for one route.
+struct job {
+  received_msg msg;
+  std::uint32_t route = 0;
+};
+
+// A transformed message on its way to the publishing client.
+struct out_msg {
+  MQTT_NS::buffer topic;
+  MQTT_NS::buffer payload;
+  std::int64_t recv_ns = 0;
+  // When it entered the current queue.
+  std::int64_t queued_ns = 0;
+};
+
+struct gateway_metrics {
+  metric_counter received;
+  metric_counter unrouted;
+  metric_counter transform_errors;
+  metric_counter published;
+  metric_counter publish_dropped;
+  metric_gauge transform_depth;
+  metric_gauge publish_depth;
+  metric_histogram receive_service;
+  metric_histogram transform_wait;
+  metric_histogram transform_service;
+  metric_histogram publish_wait;
+  metric_histogram publish_service;
+  metric_histogram total;
+};
+
+const gateway_metrics &metrics() {
+  static const gateway_metrics m = [] {
+    auto &r = metrics_registry::instance();
+    return gateway_metrics{
+        r.counter("gateway_msgs_received_total", "Messages received"),
+        r.counter("gateway_msgs_unrouted_total",
+                  "Messages matching no route"),
+        r.counter("gateway_transform_errors_total",
+                  "Messages the transform threw on"),
+        r.counter("gateway_msgs_published_total", "Messages republished"),
+        r.counter("gateway_publish_dropped_total",
+                  "Messages dropped while the publisher was disconnected"),
+        r.gauge("gateway_transform_queue_depth",
+                "Messages queued for the workers"),
+        r.gauge("gateway_publish_queue_depth",
+                "Messages queued for the publisher"),
+        r.histogram("gateway_receive_service_ns",
+                    "Routing and queueing a received message"),
+        r.histogram("gateway_transform_wait_ns",
+                    "Time queued before a worker took the message"),
+        r.histogram("gateway_transform_service_ns", "Time in the transform"),
+        r.histogram("gateway_publish_wait_ns",
+                    "Time queued before the publisher took the message"),
+        r.histogram("gateway_publish_service_ns",
+                    "Publisher to the client's async_publish call"),
+        r.histogram("gateway_total_ns",
+                    "Receipt to the client's async_publish call")};
+  }();
+  return m;
+}
+
+// Polling for a stage thread: yields while traffic is likely to resume at
+// once, then sleeps, so an idle gateway gives its cores back.
+class idle_backoff {
+public:
+  void idle() {
+    if (++idle_ < 1000) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+  void busy() { idle_ = 0; }
+
+private:
+  unsigned idle_ = 0;
+};
+
+MQTT_NS::buffer copy_transformed(std::string_view in,
+                                 void (*f)(const char *, std::size_t,
+                                           char *)) {
+  std::shared_ptr<char[]> p(new char[in.size()]);
+  f(in.data(), in.size(), p.get());
+  MQTT_NS::string_view view(p.get(), in.size());
+  return MQTT_NS::buffer(view, std::move(p));
+}
+
+transform_t make_transform(std::string_view spec) {
+  if (spec == "echo") {
+    return [](const received_msg &m) { return m.payload; };
+  }
+  if (spec == "upper") {
+    return [](const received_msg &m) {
+      return copy_transformed(m.payload_view(), [](const char *in,
+                                                   std::size_t n, char *out) {
+        for (std::size_t i = 0; i < n; ++i) {
+          out[i] = static_cast<char>(
+              std::toupper(static_cast<unsigned char>(in[i])));
+        }
+      });
+    };
+  }
+  if (spec == "reverse") {
+    return [](const received_msg &m) {
+      return copy_transformed(
+          m.payload_view(), [](const char *in, std::size_t n, char *out) {
+            std::reverse_copy(in, in + n, out);
+          });
+    };
+  }
+  if (spec.substr(0, 5) == "spin:") {
+    auto arg = spec.substr(5);
+    std::int64_t us = 0;
+    auto [end, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), us);
+    if (ec == std::errc() && end == arg.data() + arg.size() && us >= 0) {
+      return [ns = us * 1000](const received_msg &m) {
+        auto until = get_ns() + ns;
+        while (get_ns() < until) {
+        }
+        return m.payload;
+      };
+    }
+  }
+  throw std::invalid_argument("unknown transform: " + std::string(spec));
+}
+
+} // namespace
+
+struct gateway::impl {
+  explicit impl(gateway_config c)
+      : config(std::move(c)), transform(make_transform(config.transform)),
+        out_queue(config.queue_capacity, config.when_full),
+        sub(MQTT_NS::make_async_client(sub_ioc, config.broker.host,
+                                       config.broker.port)),
+        pub(MQTT_NS::make_async_client(pub_ioc, config.broker.host,
+                                       config.broker.port)),
+        sub_reconnect(sub_ioc, backoff_policy{},
+                      [this] { connect(sub, sub_reconnect); }),
+        pub_reconnect(pub_ioc, backoff_policy{},
+                      [this] { connect(pub, pub_reconnect); }) {
+    config.workers = std::max<std::size_t>(config.workers, 1);
+    // With nothing to subscribe to, the subscriber would never be ready.
+    if (config.routes.empty()) {
+      throw std::invalid_argument("gateway: no routes");
+    }
+    for (std::uint32_t i = 0; i < config.routes.size(); ++i) {
+      auto &r = config.routes[i];
+      if (r.out_topic.empty()) {
+        throw std::invalid_argument("gateway: no output topic for " +
+                                    r.filter);
+      }
+      router.add(r.filter, i);
+      out_topics.push_back(static_buffer(r.out_topic));
+    }
+    for (std::size_t k = 0; k < config.workers; ++k) {
+      work_queues.push_back(std::make_unique<mpsc_queue<job>>(
+          config.queue_capacity, config.when_full));
+    }
+    metrics();
+
+    setup(sub, sub_reconnect, sub_up, "_in");
+    setup(pub, pub_reconnect, pub_up, "_out");
+    sub->set_connack_handler([this](bool, MQTT_NS::connect_return_code rc) {
+      if (rc == MQTT_NS::connect_return_code::accepted) {
+        sub_up = true;
+        sub_reconnect.on_connected();
+        suback_pending = subscribe_routes(*sub, router, qos());
+      }
+      return true;
+    });
+    sub->set_suback_handler(
+        [this](packet_id_t, std::vector<MQTT_NS::suback_return_code>) {
+          if (--suback_pending == 0 && !sub_ready_set) {
+            sub_ready_set = true;
+            sub_ready.set_value();
+          }
+          return true;
+        });
+    sub->set_publish_handler([this](MQTT_NS::optional<packet_id_t>,
+                                    MQTT_NS::publish_options,
+                                    MQTT_NS::buffer topic_name,
+                                    MQTT_NS::buffer contents) {
+      receive(std::move(topic_name), std::move(contents));
+      return true;
+    });
+    pub->set_connack_handler([this](bool, MQTT_NS::connect_return_code rc) {
+      if (rc == MQTT_NS::connect_return_code::accepted) {
+        pub_up = true;
+        pub_reconnect.on_connected();
+        if (!pub_ready_set) {
+          pub_ready_set = true;
+          pub_ready.set_value();
+        }
+      }
+      return true;
+    });
+
+    auto sub_done = sub_ready.get_future();
+    auto pub_done = pub_ready.get_future();
+    boost::asio::post(sub_ioc, [this] { connect(sub, sub_reconnect); });
+    boost::asio::post(pub_ioc, [this] { connect(pub, pub_reconnect); });
+    sub_thread = std::thread([this] { sub_ioc.run(); });
+    pub_thread = std::thread([this] { pub_ioc.run(); });
+    for (std::size_t k = 0; k < config.workers; ++k) {
+      workers.emplace_back([this, k] { transform_stage(*work_queues[k]); });
+    }
+    publisher = std::thread([this] { publish_stage(); });
+
+    using namespace std::chrono_literals;
+    if (sub_done.wait_for(10s) != std::future_status::ready ||
+        pub_done.wait_for(10s) != std::future_status::ready) {
+      stop();
+      throw std::runtime_error("gateway: could not connect to " +
+                               config.broker.describe());
+    }
+  }
+
+  ~impl() { stop(); }
+
+  // Stops the stages front to back, each once the one before it is gone, so
+  // nothing is left blocked on a full queue.
+  void stop() {
+    if (stopped.exchange(true)) {
+      return;
+    }
+    shutdown(sub_ioc, sub, sub_reconnect, sub_thread);
+    workers_running = false;
+    for (auto &t : workers) {
+      t.join();
+    }
+    publisher_running = false;
+    publisher.join();
+    shutdown(pub_ioc, pub, pub_reconnect, pub_thread);
+  }
+
+  // Disconnects c on its io thread and waits for the connection to close
+  // (a second at most, should the broker not answer) before stopping and
+  // joining that thread.
+  static void shutdown(boost::asio::io_context &ioc, client_t &c,
+                       reconnect_engine &reconnect, std::thread &thread) {
+    auto closed = std::make_shared<std::promise<void>>();
+    auto done = closed->get_future();
+    boost::asio::post(ioc, [&c, &reconnect, closed] {
+      reconnect.stop();
+      if (!c->connected()) {
+        closed->set_value();
+        return;
+      }
+      // Close or error, whichever comes first; both run on this thread.
+      auto once = [closed, set = std::make_shared<bool>(false)] {
+        if (!*set) {
+          *set = true;
+          closed->set_value();
+        }
+      };
+      c->set_close_handler(once);
+      c->set_error_handler([once](MQTT_NS::error_code) { once(); });
+      c->async_disconnect();
+    });
+    done.wait_for(std::chrono::seconds(1));
+    ioc.stop();
+    thread.join();
+  }
+
+  void setup(client_t &c, reconnect_engine &reconnect, std::atomic_bool &up,
+             const char *suffix) {
+    c->set_client_id(config.client_id + suffix);
+    c->set_keep_alive_sec(10);
+    c->set_clean_session(true);
+    c->set_close_handler([&reconnect, &up] {
+      up = false;
+      reconnect.retry();
+    });
+    c->set_error_handler([&reconnect, &up, suffix](MQTT_NS::error_code ec) {
+      up = false;
+      spdlog::error("gateway{}: {}", suffix, ec.message());
+      reconnect.retry();
+    });
+  }
+
+  static void connect(client_t &c, reconnect_engine &reconnect) {
+    c->async_connect([&reconnect](MQTT_NS::error_code ec) {
+      if (ec && ec != boost::asio::error::operation_aborted) {
+        reconnect.retry();
+      }
+    });
+  }
+
+  // Receive stage, on the sub client's io thread.
+  void receive(MQTT_NS::buffer topic, MQTT_NS::buffer payload) {
+    auto &m = metrics();
+    auto now = get_ns();
+    m.received.add();
+    sub_reconnect.on_message();
+    std::string_view name(topic.data(), topic.size());
+    auto &queue =
+        *work_queues[std::hash<std::string_view>{}(name) % work_queues.size()];
+    auto routes = router.match(name, [&](std::uint32_t route) {
+      queue.push(job{{topic, payload, now}, route});
+    });
+    if (!routes) {
+      m.unrouted.add();
+    }
+    m.receive_service.record(get_ns() - now);
+  }
+
+  MQTT_NS::buffer out_topic(const job &j) const {
+    const auto &out = config.routes[j.route].out_topic;
+    if (out.back() != '/') {
+      return out_topics[j.route];
+    }
+    auto name = out + std::string(j.msg.topic_view());
+    return MQTT_NS::allocate_buffer(name.begin(), name.end());
+  }
+
+  void transform_stage(mpsc_queue<job> &queue) {
+    auto &m = metrics();
+    std::vector<job> jobs;
+    jobs.reserve(_BATCH);
+    idle_backoff backoff;
+    while (workers_running) {
+      if (!queue.pop_bulk(std::back_inserter(jobs), _BATCH)) {
+        backoff.idle();
+        continue;
+      }
+      backoff.busy();
+      for (auto &j : jobs) {
+        auto start = get_ns();
+        m.transform_wait.record(start - j.msg.recv_ns);
+        MQTT_NS::buffer payload;
+        try {
+          payload = transform(j.msg);
+        } catch (const std::exception &e) {
+          m.transform_errors.add();
+          spdlog::warn("gateway: transform failed on {}: {}",
+                       j.msg.topic_view(), e.what());
+          continue;
+        }
+        auto done = get_ns();
+        m.transform_service.record(done - start);
+        out_queue.push({out_topic(j), std::move(payload), j.msg.recv_ns,
+                        done});
+      }
+      // Dropping the slices releases the receive buffers.
+      jobs.clear();
+    }
+  }
+
+  // Publish stage: batches go to the pub client's io thread, which alone may
+  // call into the client. While the publisher is disconnected, messages stay
+  // in the output queue, under its --queue-full policy, rather than being
+  // handed over and dropped; only a batch already on its way when the
+  // connection goes is dropped, and counted.
+  void publish_stage() {
+    auto &m = metrics();
+    std::vector<out_msg> batch;
+    idle_backoff backoff;
+    while (publisher_running) {
+      m.transform_depth.set(static_cast<std::int64_t>(transform_depth()));
+      m.publish_depth.set(static_cast<std::int64_t>(out_queue.size_approx()));
+      if (!pub_up) {
+        backoff.idle();
+        continue;
+      }
+      batch.reserve(_BATCH);
+      if (!out_queue.pop_bulk(std::back_inserter(batch), _BATCH)) {
+        backoff.idle();
+        continue;
+      }
+      backoff.busy();
+      auto now = get_ns();
+      for (auto &o : batch) {
+        m.publish_wait.record(now - o.queued_ns);
+        o.queued_ns = now;
+      }
+      boost::asio::post(pub_ioc, [this, batch = std::move(batch)] {
+        auto &m = metrics();
+        auto now = get_ns();
+        if (!pub->connected()) {
+          m.publish_dropped.add(batch.size());
+          return;
+        }
+        for (auto &o : batch) {
+          pub->async_publish(o.topic, o.payload, qos());
+          m.publish_service.record(now - o.queued_ns);
+          m.total.record(now - o.recv_ns);
+        }
+        m.published.add(batch.size());
+      });
+      batch = {};
+    }
+  }
+
+  MQTT_NS::qos qos() const { return static_cast<MQTT_NS::qos>(config.qos); }
+
+  std::size_t transform_depth() const {
+    std::size_t n = 0;
+    for (auto &q : work_queues) {
+      n += q->size_approx();
+    }
+    return n;
+  }
+
+  gateway_config config;
+  transform_t transform;
+  topic_router<std::uint32_t> router;
+  std::vector<MQTT_NS::buffer> out_topics;
+  std::vector<std::unique_ptr<mpsc_queue<job>>> work_queues;
+  mpsc_queue<out_msg> out_queue;
+  std::atomic_bool workers_running{true};
+  std::atomic_bool publisher_running{true};
+  std::atomic_bool stopped{false};
+  // Connected, as seen by the io threads.
+  std::atomic_bool sub_up{false};
+  std::atomic_bool pub_up{false};
+
+  boost::asio::io_context sub_ioc;
+  boost::asio::io_context pub_ioc;
+  client_t sub;
+  client_t pub;
+  reconnect_engine sub_reconnect;
+  reconnect_engine pub_reconnect;
+  // Only touched on the io threads.
+  std::size_t suback_pending = 0;
+  bool sub_ready_set = false;
+  bool pub_ready_set = false;
+  std::promise<void> sub_ready;
+  std::promise<void> pub_ready;
+
+  std::thread sub_thread;
+  std::thread pub_thread;
+  std::vector<std::thread> workers;
+  std::thread publisher;
+};
+
+gateway::gateway(gateway_config config)
+    : impl_(std::make_unique<impl>(std::move(config))) {}
+
+gateway::~gateway() = default;
+
+gateway_stats gateway::stats() const {
+  auto snapshot = metrics_registry::instance().snapshot();
+  auto counter = [&](const char *name) -> std::uint64_t {
+    for (auto &c : snapshot.counters) {
+      if (c.name == name) {
+        return static_cast<std::uint64_t>(c.value);
+      }
+    }
+    return 0;
+  };
+  auto histogram = [&](const char *name) {
+    for (auto &h : snapshot.histograms) {
+      if (h.name == name) {
+        return h.histogram;
+      }
+    }
+    return latency_histogram();
+  };
+
+  gateway_stats s;
+  s.received = counter("gateway_msgs_received_total");
+  s.unrouted = counter("gateway_msgs_unrouted_total");
+  s.transform_errors = counter("gateway_transform_errors_total");
+  s.published = counter("gateway_msgs_published_total");
+  s.dropped = counter("gateway_publish_dropped_total") +
+              impl_->out_queue.dropped();
+  for (auto &q : impl_->work_queues) {
+    s.dropped += q->dropped();
+  }
+  s.stages.push_back({"receive", 0, 0, latency_histogram(),
+                      histogram("gateway_receive_service_ns")});
+  s.stages.push_back({"transform", impl_->transform_depth(),
+                      impl_->work_queues.size() *
+                          impl_->work_queues.front()->capacity(),
+                      histogram("gateway_transform_wait_ns"),
+                      histogram("gateway_transform_service_ns")});
+  s.stages.push_back({"publish", impl_->out_queue.size_approx(),
+                      impl_->out_queue.capacity(),
+                      histogram("gateway_publish_wait_ns"),
+                      histogram("gateway_publish_service_ns")});
+  s.total = histogram("gateway_total_ns");
+  return s;
+}
+
+std::ostream &operator<<(std::ostream &os, const gateway_stats &s) {
+  os << "received=" << s.received << " unrouted=" << s.unrouted
+     << " dropped=" << s.dropped << " transform_errors=" << s.transform_errors
+     << " published=" << s.published;
+  for (auto &st : s.stages) {
+    os << "\n  " << st.name;
+    if (st.queue_capacity) {
+      os << " queue " << st.queue_depth << "/" << st.queue_capacity
+         << "\n    wait " << st.wait;
+    }
+    os << "\n    service " << st.service;
+  }
+  return os << "\n  total " << s.total;
+}
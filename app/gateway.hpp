@@ -0,0 +1,170 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "bench_options.hpp"
+#include "broker_address.hpp"
+#include "latency_histogram.hpp"
+#include "mpsc_queue.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Messages on topics matching filter go out on out_topic; an out_topic
+// ending in '/' is a prefix put in front of the input topic instead. An
+// output that matches some route's filter comes straight back in, so keep
+// the two trees apart.
+struct gateway_route {
+  std::string filter;
+  std::string out_topic;
+
+  // "<filter>=<out_topic>"
+  static std::optional<gateway_route> parse(std::string_view spec) {
+    auto eq = spec.find('=');
+    if (eq == 0 || eq == std::string_view::npos || eq + 1 == spec.size()) {
+      return std::nullopt;
+    }
+    return gateway_route{std::string(spec.substr(0, eq)),
+                         std::string(spec.substr(eq + 1))};
+  }
+};
+
+// Gateway settings, from the command line:
+//
+//   --broker=<url> --routes=<filter>=<topic>,... --transform=<name>
+//   --workers=<n> --queue-capacity=<msgs> --queue-full=block|drop-oldest|
+//   drop-newest --qos=0|1|2 --client-id=<prefix>
+//
+// The default route, hello_delay_tx=hello_delay_rx, is the echo the round
+// trip tests expect. Transforms, run on the worker threads:
+//
+//   echo        the payload unchanged (shares the receive buffer)
+//   upper       an ASCII upper-cased copy
+//   reverse     a byte-reversed copy
+//   spin:<us>   echo after <us> microseconds of busy work, standing in for
+//               real processing
+struct gateway_config {
+  broker_address broker;
+  std::vector<gateway_route> routes{{"hello_delay_tx", "hello_delay_rx"}};
+  std::string transform = "echo";
+  std::size_t workers = 2;
+  // Capacity of each stage queue, and what a full one does. block pushes
+  // back all the way to the broker connection.
+  std::size_t queue_capacity = 4096;
+  full_policy when_full = full_policy::block;
+  int qos = 0;
+  std::string client_id = "gateway";
+
+  // Throws std::invalid_argument for malformed values; an unknown transform
+  // is only caught by the gateway's constructor.
+  static gateway_config from_options(const bench_options &opts) {
+    gateway_config c;
+    if (opts.has("broker")) {
+      auto a = broker_address::parse(opts.get("broker", ""));
+      if (!a || a->is_unix()) {
+        throw std::invalid_argument("--broker: expected tcp://host:port");
+      }
+      c.broker = *a;
+    }
+    if (opts.has("routes")) {
+      c.routes.clear();
+      std::istringstream is(opts.get("routes", ""));
+      for (std::string spec; std::getline(is, spec, ',');) {
+        auto r = gateway_route::parse(spec);
+        if (!r) {
+          throw std::invalid_argument("--routes: bad route " + spec);
+        }
+        c.routes.push_back(*r);
+      }
+      if (c.routes.empty()) {
+        throw std::invalid_argument("--routes: no routes");
+      }
+    }
+    c.transform = opts.get("transform", c.transform);
+    c.workers = std::max<std::size_t>(opts.get("workers", c.workers), 1);
+    c.queue_capacity = opts.get("queue-capacity", c.queue_capacity);
+    auto full = opts.get("queue-full", "block");
+    if (full == "drop-oldest") {
+      c.when_full = full_policy::drop_oldest;
+    } else if (full == "drop-newest") {
+      c.when_full = full_policy::drop_newest;
+    } else if (full != "block") {
+      throw std::invalid_argument("--queue-full: " + full);
+    }
+    c.qos = std::clamp(opts.get("qos", c.qos), 0, 2);
+    c.client_id = opts.get("client-id", c.client_id);
+    return c;
+  }
+};
+
+// One stage of the pipeline: what waits in front of it, and for how long.
+struct gateway_stage_stats {
+  std::string name;
+  std::size_t queue_depth = 0;
+  std::size_t queue_capacity = 0;
+  // Time in the queue in front of the stage, and inside the stage.
+  latency_histogram wait;
+  latency_histogram service;
+};
+
+struct gateway_stats {
+  std::uint64_t received = 0;
+  std::uint64_t unrouted = 0;
+  std::uint64_t dropped = 0;
+  std::uint64_t transform_errors = 0;
+  std::uint64_t published = 0;
+  // receive, transform, publish
+  std::vector<gateway_stage_stats> stages;
+  // From receipt to the hand-over to the publishing client.
+  latency_histogram total;
+};
+
+std::ostream &operator<<(std::ostream &os, const gateway_stats &s);
+
+// A subscribe-transform-republish bridge, run as a pipeline of three stages
+// connected by bounded queues:
+//
+//   receive    the subscribing client's io thread matches the topic against
+//              the routes (topic_router) and queues the message, as slices
+//              of the receive buffer, to a worker picked by topic hash, so
+//              messages of one topic stay in order;
+//   transform  --workers threads, one queue each, run the transform;
+//   publish    one thread drains the shared output queue and hands batches
+//              to the publishing client's io thread.
+//
+// Every stage records how long messages waited in front of it and spent in
+// it, into the metrics registry (gateway_* names), so the usual metrics
+// exporter publishes them too; stats() reads them back together with the
+// current queue depths. Both clients reconnect on their own, and the
+// subscriptions are restored, routes batched into few SUBSCRIBE packets.
+//
+// The constructor returns once both clients are connected and subscribed,
+// and throws std::runtime_error if that takes more than 10 s, or
+// std::invalid_argument for a bad route or transform. The metrics
+// are process-wide, so stats() assumes one gateway per process. Nothing in
+// this header depends on mqtt_cpp, so Paho programs can embed a gateway too.
+class gateway {
+public:
+  explicit gateway(gateway_config config);
+  ~gateway();
+
+  gateway(const gateway &) = delete;
+  gateway &operator=(const gateway &) = delete;
+
+  gateway_stats stats() const;
+
+private:
+  struct impl;
+  std::unique_ptr<impl> impl_;
+};
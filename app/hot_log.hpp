@@ -0,0 +1,231 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "spdlog/spdlog.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(SPDLOG_FMT_EXTERNAL)
+#include <fmt/args.h>
+#else
+#include "spdlog/fmt/bundled/args.h"
+#endif
+
+// Logging off the message hot path.
+//
+// hot_log() copies the logger, level, a format string literal and up to
+// hot_log_max_args numeric arguments into a preallocated per-thread ring and
+// returns; nothing is formatted, allocated or written on the calling thread.
+// A background thread drains every ring, formats the records and passes them
+// to spdlog with their original timestamps. When a ring is full the record is
+// dropped and counted. Until hot_log_backend::start() is called, hot_log()
+// logs synchronously through spdlog, so the mode can be switched per run.
+
+constexpr std::size_t hot_log_max_args = 4;
+
+namespace hot_log_detail {
+
+struct arg {
+  bool is_double;
+  union {
+    std::int64_t i;
+    double d;
+  };
+};
+
+struct record {
+  spdlog::logger *logger;
+  spdlog::log_clock::time_point time;
+  const char *fmt;
+  spdlog::level::level_enum level;
+  std::uint8_t nargs;
+  arg args[hot_log_max_args];
+};
+
+template <typename T> arg make_arg(T v) {
+  static_assert(std::is_arithmetic_v<T>,
+                "hot_log only takes numeric arguments");
+  arg a;
+  if constexpr (std::is_floating_point_v<T>) {
+    a.is_double = true;
+    a.d = v;
+  } else {
+    a.is_double = false;
+    a.i = static_cast<std::int64_t>(v);
+  }
+  return a;
+}
+
+// Single-producer/single-consumer ring owned by one logging thread.
+class ring {
+public:
+  explicit ring(std::size_t capacity) : records_(capacity) {}
+
+  bool push(const record &r) {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == records_.size()) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    records_[tail % records_.size()] = r;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  template <typename F> std::size_t drain(F f) {
+    auto head = head_.load(std::memory_order_relaxed);
+    auto tail = tail_.load(std::memory_order_acquire);
+    for (auto i = head; i != tail; ++i) {
+      f(records_[i % records_.size()]);
+    }
+    head_.store(tail, std::memory_order_release);
+    return tail - head;
+  }
+
+  std::uint64_t dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::vector<record> records_;
+  alignas(64) std::atomic<std::size_t> head_{0};
+  alignas(64) std::atomic<std::size_t> tail_{0};
+  alignas(64) std::atomic<std::uint64_t> dropped_{0};
+};
+
+} // namespace hot_log_detail
+
+class hot_log_backend {
+public:
+  static hot_log_backend &instance() {
+    static hot_log_backend backend;
+    return backend;
+  }
+
+  void start(std::size_t ring_capacity = 8192,
+             std::chrono::microseconds idle_sleep =
+                 std::chrono::microseconds(1000)) {
+    ring_capacity_ = ring_capacity;
+    running_ = true;
+    thread_ = std::thread([this, idle_sleep] {
+      while (running_.load(std::memory_order_relaxed)) {
+        if (drain() == 0) {
+          std::this_thread::sleep_for(idle_sleep);
+        }
+      }
+      drain();
+    });
+  }
+
+  void stop() {
+    if (!running_.exchange(false)) {
+      return;
+    }
+    thread_.join();
+  }
+
+  bool enabled() const { return running_.load(std::memory_order_relaxed); }
+
+  // Background thread, e.g. to control its CPU placement.
+  std::thread &thread() { return thread_; }
+
+  std::uint64_t dropped() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::uint64_t n = 0;
+    for (auto &r : rings_) {
+      n += r->dropped();
+    }
+    return n;
+  }
+
+  hot_log_detail::ring &local_ring() {
+    // Registered once per thread; rings live as long as the backend so
+    // records of exited threads are still drained.
+    static thread_local hot_log_detail::ring *local = nullptr;
+    if (!local) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      rings_.push_back(std::make_unique<hot_log_detail::ring>(ring_capacity_));
+      local = rings_.back().get();
+    }
+    return *local;
+  }
+
+private:
+  hot_log_backend() = default;
+  ~hot_log_backend() { stop(); }
+
+  std::size_t drain() {
+    std::vector<hot_log_detail::ring *> rings;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto &r : rings_) {
+        rings.push_back(r.get());
+      }
+    }
+    std::size_t n = 0;
+    for (auto r : rings) {
+      n += r->drain([](hot_log_detail::record const &rec) {
+        fmt::dynamic_format_arg_store<fmt::format_context> store;
+        for (std::uint8_t i = 0; i < rec.nargs; ++i) {
+          if (rec.args[i].is_double) {
+            store.push_back(rec.args[i].d);
+          } else {
+            store.push_back(rec.args[i].i);
+          }
+        }
+        // Format strings are only checked here, on the drain thread; one
+        // that does not fit its arguments must not take the thread down.
+        std::string msg;
+        try {
+          msg = fmt::vformat(rec.fmt, store);
+        } catch (const fmt::format_error &) {
+          rec.logger->log(rec.time, spdlog::source_loc{}, spdlog::level::err,
+                          std::string("hot_log: bad format string \"") +
+                              rec.fmt + "\"");
+          return;
+        }
+        rec.logger->log(rec.time, spdlog::source_loc{}, rec.level, msg);
+      });
+    }
+    return n;
+  }
+
+  std::atomic_bool running_ = false;
+  std::size_t ring_capacity_ = 8192;
+  std::thread thread_;
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<hot_log_detail::ring>> rings_;
+};
+
+// fmt must be a string literal (or otherwise outlive the backend thread).
+template <typename... Args>
+void hot_log(spdlog::logger &logger, spdlog::level::level_enum level,
+             const char *fmt, Args... args) {
+  static_assert(sizeof...(Args) <= hot_log_max_args, "too many arguments");
+  if (!logger.should_log(level)) {
+    return;
+  }
+  auto &backend = hot_log_backend::instance();
+  if (!backend.enabled()) {
+    logger.log(level, fmt::runtime(fmt), args...);
+    return;
+  }
+  backend.local_ring().push({&logger,
+                             spdlog::log_clock::now(),
+                             fmt,
+                             level,
+                             static_cast<std::uint8_t>(sizeof...(Args)),
+                             {hot_log_detail::make_arg(args)...}});
+}
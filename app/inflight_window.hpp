@@ -0,0 +1,111 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "latency_histogram.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+// Bounded window of QoS 1/2 publishes awaiting acknowledgement.
+//
+// Send times are kept in a flat array indexed by packet id, so tracking a
+// publish and matching its ack are a single store and load with no
+// allocation, for any window up to the whole 16-bit packet id space. A
+// publish leaves the window on PUBACK (QoS 1) or PUBCOMP (QoS 2); the time
+// to each ack, and to PUBREC, is recorded separately.
+class inflight_window {
+public:
+  static constexpr std::size_t max_limit = 65535;
+
+  explicit inflight_window(std::size_t limit)
+      : limit_(std::clamp<std::size_t>(limit, 1, max_limit)),
+        send_ns_(new std::int64_t[max_limit + 1]()) {}
+
+  std::size_t limit() const { return limit_; }
+  std::size_t in_flight() const { return in_flight_; }
+  bool full() const { return in_flight_ >= limit_; }
+  std::uint64_t completed() const { return completed_; }
+
+  void on_publish(std::uint16_t packet_id, std::int64_t send_ns) {
+    if (!send_ns_[packet_id]) {
+      ++in_flight_;
+    }
+    send_ns_[packet_id] = send_ns;
+  }
+
+  // Each returns false for a packet id the window does not know about.
+  bool on_puback(std::uint16_t packet_id, std::int64_t now_ns) {
+    return complete(packet_id, now_ns, puback_);
+  }
+  bool on_pubrec(std::uint16_t packet_id, std::int64_t now_ns) {
+    if (!send_ns_[packet_id]) {
+      return false;
+    }
+    pubrec_.record(now_ns - send_ns_[packet_id]);
+    return true;
+  }
+  bool on_pubcomp(std::uint16_t packet_id, std::int64_t now_ns) {
+    return complete(packet_id, now_ns, pubcomp_);
+  }
+
+  // Forgets everything in flight, e.g. when a clean session is started.
+  void clear() {
+    std::fill(send_ns_.get(), send_ns_.get() + max_limit + 1, 0);
+    in_flight_ = 0;
+  }
+
+  const latency_histogram &puback_latency() const { return puback_; }
+  const latency_histogram &pubrec_latency() const { return pubrec_; }
+  const latency_histogram &pubcomp_latency() const { return pubcomp_; }
+
+private:
+  bool complete(std::uint16_t packet_id, std::int64_t now_ns,
+                latency_histogram &h) {
+    if (!send_ns_[packet_id]) {
+      return false;
+    }
+    h.record(now_ns - send_ns_[packet_id]);
+    send_ns_[packet_id] = 0;
+    --in_flight_;
+    ++completed_;
+    return true;
+  }
+
+  std::size_t limit_;
+  std::size_t in_flight_ = 0;
+  std::uint64_t completed_ = 0;
+  // 0 marks a free slot; steady-clock ns are never 0 in practice.
+  std::unique_ptr<std::int64_t[]> send_ns_;
+  latency_histogram puback_;
+  latency_histogram pubrec_;
+  latency_histogram pubcomp_;
+};
+
+inline std::ostream &operator<<(std::ostream &os, const inflight_window &w) {
+  os << "window=" << w.limit() << " completed=" << w.completed();
+  if (w.puback_latency().count()) {
+    os << "\n  publish->puback " << w.puback_latency();
+  }
+  if (w.pubrec_latency().count()) {
+    os << "\n  publish->pubrec " << w.pubrec_latency();
+  }
+  if (w.pubcomp_latency().count()) {
+    os << "\n  publish->pubcomp " << w.pubcomp_latency();
+  }
+  return os;
+}
+
+inline std::string to_string(const inflight_window &w) {
+  std::ostringstream os;
+  os << w;
+  return os.str();
+}
@@ -0,0 +1,78 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "io_context_runner.hpp"
+#include <algorithm>
+#include <boost/asio/io_context.hpp>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Fixed set of io_contexts, each run by one thread. Clients are spread over
+// them round-robin, so all handlers of a given client run on a single thread
+// and per-client state needs no locking.
+class io_context_pool {
+public:
+  explicit io_context_pool(std::size_t size) {
+    for (std::size_t i = 0; i < std::max<std::size_t>(size, 1); ++i) {
+      iocs_.push_back(std::make_unique<boost::asio::io_context>(1));
+    }
+  }
+
+  ~io_context_pool() { stop(); }
+
+  std::size_t size() const { return iocs_.size(); }
+
+  boost::asio::io_context &next() {
+    return *iocs_[next_++ % iocs_.size()];
+  }
+
+  // The k-th io_context, the one run by the k-th thread.
+  boost::asio::io_context &at(std::size_t k) { return *iocs_[k]; }
+
+  // on_start(k) runs first on the k-th thread, e.g. to pin it to a CPU.
+  void run(run_mode mode = run_mode::blocking,
+           std::chrono::microseconds spin_budget =
+               std::chrono::microseconds(50),
+           std::function<void(std::size_t)> on_start = {}) {
+    for (auto &ioc : iocs_) {
+      runners_.push_back(
+          std::make_unique<io_context_runner>(*ioc, mode, spin_budget));
+    }
+    for (std::size_t k = 0; k < runners_.size(); ++k) {
+      threads_.emplace_back([this, k, on_start] {
+        if (on_start) {
+          on_start(k);
+        }
+        runners_[k]->run();
+      });
+    }
+  }
+
+  void stop() {
+    for (auto &runner : runners_) {
+      runner->stop();
+    }
+    for (auto &t : threads_) {
+      t.join();
+    }
+    threads_.clear();
+  }
+
+  // Valid after stop().
+  const std::vector<std::unique_ptr<io_context_runner>> &runners() const {
+    return runners_;
+  }
+
+private:
+  std::vector<std::unique_ptr<boost::asio::io_context>> iocs_;
+  std::vector<std::unique_ptr<io_context_runner>> runners_;
+  std::vector<std::thread> threads_;
+  std::size_t next_ = 0;
+};
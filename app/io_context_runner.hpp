@@ -0,0 +1,133 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "cpu_usage.hpp"
+#include <atomic>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// How a thread drives its io_context.
+enum class run_mode {
+  blocking,  // run(): sleeps in epoll when idle, lowest CPU
+  busy_poll, // poll() in a loop: lowest wake-up latency, burns a core
+  hybrid,    // poll() while work keeps arriving, block after a spin budget
+};
+
+inline std::optional<run_mode> parse_run_mode(std::string_view s) {
+  if (s == "blocking") {
+    return run_mode::blocking;
+  }
+  if (s == "busy-poll") {
+    return run_mode::busy_poll;
+  }
+  if (s == "hybrid") {
+    return run_mode::hybrid;
+  }
+  return std::nullopt;
+}
+
+inline const char *to_string(run_mode mode) {
+  switch (mode) {
+  case run_mode::blocking:
+    return "blocking";
+  case run_mode::busy_poll:
+    return "busy-poll";
+  case run_mode::hybrid:
+    return "hybrid";
+  }
+  return "?";
+}
+
+// Runs an io_context on the calling thread with a work guard, so it does not
+// return just because it is momentarily idle. It returns once the io_context
+// is stopped, or once keep_running (if given) turns false, which is checked
+// every 100 ms so a signal handler only has to clear a flag. The CPU time of
+// the running thread and the number of handlers executed are kept for
+// reporting.
+class io_context_runner {
+public:
+  io_context_runner(boost::asio::io_context &ioc, run_mode mode,
+                    std::chrono::microseconds spin_budget =
+                        std::chrono::microseconds(50),
+                    const std::atomic_bool *keep_running = nullptr)
+      : ioc_(ioc), mode_(mode), spin_budget_(spin_budget),
+        keep_running_(keep_running), watch_timer_(ioc) {}
+
+  void run() {
+    auto guard = boost::asio::make_work_guard(ioc_);
+    if (keep_running_) {
+      watch();
+    }
+    auto cpu_start = thread_cpu_seconds();
+    auto wall_start = std::chrono::steady_clock::now();
+    switch (mode_) {
+    case run_mode::blocking:
+      handlers_ += ioc_.run();
+      break;
+    case run_mode::busy_poll:
+      while (!ioc_.stopped()) {
+        handlers_ += ioc_.poll();
+      }
+      break;
+    case run_mode::hybrid: {
+      auto last_work = std::chrono::steady_clock::now();
+      while (!ioc_.stopped()) {
+        if (auto n = ioc_.poll()) {
+          handlers_ += n;
+          last_work = std::chrono::steady_clock::now();
+        } else if (std::chrono::steady_clock::now() - last_work >
+                   spin_budget_) {
+          handlers_ += ioc_.run_one();
+          last_work = std::chrono::steady_clock::now();
+        }
+      }
+      break;
+    }
+    }
+    cpu_seconds_ = thread_cpu_seconds() - cpu_start;
+    wall_seconds_ = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - wall_start)
+                        .count();
+  }
+
+  void stop() { ioc_.stop(); }
+
+  run_mode mode() const { return mode_; }
+  double cpu_seconds() const { return cpu_seconds_; }
+  double wall_seconds() const { return wall_seconds_; }
+  std::uint64_t handlers() const { return handlers_; }
+
+private:
+  void watch() {
+    watch_timer_.expires_after(std::chrono::milliseconds(100));
+    watch_timer_.async_wait([this](boost::system::error_code const &error) {
+      if (error) {
+        return;
+      }
+      if (!*keep_running_) {
+        ioc_.stop();
+        return;
+      }
+      watch();
+    });
+  }
+
+  boost::asio::io_context &ioc_;
+  run_mode mode_;
+  std::chrono::microseconds spin_budget_;
+  const std::atomic_bool *keep_running_;
+  boost::asio::steady_timer watch_timer_;
+  std::uint64_t handlers_ = 0;
+  double cpu_seconds_ = 0;
+  double wall_seconds_ = 0;
+};
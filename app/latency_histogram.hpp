@@ -0,0 +1,176 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Fixed-memory, log-bucketed latency histogram in the spirit of HdrHistogram.
+//
+// Values are nanoseconds. Values below 2^sub_bucket_bits are stored exactly,
+// larger values land in one of 2^(sub_bucket_bits - 1) linear sub-buckets of
+// their power of two, which bounds the relative error of any percentile to
+// 1 / 2^(sub_bucket_bits - 1) (~0.8%). record() is O(1) and never allocates;
+// two histograms can be merged, so each thread records into its own instance
+// and the owner merges them after joining.
+class latency_histogram {
+public:
+  static constexpr int sub_bucket_bits = 8;
+  // Values at or above 2^max_value_bits ns (~4.9 hours) share the last bucket.
+  static constexpr int max_value_bits = 44;
+  static constexpr std::size_t half_sub_bucket_count = std::size_t(1)
+                                                       << (sub_bucket_bits - 1);
+  static constexpr std::size_t bucket_count =
+      (max_value_bits - sub_bucket_bits + 2) * half_sub_bucket_count;
+
+  void record(std::int64_t ns) {
+    auto v = static_cast<std::uint64_t>(std::max<std::int64_t>(ns, 0));
+    ++counts_[index_of(v)];
+    ++count_;
+    min_ = std::min(min_, v);
+    max_ = std::max(max_, v);
+    auto d = static_cast<double>(v);
+    sum_ += d;
+    sum_sq_ += d * d;
+  }
+
+  // Adds n samples of value ns at once, e.g. when rebuilding a histogram from
+  // bucket counts kept elsewhere.
+  void record(std::int64_t ns, std::uint64_t n) {
+    if (n == 0) {
+      return;
+    }
+    auto v = static_cast<std::uint64_t>(std::max<std::int64_t>(ns, 0));
+    counts_[index_of(v)] += n;
+    count_ += n;
+    min_ = std::min(min_, v);
+    max_ = std::max(max_, v);
+    auto d = static_cast<double>(v);
+    sum_ += d * n;
+    sum_sq_ += d * d * n;
+  }
+
+  void merge(const latency_histogram &other) {
+    for (std::size_t i = 0; i < bucket_count; ++i) {
+      counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+    sum_ += other.sum_;
+    sum_sq_ += other.sum_sq_;
+  }
+
+  void reset() { *this = latency_histogram(); }
+
+  std::uint64_t count() const { return count_; }
+  std::uint64_t min() const { return count_ ? min_ : 0; }
+  std::uint64_t max() const { return max_; }
+  double mean() const { return count_ ? sum_ / count_ : 0; }
+  double stddev() const {
+    if (count_ == 0) {
+      return 0;
+    }
+    auto m = mean();
+    return std::sqrt(std::max(sum_sq_ / count_ - m * m, 0.0));
+  }
+
+  // Smallest recorded bucket bound such that at least q (0..1) of the samples
+  // are at or below it.
+  std::uint64_t percentile(double q) const {
+    if (count_ == 0) {
+      return 0;
+    }
+    auto rank = static_cast<std::uint64_t>(std::ceil(q * count_));
+    rank = std::clamp<std::uint64_t>(rank, 1, count_);
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < bucket_count; ++i) {
+      seen += counts_[i];
+      if (seen >= rank) {
+        return std::clamp(highest_equivalent(i), min_, max_);
+      }
+    }
+    return max_;
+  }
+
+  // Bucket of a value, and the largest value that lands in a bucket.
+  static std::size_t index_of(std::uint64_t v) {
+    v = std::min(v, (std::uint64_t(1) << max_value_bits) - 1);
+    if (v < (std::uint64_t(1) << sub_bucket_bits)) {
+      return static_cast<std::size_t>(v);
+    }
+    int msb = highest_bit(v);
+    int shift = msb - sub_bucket_bits + 1;
+    return shift * half_sub_bucket_count + static_cast<std::size_t>(v >> shift);
+  }
+
+  static std::uint64_t highest_equivalent(std::size_t index) {
+    if (index < (std::size_t(1) << sub_bucket_bits)) {
+      return index;
+    }
+    auto shift = index / half_sub_bucket_count - 1;
+    auto mantissa = index - shift * half_sub_bucket_count;
+    return ((std::uint64_t(mantissa) + 1) << shift) - 1;
+  }
+
+private:
+  // Index of the highest set bit; v must not be 0.
+  static int highest_bit(std::uint64_t v) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long i;
+    _BitScanReverse64(&i, v);
+    return static_cast<int>(i);
+#elif defined(_MSC_VER)
+    unsigned long i;
+    if (_BitScanReverse(&i, static_cast<unsigned long>(v >> 32))) {
+      return static_cast<int>(i) + 32;
+    }
+    _BitScanReverse(&i, static_cast<unsigned long>(v));
+    return static_cast<int>(i);
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+  }
+
+  std::array<std::uint64_t, bucket_count> counts_{};
+  std::uint64_t count_ = 0;
+  std::uint64_t min_ = std::numeric_limits<std::uint64_t>::max();
+  std::uint64_t max_ = 0;
+  double sum_ = 0;
+  double sum_sq_ = 0;
+};
+
+// One-line summary in milliseconds. Use to_string() when logging via spdlog.
+inline std::ostream &operator<<(std::ostream &os, const latency_histogram &h) {
+  auto ms = [](double ns) { return ns * 1e-6; };
+  auto flags = os.flags();
+  os << std::fixed << std::setprecision(3) << "n=" << h.count()
+     << " mean=" << ms(h.mean()) << " std=" << ms(h.stddev())
+     << " p50=" << ms(h.percentile(0.50)) << " p90=" << ms(h.percentile(0.90))
+     << " p99=" << ms(h.percentile(0.99))
+     << " p99.9=" << ms(h.percentile(0.999)) << " max=" << ms(h.max())
+     << " ms";
+  os.flags(flags);
+  return os;
+}
+
+inline std::string to_string(const latency_histogram &h) {
+  std::ostringstream os;
+  os << h;
+  return os.str();
+}
@@ -4,9 +4,20 @@
 // (See accompanying file LICENSE_1_0.txt or copy at
 // http://www.boost.org/LICENSE_1_0.txt)
 
+#include "bench_options.hpp"
+#include "inflight_window.hpp"
+#include "latency_histogram.hpp"
+#include "metrics.hpp"
 #include "mqtt_client_cpp.hpp"
+#include "open_loop_publisher.hpp"
+#include "outbound_journal.hpp"
+#include "probe_payload.hpp"
+#include "reconnect_engine.hpp"
 #include <chrono>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <vector>
 
 using namespace std::chrono_literals;
 
@@ -14,76 +25,132 @@ constexpr auto _TOPIC = "hello_echo";
 constexpr auto _QOS = MQTT_NS::qos::at_most_once;
 constexpr auto _HOST = "localhost";
 constexpr auto _PORT = 1883;
-
-auto get_ms() {
-  return std::chrono::steady_clock::now().time_since_epoch().count() * 1e-6;
-}
+constexpr auto _REPORT_EVERY = 1000;
+constexpr auto _PUBLISHER_ID = 1;
 
 // This example shows the client reconnecting to the broker
 //
-// The client connects to the server and published a total of 100 messages,
-// if the connection was lost a new connection will be established.
+// The client connects to the server and publishes until stopped, or until
+// --count messages are done: acknowledged at QoS 1/2, written to the socket
+// at QoS 0. If the connection is lost a new connection will be established.
+// Reconnects back off exponentially with jitter (see reconnect_engine.hpp
+// for the options), and the broker address is resolved only once when it
+// has a single address (see resolve_once()).
 //
 // Important: please note that messages are only republished to the broker if
 // the broker still has an active session for this client. If it does not,
 // the client will start with a new session and not resend offline stored
 // messages
 //
+// With --journal=<file> (and optionally --journal-size=<bytes>), every
+// message is appended to a memory-mapped journal first, only sent while
+// connected, and kept until it is acknowledged (PUBACK/PUBCOMP, or written
+// for QoS 0). Pending messages are replayed after every connect, including
+// the first one after a restart. The journal is synced to disk every
+// --journal-sync-ms (100 by default). Window mode does not use the journal.
+//
+// --qos=0|1|2 sets the publish and subscribe QoS. --window=N, with --qos=1
+// or 2, switches to pipelined publishing: up to N (at most 65535) publishes
+// are kept in flight, a new one is sent as each PUBACK/PUBCOMP arrives, and
+// the run stops after --count (100 by default) acknowledged messages. The
+// ack throughput and the PUBLISH->PUBACK, ->PUBREC and ->PUBCOMP times are
+// reported, so the window that maximises throughput can be found by
+// sweeping N.
+//
 
-template <typename C>
-void reconnect_client(boost::asio::steady_timer &timer, C &c) {
-  std::cout << "Start reconnect timer" << std::endl;
-  // Set an expiry time relative to now.
-  timer.expires_after(std::chrono::seconds(1));
-  timer.async_wait([&timer, &c](const boost::system::error_code &error) {
-    if (error != boost::asio::error::operation_aborted) {
-      std::cout << "Reconnect now !!" << std::endl;
-
-      // Connect
-      c->async_connect(
-          // [optional] checking underlying layer completion code
-          [&timer, &c](MQTT_NS::error_code ec) {
-            std::cout << "async_connect callback: " << ec.message()
-                      << std::endl;
-            if (ec && ec != boost::asio::error::operation_aborted) {
-              reconnect_client(timer, c);
-            }
-          });
-    }
-  });
-}
-
-template <typename C>
-void publish_msg(boost::asio::steady_timer &timer, C &c,
-                 unsigned int &packet_counter) {
-  // Publish a message every 5 seconds
+template <typename Publish>
+void publish_msg(boost::asio::steady_timer &timer, Publish &publish,
+                 probe_encoder &probe) {
+  // Publish a message every millisecond
   timer.expires_after(1ms);
   timer.async_wait(
-      [&timer, &c, &packet_counter](boost::system::error_code const &error) {
+      [&timer, &publish, &probe](boost::system::error_code const &error) {
         if (error != boost::asio::error::operation_aborted) {
-          c->async_publish(_TOPIC, std::to_string(get_ms()), _QOS);
-          publish_msg(timer, c, packet_counter);
+          publish(probe.next());
+          publish_msg(timer, publish, probe);
         }
       });
 }
 
+// Writes the journal back every period, so the cost of msync is paid once
+// per batch of publishes and acks rather than per message.
+void sync_journal(boost::asio::steady_timer &timer, outbound_journal &journal,
+                  std::chrono::milliseconds period) {
+  timer.expires_after(period);
+  timer.async_wait([&timer, &journal,
+                    period](boost::system::error_code const &error) {
+    if (error != boost::asio::error::operation_aborted) {
+      journal.sync();
+      sync_journal(timer, journal, period);
+    }
+  });
+}
+
 int main(int argc, char **argv) {
   MQTT_NS::setup_log();
+  bench_options opts(argc, argv);
 
   boost::asio::io_context ioc;
 
   boost::asio::steady_timer publish_timer(ioc);
-  boost::asio::steady_timer reconnect_timer(ioc);
-  unsigned int packet_counter = 1;
+  boost::asio::steady_timer journal_timer(ioc);
+  latency_histogram latency;
+  sequence_tracker sequence;
+  probe_encoder probe(_PUBLISHER_ID,
+                      opts.get("payload-size", probe_header_size));
+  // Open-loop mode when --rate > 0 msgs/s, otherwise a 1 ms re-armed timer.
+  std::optional<send_schedule> schedule;
+  if (auto rate = opts.get("rate", 0.0); rate > 0) {
+    schedule.emplace(rate, opts.get("poisson", false));
+  }
+  latency_histogram lag;
+  auto qos = static_cast<MQTT_NS::qos>(opts.get("qos", int(_QOS)));
+  auto count = opts.get("count", std::size_t(100));
+  std::optional<inflight_window> window;
+  if (opts.has("window")) {
+    if (qos == MQTT_NS::qos::at_most_once) {
+      // QoS 0 publishes are never acknowledged, so the window never drains.
+      std::cerr << "--window needs --qos=1 or --qos=2" << std::endl;
+      return 1;
+    }
+    window.emplace(opts.get("window", std::size_t(1)));
+  }
+  // Per-packet output would dominate a pipelined run.
+  bool verbose = !window;
+  std::int64_t window_start_ns = 0;
+  std::unique_ptr<outbound_journal> journal;
+  if (opts.has("journal")) {
+    journal = std::make_unique<outbound_journal>(
+        opts.get("journal", ""),
+        opts.get("journal-size", std::size_t(64) << 20));
+    std::cout << "journal " << journal->get().recovered
+              << " pending messages recovered" << std::endl;
+  }
+  // Journal record of each QoS 1/2 publish in flight, by packet id.
+  std::vector<std::optional<outbound_journal::entry>> journaled(65536);
+  bool connected = false;
 
-  auto c = MQTT_NS::make_async_client(ioc, _HOST, _PORT);
+  auto c = MQTT_NS::make_async_client(ioc, resolve_once(_HOST, _PORT), _PORT);
+  reconnect_engine reconnect(ioc, backoff_policy::from_options(opts), [&] {
+    std::cout << "Reconnect now !!" << std::endl;
+    c->async_connect(
+        // [optional] checking underlying layer completion code
+        [&](MQTT_NS::error_code ec) {
+          std::cout << "async_connect callback: " << ec.message()
+                    << std::endl;
+          if (ec && ec != boost::asio::error::operation_aborted) {
+            reconnect.retry();
+          }
+        });
+  });
 
   using packet_id_t =
       typename std::remove_reference_t<decltype(*c)>::packet_id_t;
 
   auto disconnect = [&]() {
     publish_timer.cancel();
-    reconnect_timer.cancel();
+    reconnect.stop();
+    journal_timer.cancel();
     c->async_disconnect(
         // [optional] checking async_disconnect completion code
         [](MQTT_NS::error_code ec) {
@@ -92,6 +159,113 @@ int main(int argc, char **argv) {
         });
   };
 
+  auto &metrics = client_metrics();
+  auto count_sent = [&](std::size_t bytes) {
+    metrics.msgs_sent.add();
+    metrics.bytes_sent.add(bytes);
+  };
+
+  // With --count, outside window mode, the run ends once that many messages
+  // are done: acknowledged at QoS 1/2, written to the socket at QoS 0.
+  // Without it the client runs until stopped.
+  bool counted = opts.has("count");
+  std::size_t done = 0;
+  auto on_done = [&] {
+    if (counted && ++done == count) {
+      disconnect();
+    }
+  };
+
+  // Sends a message, remembering which journal record it came from.
+  auto send = [&](std::string_view payload,
+                  std::optional<outbound_journal::entry> e) {
+    if (qos == MQTT_NS::qos::at_most_once) {
+      count_sent(payload.size());
+      c->async_publish(_TOPIC, std::string(payload), qos,
+                       [&journal, &on_done, e](MQTT_NS::error_code ec) {
+                         if (ec) {
+                           return;
+                         }
+                         if (e) {
+                           journal->ack(*e);
+                         }
+                         on_done();
+                       });
+      return;
+    }
+    auto packet_id = c->acquire_unique_packet_id_no_except();
+    if (!packet_id) {
+      // Left in the journal for the next replay.
+      return;
+    }
+    journaled[*packet_id] = e;
+    count_sent(payload.size());
+    c->async_publish(*packet_id, _TOPIC, std::string(payload), qos);
+  };
+  auto publish = [&](std::string_view payload) {
+    if (!journal) {
+      count_sent(payload.size());
+      if (qos == MQTT_NS::qos::at_most_once) {
+        c->async_publish(_TOPIC, std::string(payload), qos,
+                         [&on_done](MQTT_NS::error_code ec) {
+                           if (!ec) {
+                             on_done();
+                           }
+                         });
+      } else {
+        c->async_publish(_TOPIC, std::string(payload), qos);
+      }
+      return;
+    }
+    // When the journal is full the message is still sent, unjournaled.
+    auto e = journal->append(_TOPIC, payload, static_cast<std::uint8_t>(qos));
+    if (connected) {
+      send(payload, e);
+    }
+  };
+  auto ack_journal = [&](packet_id_t packet_id) {
+    if (auto &e = journaled[packet_id]) {
+      journal->ack(*e);
+      e.reset();
+    }
+  };
+
+  // Pipelined mode: keep the window full of QoS 1/2 publishes. Publishes
+  // dropped from it by a clean-session reconnect are made up for with new
+  // ones, so the run still ends after count acknowledged messages.
+  auto fill_window = [&] {
+    while (!window->full() &&
+           window->completed() + window->in_flight() < count) {
+      auto packet_id = c->acquire_unique_packet_id_no_except();
+      if (!packet_id) {
+        break;
+      }
+      auto now = get_ns();
+      window->on_publish(*packet_id, now);
+      auto payload = probe.next(now);
+      count_sent(payload.size());
+      c->async_publish(*packet_id, _TOPIC, std::string(payload), qos);
+    }
+    metrics.inflight.set(window->in_flight());
+  };
+  auto report_window = [&] {
+    auto seconds = (get_ns() - window_start_ns) * 1e-9;
+    std::cout << "acked " << window->completed() << " in " << seconds
+              << " s (" << window->completed() / seconds << " msgs/s), "
+              << window->in_flight() << " in flight" << std::endl;
+  };
+  auto on_acked = [&] {
+    metrics.inflight.set(window->in_flight());
+    if (window->completed() % _REPORT_EVERY == 0) {
+      report_window();
+    }
+    if (window->completed() == count) {
+      disconnect();
+      return;
+    }
+    fill_window();
+  };
+
   c->set_client_id("reconnect_client");
   c->set_keep_alive_sec(10);
   c->set_clean_session(true);
@@ -104,14 +278,36 @@ int main(int argc, char **argv) {
     std::cout << "Connack Return Code: "
               << MQTT_NS::connect_return_code_to_str(connack_return_code)
               << std::endl;
+    connected =
+        connack_return_code == MQTT_NS::connect_return_code::accepted;
+    if (connected) {
+      reconnect.on_connected();
+    }
 
-    c->async_subscribe(_TOPIC, _QOS,
+    c->async_subscribe(_TOPIC, qos,
                        // [optional] checking async_subscribe completion code
                        [](MQTT_NS::error_code ec) {
                          std::cout
                              << "async_subscribe callback: " << ec.message()
                              << std::endl;
                        });
+    if (journal && connected) {
+      std::fill(journaled.begin(), journaled.end(), std::nullopt);
+      auto n = journal->replay([&](outbound_journal::entry e, std::string_view,
+                                   std::string_view payload,
+                                   std::uint8_t) { send(payload, e); });
+      std::cout << "journal replayed " << n << " messages" << std::endl;
+    }
+    if (window) {
+      if (!sp) {
+        // Nothing in flight survives a clean session.
+        window->clear();
+      }
+      if (!window_start_ns) {
+        window_start_ns = get_ns();
+      }
+      fill_window();
+    }
     return true;
   });
   c->set_suback_handler([&](packet_id_t packet_id,
@@ -122,27 +318,51 @@ int main(int argc, char **argv) {
     }
     return true;
   });
-  c->set_close_handler([]() { std::cout << "closed." << std::endl; });
+  c->set_close_handler([&]() {
+    connected = false;
+    std::cout << "closed." << std::endl;
+  });
 
   c->set_error_handler([&](MQTT_NS::error_code ec) {
+    connected = false;
     std::cout << "error: " << ec.message() << std::endl;
-    reconnect_client(reconnect_timer, c);
+    reconnect.retry();
   });
 
   c->set_puback_handler([&](packet_id_t packet_id) {
+    if (window) {
+      if (window->on_puback(packet_id, get_ns())) {
+        on_acked();
+      }
+      return true;
+    }
+    if (journal) {
+      ack_journal(packet_id);
+    }
     std::cout << "puback received. packet_id: " << packet_id << std::endl;
+    on_done();
     return true;
   });
-  c->set_pubrec_handler([](packet_id_t packet_id) {
+  c->set_pubrec_handler([&](packet_id_t packet_id) {
+    if (window) {
+      window->on_pubrec(packet_id, get_ns());
+      return true;
+    }
     std::cout << "pubrec received. packet_id: " << packet_id << std::endl;
     return true;
   });
   c->set_pubcomp_handler([&](packet_id_t packet_id) {
-    std::cout << "pubcomp received. packet_id: " << packet_id << std::endl;
-    if (packet_counter == 100) {
-      disconnect();
+    if (window) {
+      if (window->on_pubcomp(packet_id, get_ns())) {
+        on_acked();
+      }
+      return true;
+    }
+    if (journal) {
+      ack_journal(packet_id);
     }
-    packet_counter += 1;
+    std::cout << "pubcomp received. packet_id: " << packet_id << std::endl;
+    on_done();
     return true;
   });
 
@@ -150,15 +370,36 @@ int main(int argc, char **argv) {
                              MQTT_NS::publish_options pubopts,
                              MQTT_NS::buffer topic_name,
                              MQTT_NS::buffer contents) {
-    std::cout << "publish received."
-              << " dup: " << pubopts.get_dup() << " qos: " << pubopts.get_qos()
-              << " retain: " << pubopts.get_retain() << std::endl;
-    if (packet_id)
-      std::cout << "packet_id: " << *packet_id << std::endl;
-    std::cout << "topic_name: " << topic_name << std::endl;
-    std::cout << "contents: " << contents << std::endl;
-    std::cout << "time elapsed : "
-              << (get_ms() - std::stod(contents.to_string())) << " ms\n";
+    if (verbose) {
+      std::cout << "publish received."
+                << " dup: " << pubopts.get_dup()
+                << " qos: " << pubopts.get_qos()
+                << " retain: " << pubopts.get_retain() << std::endl;
+      if (packet_id)
+        std::cout << "packet_id: " << *packet_id << std::endl;
+      std::cout << "topic_name: " << topic_name << std::endl;
+    }
+    metrics.msgs_received.add();
+    metrics.bytes_received.add(contents.size());
+    probe_header h;
+    if (!decode_probe(contents.data(), contents.size(), h)) {
+      std::cout << "contents: " << contents << std::endl;
+      sequence.on_malformed();
+      return true;
+    }
+    reconnect.on_message();
+    sequence.on_receive(h);
+    auto delay = probe_age_ns(h);
+    latency.record(delay);
+    metrics.latency.record(delay);
+    if (verbose) {
+      std::cout << "seq: " << h.seq << std::endl;
+      std::cout << "time elapsed : " << delay * 1e-6 << " ms\n";
+    }
+    if (latency.count() % _REPORT_EVERY == 0) {
+      std::cout << "latency " << latency << std::endl;
+      std::cout << "sequence " << sequence.get() << std::endl;
+    }
     return true;
   });
 
@@ -168,11 +409,42 @@ int main(int argc, char **argv) {
       [&](MQTT_NS::error_code ec) {
         std::cout << "async_connect callback: " << ec.message() << std::endl;
         if (ec) {
-          reconnect_client(reconnect_timer, c);
+          reconnect.retry();
         }
       });
-  publish_msg(publish_timer, c, packet_counter);
+  if (window) {
+    // Publishing starts from the connack handler.
+  } else if (schedule) {
+    schedule->start(get_ns());
+    publish_open_loop(publish_timer, *schedule, lag,
+                      [&](std::int64_t intended_ns) {
+                        publish(probe.next(intended_ns));
+                      });
+  } else {
+    publish_msg(publish_timer, publish, probe);
+  }
+  if (journal) {
+    sync_journal(journal_timer, *journal,
+                 std::chrono::milliseconds(opts.get("journal-sync-ms", 100)));
+  }
+  metrics_exporter exporter(metrics_options::from_options(opts));
   ioc.run();
+  std::cout << "latency " << latency << std::endl;
+  if (schedule) {
+    std::cout << "publish lag " << lag << std::endl;
+  }
+  std::cout << "sequence " << sequence.get() << std::endl;
+  std::cout << "reconnect " << reconnect << std::endl;
+  if (window) {
+    report_window();
+    std::cout << "inflight " << *window << std::endl;
+  }
+  if (journal) {
+    auto &js = journal->get();
+    std::cout << "journal appended=" << js.appended << " acked=" << js.acked
+              << " rejected=" << js.rejected << " pending bytes="
+              << journal->used() << std::endl;
+  }
 
   return 0;
 }
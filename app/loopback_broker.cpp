@@ -0,0 +1,375 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "loopback_broker.hpp"
+#include "mqtt_server_cpp.hpp"
+#include "probe_payload.hpp"
+#include "uds_transport.hpp"
+#if defined(MQTT_USE_TLS)
+#include "tls_identity.hpp"
+#endif
+#include <algorithm>
+#include <cstdio>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using server_t = MQTT_NS::server<>;
+#if defined(MQTT_USE_TLS)
+using tls_server_t = MQTT_NS::server_tls<>;
+#endif
+#if defined(MQTT_USE_WS)
+using ws_server_t = MQTT_NS::server_ws<>;
+#endif
+#if defined(MQTT_USE_TLS) && defined(MQTT_USE_WS)
+using wss_server_t = MQTT_NS::server_tls_ws<>;
+#endif
+using con_t = server_t::endpoint_t;
+using con_sp_t = std::shared_ptr<con_t>;
+using packet_id_t = con_t::packet_id_t;
+
+// MQTT topic filter matching with '+' (one level) and '#' (rest of the tree).
+bool topic_matches(MQTT_NS::string_view filter, MQTT_NS::string_view topic) {
+  while (true) {
+    auto f = filter.substr(0, filter.find('/'));
+    if (f == "#") {
+      return true;
+    }
+    auto t = topic.substr(0, topic.find('/'));
+    if (f != "+" && f != t) {
+      return false;
+    }
+    bool filter_done = f.size() == filter.size();
+    bool topic_done = t.size() == topic.size();
+    if (filter_done || topic_done) {
+      // "a/#" also matches "a" itself.
+      return topic_done && (filter_done || filter.substr(f.size()) == "/#");
+    }
+    filter.remove_prefix(f.size() + 1);
+    topic.remove_prefix(t.size() + 1);
+  }
+}
+
+struct subscription {
+  std::string filter;
+  con_sp_t con;
+  MQTT_NS::qos qos;
+};
+
+} // namespace
+
+struct loopback_broker::impl {
+  impl(std::uint16_t port, std::string path)
+      : server(boost::asio::ip::tcp::endpoint(
+                   boost::asio::ip::make_address("127.0.0.1"), port),
+               ioc),
+        unix_path(std::move(path)) {
+    server.set_error_handler([](MQTT_NS::error_code) {});
+    server.set_accept_handler([this](con_sp_t spep) { accept(spep); });
+    server.listen();
+    if (!unix_path.empty()) {
+      std::remove(unix_path.c_str());
+      unix_acceptor.emplace(
+          ioc, boost::asio::local::stream_protocol::endpoint(unix_path));
+      accept_unix();
+    }
+    thread = std::thread([this] { ioc.run(); });
+  }
+
+  ~impl() {
+    boost::asio::post(ioc, [this] {
+      server.close();
+#if defined(MQTT_USE_TLS)
+      if (tls_server) {
+        tls_server->close();
+      }
+#endif
+#if defined(MQTT_USE_WS)
+      if (ws_server) {
+        ws_server->close();
+      }
+#endif
+#if defined(MQTT_USE_TLS) && defined(MQTT_USE_WS)
+      if (wss_server) {
+        wss_server->close();
+      }
+#endif
+      if (unix_acceptor) {
+        unix_acceptor->close();
+        std::remove(unix_path.c_str());
+      }
+      auto cons = std::move(connections);
+      subs.clear();
+      for (auto &con : cons) {
+        con->force_disconnect();
+      }
+    });
+    thread.join();
+  }
+
+  // Starts another mqtt_cpp server on the io thread. They all hand out the
+  // same endpoint type, so accept() serves every transport.
+  template <typename Server, typename... Args>
+  std::uint16_t listen(std::optional<Server> &slot, std::uint16_t port,
+                       Args &&...args) {
+    std::promise<std::uint16_t> bound;
+    auto result = bound.get_future();
+    boost::asio::post(ioc, [&] {
+      try {
+        slot.emplace(boost::asio::ip::tcp::endpoint(
+                         boost::asio::ip::make_address("127.0.0.1"), port),
+                     std::forward<Args>(args)..., ioc);
+        slot->set_error_handler([](MQTT_NS::error_code) {});
+        slot->set_accept_handler([this](con_sp_t spep) { accept(spep); });
+        slot->listen();
+        bound.set_value(slot->port());
+      } catch (...) {
+        bound.set_exception(std::current_exception());
+      }
+    });
+    return result.get();
+  }
+
+  // Unix domain connections get the same endpoint type, and handlers, as the
+  // TCP ones the server accepts; only the socket underneath differs.
+  void accept_unix() {
+    auto socket = std::make_shared<uds_socket>(ioc);
+    unix_acceptor->async_accept(
+        socket->next_layer(), [this, socket](boost::system::error_code ec) {
+          if (ec) {
+            return;
+          }
+          accept(std::make_shared<con_t>(
+              ioc, socket, MQTT_NS::protocol_version::undetermined));
+          accept_unix();
+        });
+  }
+
+  void accept(con_sp_t spep) {
+    auto &ep = *spep;
+    std::weak_ptr<con_t> wp(spep);
+    ep.start_session(std::move(spep));
+
+    ep.set_close_handler([this, wp] { close(wp.lock()); });
+    ep.set_error_handler([this, wp](MQTT_NS::error_code) { close(wp.lock()); });
+
+    ep.set_connect_handler([this, wp](MQTT_NS::buffer /*client_id*/,
+                                      MQTT_NS::optional<MQTT_NS::buffer>,
+                                      MQTT_NS::optional<MQTT_NS::buffer>,
+                                      MQTT_NS::optional<MQTT_NS::will>,
+                                      bool /*clean_session*/,
+                                      std::uint16_t /*keep_alive*/) {
+      auto sp = wp.lock();
+      connections.insert(sp);
+      sp->async_connack(false, MQTT_NS::connect_return_code::accepted);
+      return true;
+    });
+    ep.set_disconnect_handler([this, wp] { close(wp.lock()); });
+    // Keep-alive, for both protocol versions. mqtt_cpp leaves the answer to
+    // the server, and clients with a PINGRESP timeout hang up without one.
+    ep.set_pingreq_handler([wp] {
+      wp.lock()->async_pingresp();
+      return true;
+    });
+    ep.set_publish_handler([this](MQTT_NS::optional<packet_id_t>,
+                                  MQTT_NS::publish_options pubopts,
+                                  MQTT_NS::buffer topic_name,
+                                  MQTT_NS::buffer contents) {
+      forward(pubopts, topic_name, contents);
+      return true;
+    });
+    ep.set_subscribe_handler(
+        [this, wp](packet_id_t packet_id,
+                   std::vector<MQTT_NS::subscribe_entry> entries) {
+          auto sp = wp.lock();
+          std::vector<MQTT_NS::suback_return_code> res;
+          res.reserve(entries.size());
+          for (auto const &e : entries) {
+            res.emplace_back(
+                MQTT_NS::qos_to_suback_return_code(subscribe(sp, e)));
+          }
+          sp->async_suback(packet_id, std::move(res));
+          return true;
+        });
+    ep.set_unsubscribe_handler(
+        [this, wp](packet_id_t packet_id,
+                   std::vector<MQTT_NS::unsubscribe_entry> entries) {
+          auto sp = wp.lock();
+          unsubscribe(sp, entries);
+          sp->async_unsuback(packet_id);
+          return true;
+        });
+
+    // MQTT v5. Clients may alias topics towards the broker (incoming aliases
+    // are resolved by the endpoint before the publish handler runs), and
+    // forwarded topics are aliased towards clients that accept aliases.
+    ep.set_v5_connect_handler(
+        [this, wp](MQTT_NS::buffer /*client_id*/,
+                   MQTT_NS::optional<MQTT_NS::buffer>,
+                   MQTT_NS::optional<MQTT_NS::buffer>,
+                   MQTT_NS::optional<MQTT_NS::will>, bool /*clean_start*/,
+                   std::uint16_t /*keep_alive*/, MQTT_NS::v5::properties) {
+          auto sp = wp.lock();
+          connections.insert(sp);
+          sp->set_auto_map_topic_alias_send(true);
+          sp->async_connack(
+              false, MQTT_NS::v5::connect_reason_code::success,
+              MQTT_NS::v5::properties{
+                  MQTT_NS::v5::property::topic_alias_maximum(
+                      topic_alias_maximum)});
+          return true;
+        });
+    ep.set_v5_disconnect_handler(
+        [this, wp](MQTT_NS::v5::disconnect_reason_code,
+                   MQTT_NS::v5::properties) { close(wp.lock()); });
+    ep.set_v5_publish_handler(
+        [this](MQTT_NS::optional<packet_id_t>,
+               MQTT_NS::publish_options pubopts, MQTT_NS::buffer topic_name,
+               MQTT_NS::buffer contents, MQTT_NS::v5::properties) {
+          forward(pubopts, topic_name, contents);
+          return true;
+        });
+    ep.set_v5_subscribe_handler(
+        [this, wp](packet_id_t packet_id,
+                   std::vector<MQTT_NS::subscribe_entry> entries,
+                   MQTT_NS::v5::properties) {
+          auto sp = wp.lock();
+          std::vector<MQTT_NS::v5::suback_reason_code> res;
+          res.reserve(entries.size());
+          for (auto const &e : entries) {
+            res.emplace_back(
+                MQTT_NS::v5::qos_to_suback_reason_code(subscribe(sp, e)));
+          }
+          sp->async_suback(packet_id, std::move(res));
+          return true;
+        });
+    ep.set_v5_unsubscribe_handler(
+        [this, wp](packet_id_t packet_id,
+                   std::vector<MQTT_NS::unsubscribe_entry> entries,
+                   MQTT_NS::v5::properties) {
+          auto sp = wp.lock();
+          unsubscribe(sp, entries);
+          sp->async_unsuback(
+              packet_id, std::vector<MQTT_NS::v5::unsuback_reason_code>(
+                             entries.size(),
+                             MQTT_NS::v5::unsuback_reason_code::success));
+          return true;
+        });
+  }
+
+  MQTT_NS::qos subscribe(con_sp_t const &sp,
+                         MQTT_NS::subscribe_entry const &e) {
+    auto qos = e.subopts.get_qos();
+    subs.push_back({std::string(e.topic_filter), sp, qos});
+    return qos;
+  }
+
+  void unsubscribe(con_sp_t const &sp,
+                   std::vector<MQTT_NS::unsubscribe_entry> const &entries) {
+    for (auto const &e : entries) {
+      subs.erase(std::remove_if(subs.begin(), subs.end(),
+                                [&](subscription const &s) {
+                                  return s.con == sp &&
+                                         s.filter == e.topic_filter;
+                                }),
+                 subs.end());
+    }
+  }
+
+  void close(con_sp_t const &sp) {
+    if (!sp) {
+      return;
+    }
+    connections.erase(sp);
+    subs.erase(
+        std::remove_if(subs.begin(), subs.end(),
+                       [&](subscription const &s) { return s.con == sp; }),
+        subs.end());
+  }
+
+  void forward(MQTT_NS::publish_options pubopts, MQTT_NS::buffer topic_name,
+               MQTT_NS::buffer contents) {
+    auto start = get_ns();
+    for (auto const &s : subs) {
+      if (topic_matches(s.filter, topic_name)) {
+        // The buffers are ref-counted, so every subscriber shares the
+        // received payload without copying it.
+        s.con->async_publish(topic_name, contents,
+                             std::min(s.qos, pubopts.get_qos()));
+      }
+    }
+    auto elapsed = get_ns() - start;
+    std::lock_guard<std::mutex> lock(latency_mutex);
+    latency.record(elapsed);
+  }
+
+  static constexpr std::uint16_t topic_alias_maximum = 0xffff;
+
+  boost::asio::io_context ioc;
+  server_t server;
+  std::string unix_path;
+  std::optional<boost::asio::local::stream_protocol::acceptor> unix_acceptor;
+#if defined(MQTT_USE_TLS)
+  std::optional<tls_server_t> tls_server;
+#endif
+#if defined(MQTT_USE_WS)
+  std::optional<ws_server_t> ws_server;
+#endif
+#if defined(MQTT_USE_TLS) && defined(MQTT_USE_WS)
+  std::optional<wss_server_t> wss_server;
+#endif
+  std::set<con_sp_t> connections;
+  std::vector<subscription> subs;
+  mutable std::mutex latency_mutex;
+  latency_histogram latency;
+  std::thread thread;
+};
+
+loopback_broker::loopback_broker(std::uint16_t port, std::string unix_path)
+    : impl_(std::make_unique<impl>(port, std::move(unix_path))) {}
+
+loopback_broker::~loopback_broker() = default;
+
+std::uint16_t loopback_broker::port() const { return impl_->server.port(); }
+
+const std::string &loopback_broker::unix_path() const {
+  return impl_->unix_path;
+}
+
+#if defined(MQTT_USE_TLS)
+std::uint16_t loopback_broker::listen_tls(const std::string &cert_pem,
+                                          const std::string &key_pem,
+                                          std::uint16_t port) {
+  return impl_->listen(impl_->tls_server, port,
+                       tls_identity{cert_pem, key_pem}.server_context());
+}
+#endif
+
+#if defined(MQTT_USE_WS)
+std::uint16_t loopback_broker::listen_ws(std::uint16_t port) {
+  return impl_->listen(impl_->ws_server, port);
+}
+#endif
+
+#if defined(MQTT_USE_TLS) && defined(MQTT_USE_WS)
+std::uint16_t loopback_broker::listen_wss(const std::string &cert_pem,
+                                          const std::string &key_pem,
+                                          std::uint16_t port) {
+  return impl_->listen(impl_->wss_server, port,
+                       tls_identity{cert_pem, key_pem}.server_context());
+}
+#endif
+
+latency_histogram loopback_broker::forward_latency() const {
+  std::lock_guard<std::mutex> lock(impl_->latency_mutex);
+  return impl_->latency;
+}
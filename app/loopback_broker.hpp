@@ -0,0 +1,64 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "latency_histogram.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Minimal MQTT broker embedded in the benchmark process.
+//
+// It listens on 127.0.0.1 (an ephemeral port by default), and also on a Unix
+// domain socket when given a path, and runs on its own thread and io_context,
+// so benchmarks no longer depend on an external broker being up.
+// Subscriptions are kept per connection and matched with the usual
+// '+' / '#' wildcards; there are no retained messages, wills or persistent
+// sessions. MQTT v3.1.1 and v5 clients are accepted, with v5 topic aliases in
+// both directions. The time spent between receiving a PUBLISH and handing it to
+// every matching subscriber is recorded, so broker cost can be told apart
+// from client cost.
+class loopback_broker {
+public:
+  // An existing file at unix_path is replaced, and removed again on exit.
+  explicit loopback_broker(std::uint16_t port = 0, std::string unix_path = {});
+  ~loopback_broker();
+
+  loopback_broker(const loopback_broker &) = delete;
+  loopback_broker &operator=(const loopback_broker &) = delete;
+
+  const char *host() const { return "127.0.0.1"; }
+  std::uint16_t port() const;
+  // Empty unless listening on a Unix domain socket.
+  const std::string &unix_path() const;
+
+  // Additional listeners on 127.0.0.1 (an ephemeral port unless given),
+  // feeding the same broker: MQTT over TLS, WebSocket and WebSocket over
+  // TLS. The TLS ones present the PEM certificate and key. Each returns the
+  // port it listens on. Only in the loopback_broker_tls library, built with
+  // MQTT_USE_TLS and MQTT_USE_WS.
+#if defined(MQTT_USE_TLS)
+  std::uint16_t listen_tls(const std::string &cert_pem,
+                           const std::string &key_pem,
+                           std::uint16_t port = 0);
+#endif
+#if defined(MQTT_USE_WS)
+  std::uint16_t listen_ws(std::uint16_t port = 0);
+#endif
+#if defined(MQTT_USE_TLS) && defined(MQTT_USE_WS)
+  std::uint16_t listen_wss(const std::string &cert_pem,
+                           const std::string &key_pem,
+                           std::uint16_t port = 0);
+#endif
+
+  // Snapshot of the per-message forwarding time.
+  latency_histogram forward_latency() const;
+
+private:
+  struct impl;
+  std::unique_ptr<impl> impl_;
+};
@@ -0,0 +1,508 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "bench_options.hpp"
+#include "latency_histogram.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/write.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// In-process metrics: counters, gauges and latency histograms.
+//
+// Counters and histograms are recorded into a per-thread shard that only its
+// thread writes, with relaxed loads and stores: no lock, no read-modify-write
+// and no shared cache line, so recording costs a few nanoseconds. Gauges are
+// single shared atomics. snapshot() adds up the shards of every thread that
+// ever recorded; shards outlive their threads, so counts are never lost.
+// Metrics are registered by name (idempotent, takes a lock) and recorded
+// through the handle that returns, e.g.
+//
+//   static const metric_counter sent = metrics_registry::instance().counter(
+//       "mqtt_msgs_sent_total", "PUBLISH packets handed to the client");
+//   sent.add();
+
+namespace metrics_detail {
+
+constexpr std::size_t max_counters = 64;
+constexpr std::size_t max_gauges = 64;
+constexpr std::size_t max_histograms = 16;
+
+// Only the owning thread writes, so a plain load and store is enough.
+inline void bump(std::atomic<std::uint64_t> &a, std::uint64_t n) {
+  a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+// Bucket counts laid out like latency_histogram's.
+struct histogram_cells {
+  std::array<std::atomic<std::uint64_t>, latency_histogram::bucket_count>
+      buckets{};
+  std::atomic<std::uint64_t> sum_ns{0};
+
+  void record(std::int64_t ns) {
+    auto v = static_cast<std::uint64_t>(std::max<std::int64_t>(ns, 0));
+    bump(buckets[latency_histogram::index_of(v)], 1);
+    bump(sum_ns, v);
+  }
+
+  void add_to(latency_histogram &h, std::uint64_t &sum) const {
+    for (std::size_t i = 0; i < buckets.size(); ++i) {
+      h.record(latency_histogram::highest_equivalent(i),
+               buckets[i].load(std::memory_order_relaxed));
+    }
+    sum += sum_ns.load(std::memory_order_relaxed);
+  }
+};
+
+struct shard {
+  std::array<std::atomic<std::uint64_t>, max_counters> counters{};
+  // Allocated on the thread's first record() into each histogram.
+  std::array<std::atomic<histogram_cells *>, max_histograms> histograms{};
+
+  ~shard() {
+    for (auto &h : histograms) {
+      delete h.load();
+    }
+  }
+};
+
+} // namespace metrics_detail
+
+// Point-in-time totals of every registered metric.
+struct metrics_snapshot {
+  struct scalar {
+    std::string name;
+    std::string help;
+    std::int64_t value;
+  };
+  struct summary {
+    std::string name;
+    std::string help;
+    latency_histogram histogram;
+    std::uint64_t sum_ns;
+  };
+
+  std::int64_t unix_ms = 0;
+  std::vector<scalar> counters;
+  std::vector<scalar> gauges;
+  std::vector<summary> histograms;
+};
+
+class metrics_registry;
+
+// Handles returned by metrics_registry; cheap to copy and to keep in globals.
+class metric_counter {
+public:
+  void add(std::uint64_t n = 1) const;
+
+private:
+  friend class metrics_registry;
+  explicit metric_counter(std::size_t id) : id_(id) {}
+  std::size_t id_;
+};
+
+class metric_gauge {
+public:
+  void set(std::int64_t v) const {
+    value_->store(v, std::memory_order_relaxed);
+  }
+  void add(std::int64_t n) const {
+    value_->fetch_add(n, std::memory_order_relaxed);
+  }
+
+private:
+  friend class metrics_registry;
+  explicit metric_gauge(std::atomic<std::int64_t> *value) : value_(value) {}
+  std::atomic<std::int64_t> *value_;
+};
+
+// Values are nanoseconds.
+class metric_histogram {
+public:
+  void record(std::int64_t ns) const;
+
+private:
+  friend class metrics_registry;
+  explicit metric_histogram(std::size_t id) : id_(id) {}
+  std::size_t id_;
+};
+
+class metrics_registry {
+public:
+  static metrics_registry &instance() {
+    static metrics_registry registry;
+    return registry;
+  }
+
+  // Each throws std::length_error when its kind is full.
+  metric_counter counter(const std::string &name, const std::string &help) {
+    return metric_counter(
+        add(counters_, name, help, metrics_detail::max_counters));
+  }
+  metric_gauge gauge(const std::string &name, const std::string &help) {
+    return metric_gauge(
+        &gauge_values_[add(gauges_, name, help, metrics_detail::max_gauges)]);
+  }
+  metric_histogram histogram(const std::string &name,
+                             const std::string &help) {
+    return metric_histogram(
+        add(histograms_, name, help, metrics_detail::max_histograms));
+  }
+
+  metrics_snapshot snapshot() const {
+    metrics_snapshot s;
+    s.unix_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::system_clock::now().time_since_epoch())
+                    .count();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::size_t i = 0; i < counters_.size(); ++i) {
+      std::uint64_t total = 0;
+      for (auto &sh : shards_) {
+        total += sh->counters[i].load(std::memory_order_relaxed);
+      }
+      s.counters.push_back({counters_[i].name, counters_[i].help,
+                            static_cast<std::int64_t>(total)});
+    }
+    for (std::size_t i = 0; i < gauges_.size(); ++i) {
+      s.gauges.push_back({gauges_[i].name, gauges_[i].help,
+                          gauge_values_[i].load(std::memory_order_relaxed)});
+    }
+    for (std::size_t i = 0; i < histograms_.size(); ++i) {
+      metrics_snapshot::summary h{histograms_[i].name, histograms_[i].help,
+                                  latency_histogram(), 0};
+      for (auto &sh : shards_) {
+        if (auto cells = sh->histograms[i].load(std::memory_order_acquire)) {
+          cells->add_to(h.histogram, h.sum_ns);
+        }
+      }
+      s.histograms.push_back(std::move(h));
+    }
+    return s;
+  }
+
+private:
+  struct info {
+    std::string name;
+    std::string help;
+  };
+
+  metrics_registry() = default;
+
+  std::size_t add(std::vector<info> &kind, const std::string &name,
+                  const std::string &help, std::size_t max) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::size_t i = 0; i < kind.size(); ++i) {
+      if (kind[i].name == name) {
+        return i;
+      }
+    }
+    if (kind.size() == max) {
+      throw std::length_error("too many metrics: " + name);
+    }
+    kind.push_back({name, help});
+    return kind.size() - 1;
+  }
+
+  friend class metric_counter;
+  friend class metric_histogram;
+
+  static metrics_detail::shard &local_shard() {
+    // Registered once per thread; shards live as long as the registry.
+    static thread_local metrics_detail::shard *local = nullptr;
+    if (!local) {
+      auto &r = instance();
+      std::lock_guard<std::mutex> lock(r.mutex_);
+      r.shards_.push_back(std::make_unique<metrics_detail::shard>());
+      local = r.shards_.back().get();
+    }
+    return *local;
+  }
+
+  mutable std::mutex mutex_;
+  std::vector<info> counters_;
+  std::vector<info> gauges_;
+  std::vector<info> histograms_;
+  std::array<std::atomic<std::int64_t>, metrics_detail::max_gauges>
+      gauge_values_{};
+  std::vector<std::unique_ptr<metrics_detail::shard>> shards_;
+};
+
+inline void metric_counter::add(std::uint64_t n) const {
+  metrics_detail::bump(metrics_registry::local_shard().counters[id_], n);
+}
+
+inline void metric_histogram::record(std::int64_t ns) const {
+  auto &slot = metrics_registry::local_shard().histograms[id_];
+  auto cells = slot.load(std::memory_order_relaxed);
+  if (!cells) {
+    cells = new metrics_detail::histogram_cells();
+    slot.store(cells, std::memory_order_release);
+  }
+  cells->record(ns);
+}
+
+// The metrics every benchmark client records, so that names line up across
+// programs.
+struct mqtt_client_metrics {
+  metric_counter msgs_sent;
+  metric_counter msgs_received;
+  metric_counter bytes_sent;
+  metric_counter bytes_received;
+  metric_counter reconnects;
+  metric_gauge queue_depth;
+  metric_gauge inflight;
+  metric_histogram latency;
+};
+
+inline const mqtt_client_metrics &client_metrics() {
+  static const mqtt_client_metrics m = [] {
+    auto &r = metrics_registry::instance();
+    return mqtt_client_metrics{
+        r.counter("mqtt_msgs_sent_total", "PUBLISH packets handed to a client"),
+        r.counter("mqtt_msgs_received_total", "PUBLISH packets received"),
+        r.counter("mqtt_payload_bytes_sent_total", "Payload bytes published"),
+        r.counter("mqtt_payload_bytes_received_total",
+                  "Payload bytes received"),
+        r.counter("mqtt_reconnects_total", "Connections re-established"),
+        r.gauge("mqtt_queue_depth",
+                "Messages waiting for the publishing thread"),
+        r.gauge("mqtt_inflight", "QoS 1/2 publishes awaiting their ack"),
+        r.histogram("mqtt_latency_seconds",
+                    "Publish to receive latency of probe payloads")};
+  }();
+  return m;
+}
+
+// Histograms in microseconds, as in the mqtt_compare report.
+inline std::string to_json(const metrics_snapshot &s) {
+  std::ostringstream os;
+  os << "{\"unix_ms\": " << s.unix_ms << ", \"counters\": {";
+  for (std::size_t i = 0; i < s.counters.size(); ++i) {
+    os << (i ? ", " : "") << "\"" << s.counters[i].name
+       << "\": " << s.counters[i].value;
+  }
+  os << "}, \"gauges\": {";
+  for (std::size_t i = 0; i < s.gauges.size(); ++i) {
+    os << (i ? ", " : "") << "\"" << s.gauges[i].name
+       << "\": " << s.gauges[i].value;
+  }
+  os << "}, \"histograms\": {";
+  for (std::size_t i = 0; i < s.histograms.size(); ++i) {
+    auto &h = s.histograms[i].histogram;
+    os << (i ? ", " : "") << "\"" << s.histograms[i].name
+       << "\": {\"count\": " << h.count()
+       << ", \"sum_us\": " << s.histograms[i].sum_ns * 1e-3
+       << ", \"p50_us\": " << h.percentile(0.5) * 1e-3
+       << ", \"p90_us\": " << h.percentile(0.9) * 1e-3
+       << ", \"p99_us\": " << h.percentile(0.99) * 1e-3
+       << ", \"p999_us\": " << h.percentile(0.999) * 1e-3
+       << ", \"max_us\": " << h.max() * 1e-3 << "}";
+  }
+  os << "}}\n";
+  return os.str();
+}
+
+// Prometheus text exposition format; histograms become summaries in seconds.
+inline std::string to_prometheus(const metrics_snapshot &s) {
+  std::ostringstream os;
+  os << std::setprecision(9);
+  auto header = [&os](const std::string &name, const std::string &help,
+                      const char *type) {
+    os << "# HELP " << name << " " << help << "\n# TYPE " << name << " "
+       << type << "\n";
+  };
+  for (auto &c : s.counters) {
+    header(c.name, c.help, "counter");
+    os << c.name << " " << c.value << "\n";
+  }
+  for (auto &g : s.gauges) {
+    header(g.name, g.help, "gauge");
+    os << g.name << " " << g.value << "\n";
+  }
+  for (auto &h : s.histograms) {
+    header(h.name, h.help, "summary");
+    for (double q : {0.5, 0.9, 0.99, 0.999}) {
+      os << h.name << "{quantile=\"" << q << "\"} "
+         << h.histogram.percentile(q) * 1e-9 << "\n";
+    }
+    os << h.name << "_sum " << h.sum_ns * 1e-9 << "\n"
+       << h.name << "_count " << h.histogram.count() << "\n";
+  }
+  return os.str();
+}
+
+// Where and how often metrics_exporter publishes snapshots:
+//
+//   --metrics-json=<file> --metrics-prom=<file> --metrics-port=<port>
+//   --metrics-interval-ms=<ms>
+struct metrics_options {
+  std::string json_path;
+  std::string prom_path;
+  int port = -1;
+  std::chrono::milliseconds interval{1000};
+
+  static metrics_options from_options(const bench_options &opts) {
+    metrics_options m;
+    m.json_path = opts.get("metrics-json", "");
+    m.prom_path = opts.get("metrics-prom", "");
+    m.port = opts.get("metrics-port", m.port);
+    m.interval = std::chrono::milliseconds(
+        opts.get("metrics-interval-ms", int(m.interval.count())));
+    return m;
+  }
+
+  bool enabled() const {
+    return !json_path.empty() || !prom_path.empty() || port >= 0;
+  }
+};
+
+// Takes a snapshot of the registry every interval on its own thread and
+// replaces the JSON and Prometheus files with it (written aside, then
+// renamed, so readers never see half a file). With a port, it also serves
+// the latest Prometheus text to any connection on 127.0.0.1:port (port 0
+// picks one), which is enough for a Prometheus scrape or curl. Does nothing
+// when no output is configured. A last snapshot is written on destruction.
+class metrics_exporter {
+public:
+  explicit metrics_exporter(metrics_options options)
+      : options_(std::move(options)), timer_(ioc_), acceptor_(ioc_) {
+    if (!options_.enabled()) {
+      return;
+    }
+    if (options_.port >= 0) {
+      boost::asio::ip::tcp::endpoint ep(
+          boost::asio::ip::make_address("127.0.0.1"),
+          static_cast<std::uint16_t>(options_.port));
+      acceptor_.open(ep.protocol());
+      acceptor_.set_option(boost::asio::socket_base::reuse_address(true));
+      acceptor_.bind(ep);
+      acceptor_.listen();
+      accept();
+    }
+    export_snapshot();
+    schedule();
+    thread_ = std::thread([this] { ioc_.run(); });
+  }
+
+  ~metrics_exporter() {
+    if (!thread_.joinable()) {
+      return;
+    }
+    boost::asio::post(ioc_, [this] {
+      timer_.cancel();
+      boost::system::error_code ec;
+      acceptor_.close(ec);
+    });
+    thread_.join();
+    export_snapshot();
+  }
+
+  metrics_exporter(const metrics_exporter &) = delete;
+  metrics_exporter &operator=(const metrics_exporter &) = delete;
+
+  // The scrape port, once bound.
+  std::uint16_t port() const {
+    return acceptor_.is_open() ? acceptor_.local_endpoint().port() : 0;
+  }
+
+private:
+  void schedule() {
+    timer_.expires_after(options_.interval);
+    timer_.async_wait([this](boost::system::error_code const &error) {
+      if (!error) {
+        export_snapshot();
+        schedule();
+      }
+    });
+  }
+
+  void export_snapshot() {
+    auto s = metrics_registry::instance().snapshot();
+    auto prom = to_prometheus(s);
+    if (!options_.json_path.empty()) {
+      replace_file(options_.json_path, to_json(s));
+    }
+    if (!options_.prom_path.empty()) {
+      replace_file(options_.prom_path, prom);
+    }
+    std::lock_guard<std::mutex> lock(latest_mutex_);
+    latest_ = std::make_shared<const std::string>(std::move(prom));
+  }
+
+  static void replace_file(const std::string &path, const std::string &text) {
+    auto tmp = path + ".tmp";
+    std::ofstream(tmp, std::ios::trunc) << text;
+    std::rename(tmp.c_str(), path.c_str());
+  }
+
+  void accept() {
+    acceptor_.async_accept([this](boost::system::error_code ec,
+                                  boost::asio::ip::tcp::socket socket) {
+      if (ec == boost::asio::error::operation_aborted) {
+        return;
+      }
+      if (!ec) {
+        serve(std::make_shared<boost::asio::ip::tcp::socket>(
+            std::move(socket)));
+      }
+      accept();
+    });
+  }
+
+  // Reads (and ignores) the request, answers with the latest snapshot and
+  // closes.
+  void serve(std::shared_ptr<boost::asio::ip::tcp::socket> socket) {
+    auto request = std::make_shared<std::array<char, 1024>>();
+    socket->async_read_some(
+        boost::asio::buffer(*request),
+        [this, socket, request](boost::system::error_code ec, std::size_t) {
+          if (ec) {
+            return;
+          }
+          std::shared_ptr<const std::string> body;
+          {
+            std::lock_guard<std::mutex> lock(latest_mutex_);
+            body = latest_;
+          }
+          auto response = std::make_shared<std::string>(
+              "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+              "Content-Length: " +
+              std::to_string(body->size()) + "\r\n\r\n" + *body);
+          boost::asio::async_write(
+              *socket, boost::asio::buffer(*response),
+              [socket, response](boost::system::error_code, std::size_t) {
+                boost::system::error_code ignored;
+                socket->shutdown(boost::asio::ip::tcp::socket::shutdown_both,
+                                 ignored);
+              });
+        });
+  }
+
+  metrics_options options_;
+  boost::asio::io_context ioc_;
+  boost::asio::steady_timer timer_;
+  boost::asio::ip::tcp::acceptor acceptor_;
+  std::mutex latest_mutex_;
+  std::shared_ptr<const std::string> latest_;
+  std::thread thread_;
+};
@@ -0,0 +1,210 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+
+// What push() does when the queue is full.
+enum class full_policy {
+  block,       // sleep until the consumer makes room
+  drop_oldest, // evict the oldest queued element and retry
+  drop_newest, // discard the element being pushed
+};
+
+// Bounded lock-free multi-producer/single-consumer queue.
+//
+// Based on Dmitry Vyukov's bounded queue: every cell carries a sequence
+// number telling producers and the consumer whose turn it is, so neither side
+// ever takes a lock and the only shared writes are one CAS on the tail per
+// push and one store per cell. Head, tail and cells sit on separate cache
+// lines. Elements are moved in and out; the capacity is rounded up to a power
+// of two.
+//
+// The cell protocol is safe for several dequeuers, which is what lets a
+// producer evict the oldest element under full_policy::drop_oldest; regular
+// consumption is still meant for a single thread.
+//
+// Under full_policy::block a producer that finds the queue full sleeps on a
+// condition variable; the consumer only takes its mutex to wake it when a
+// producer is actually waiting. T need only be move constructible.
+template <typename T> class mpsc_queue {
+public:
+  static constexpr std::size_t cache_line = 64;
+
+  explicit mpsc_queue(std::size_t capacity,
+                      full_policy policy = full_policy::block)
+      : mask_(round_up(capacity) - 1), policy_(policy),
+        cells_(new cell[mask_ + 1]) {
+    for (std::size_t i = 0; i <= mask_; ++i) {
+      cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  ~mpsc_queue() {
+    while (pop_with([](T &&) {})) {
+    }
+  }
+
+  mpsc_queue(const mpsc_queue &) = delete;
+  mpsc_queue &operator=(const mpsc_queue &) = delete;
+
+  // Returns false if the element was dropped (full_policy::drop_newest).
+  bool push(T &&v) {
+    while (!try_push(v)) {
+      switch (policy_) {
+      case full_policy::block:
+        wait_for_room();
+        break;
+      case full_policy::drop_oldest:
+        if (pop_with([](T &&) {})) {
+          dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+        break;
+      case full_policy::drop_newest:
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+    }
+    return true;
+  }
+  bool push(const T &) = delete;
+
+  // Moves up to max elements to out (an output iterator); returns the count.
+  template <typename OutputIt>
+  std::size_t pop_bulk(OutputIt out, std::size_t max) {
+    std::size_t n = 0;
+    while (n < max && pop_with([&](T &&v) { *out++ = std::move(v); })) {
+      ++n;
+    }
+    if (n) {
+      wake_producers();
+    }
+    return n;
+  }
+
+  bool try_pop(T &v) {
+    if (!pop_with([&](T &&e) { v = std::move(e); })) {
+      return false;
+    }
+    wake_producers();
+    return true;
+  }
+
+  std::size_t capacity() const { return mask_ + 1; }
+  std::uint64_t dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+  std::size_t size_approx() const {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    auto head = head_.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+  }
+
+private:
+  struct alignas(cache_line) cell {
+    std::atomic<std::size_t> seq;
+    alignas(T) unsigned char storage[sizeof(T)];
+
+    T *value() { return std::launder(reinterpret_cast<T *>(storage)); }
+  };
+
+  static std::size_t round_up(std::size_t n) {
+    std::size_t p = 2;
+    while (p < n) {
+      p <<= 1;
+    }
+    return p;
+  }
+
+  // Hands the oldest element, as an rvalue, to f and frees its cell.
+  template <typename F> bool pop_with(F &&f) {
+    auto pos = head_.load(std::memory_order_relaxed);
+    for (;;) {
+      auto &c = cells_[pos & mask_];
+      auto seq = c.seq.load(std::memory_order_acquire);
+      auto diff = static_cast<std::intptr_t>(seq) -
+                  static_cast<std::intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          f(std::move(*c.value()));
+          c.value()->~T();
+          c.seq.store(pos + mask_ + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // The waiter count and the fences on both sides order "I am waiting"
+  // against "I made room" (a cell's seq store), so either the producer sees
+  // the room or the consumer sees the waiter; the mutex closes the gap
+  // between the producer's check and its wait.
+  void wait_for_room() {
+    waiting_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    {
+      std::unique_lock<std::mutex> lock(wait_mutex_);
+      room_.wait(lock, [this] { return size_approx() < capacity(); });
+    }
+    waiting_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  void wake_producers() {
+    if (policy_ != full_policy::block) {
+      return;
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting_.load(std::memory_order_relaxed) != 0) {
+      std::lock_guard<std::mutex> lock(wait_mutex_);
+      room_.notify_all();
+    }
+  }
+
+  bool try_push(T &v) {
+    auto pos = tail_.load(std::memory_order_relaxed);
+    for (;;) {
+      auto &c = cells_[pos & mask_];
+      auto seq = c.seq.load(std::memory_order_acquire);
+      auto diff =
+          static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          new (c.storage) T(std::move(v));
+          c.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  const std::size_t mask_;
+  const full_policy policy_;
+  std::unique_ptr<cell[]> cells_;
+  alignas(cache_line) std::atomic<std::size_t> tail_{0};
+  alignas(cache_line) std::atomic<std::size_t> head_{0};
+  alignas(cache_line) std::atomic<std::uint64_t> dropped_{0};
+  alignas(cache_line) std::atomic<unsigned> waiting_{0};
+  std::mutex wait_mutex_;
+  std::condition_variable room_;
+};
@@ -0,0 +1,299 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "alloc_counter.hpp"
+#include "bench_options.hpp"
+#include "client_adapter.hpp"
+#include "cpu_usage.hpp"
+#include "latency_histogram.hpp"
+#include "loopback_broker.hpp"
+#include "open_loop_publisher.hpp"
+#include "probe_payload.hpp"
+#include "spdlog/sinks/stdout_color_sinks.h"
+#include "spdlog/spdlog.h"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs one workload over several MQTT client libraries and writes a JSON
+// report, so their numbers can be compared directly.
+//
+//   mqtt_compare [--clients=mqtt_cpp_async,paho_c_async,...|all]
+//                [--rate=<msgs/s>] [--poisson] [--qos=0|1|2]
+//                [--payload-size=<bytes>] [--warmup=<s>] [--duration=<s>]
+//                [--topic=<topic>] [--embedded-broker]
+//                [--unix-socket=<path>] [--report=<file>]
+//
+// Each client publishes open-loop at the given rate from one harness thread
+// and receives on its own subscribing connection. Only probes published after
+// the warm-up count. Allocations and CPU are taken over the whole process
+// for the measured interval, which is safe because clients run one at a
+// time. The report goes to --report, or to stdout; progress is logged to
+// stderr.
+//
+// mqtt_cpp_uds is mqtt_cpp_async over a Unix domain socket instead of TCP
+// loopback, so the two results compare the transports. It connects to
+// --unix-socket, or to the socket the embedded broker listens on next to its
+// TCP port.
+
+constexpr auto _HOST = "localhost";
+constexpr auto _PORT = 1883;
+constexpr std::uint32_t _WARMUP_ID = 0;
+constexpr std::uint32_t _MEASURED_ID = 1;
+
+struct result {
+  std::string client;
+  std::string error;
+  std::uint64_t sent = 0;
+  std::uint64_t publish_errors = 0;
+  sequence_tracker::stats sequence;
+  latency_histogram latency;
+  latency_histogram lag;
+  double seconds = 0;
+  double cpu_seconds = 0;
+  alloc_stats allocs;
+};
+
+// Receiving side of a run: latency and sequence of the measured probes.
+struct receiver {
+  std::mutex mutex;
+  latency_histogram latency;
+  sequence_tracker sequence;
+  std::atomic<std::uint64_t> measured{0};
+
+  void on_receive(const char *data, std::size_t size) {
+    auto now = get_ns();
+    probe_header h;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!decode_probe(data, size, h)) {
+      sequence.on_malformed();
+      return;
+    }
+    if (h.publisher_id != _MEASURED_ID) {
+      return;
+    }
+    sequence.on_receive(h);
+    latency.record(now - h.send_ns);
+    measured.fetch_add(1, std::memory_order_relaxed);
+  }
+};
+
+// Publishes on the schedule until end_ns; returns the number of refusals.
+std::uint64_t publish_until(client_adapter &client, send_schedule &schedule,
+                            probe_encoder &probe, latency_histogram *lag,
+                            std::int64_t end_ns) {
+  std::uint64_t errors = 0;
+  for (auto t = schedule.next_ns(); t < end_ns; t = schedule.next_ns()) {
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+        std::chrono::nanoseconds(t)));
+    if (lag) {
+      lag->record(get_ns() - t);
+    }
+    if (!client.publish(probe.next(t))) {
+      ++errors;
+    }
+    schedule.advance();
+  }
+  return errors;
+}
+
+result run_client(const std::string &name, const workload &w) {
+  result r;
+  r.client = name;
+  auto client = make_client_adapter(name);
+  if (!client) {
+    r.error = "unknown client";
+    return r;
+  }
+  receiver rx;
+  try {
+    client->start(w, [&rx](const char *data, std::size_t size) {
+      rx.on_receive(data, size);
+    });
+  } catch (const std::exception &e) {
+    r.error = e.what();
+    return r;
+  }
+
+  send_schedule schedule(w.rate, w.poisson);
+  probe_encoder warmup(_WARMUP_ID, w.payload_size);
+  probe_encoder measured(_MEASURED_ID, w.payload_size);
+  schedule.start(get_ns());
+  publish_until(*client, schedule, warmup, nullptr,
+                get_ns() + static_cast<std::int64_t>(w.warmup * 1e9));
+
+  auto allocs_start = allocations();
+  cpu_meter cpu;
+  r.publish_errors =
+      publish_until(*client, schedule, measured, &r.lag,
+                    get_ns() + static_cast<std::int64_t>(w.duration * 1e9));
+  r.sent = measured.sent();
+  // Drain: wait for the stragglers, but not for ever.
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (rx.measured.load() < r.sent - r.publish_errors &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  r.seconds = cpu.wall_seconds();
+  r.cpu_seconds = cpu.cpu_seconds();
+  r.allocs = allocations() - allocs_start;
+
+  client->stop();
+  std::lock_guard<std::mutex> lock(rx.mutex);
+  r.sequence = rx.sequence.get();
+  r.latency = rx.latency;
+  return r;
+}
+
+std::string json_string(const std::string &s) {
+  std::string out = "\"";
+  for (auto ch : s) {
+    if (ch == '"' || ch == '\\') {
+      out += '\\';
+      out += ch;
+    } else if (static_cast<unsigned char>(ch) < 0x20) {
+      out += ' ';
+    } else {
+      out += ch;
+    }
+  }
+  return out + "\"";
+}
+
+// Latency summary in microseconds.
+std::string json_latency(const latency_histogram &h) {
+  std::ostringstream os;
+  os << "{\"count\": " << h.count() << ", \"min\": " << h.min() * 1e-3
+     << ", \"mean\": " << h.mean() * 1e-3
+     << ", \"p50\": " << h.percentile(0.5) * 1e-3
+     << ", \"p90\": " << h.percentile(0.9) * 1e-3
+     << ", \"p99\": " << h.percentile(0.99) * 1e-3
+     << ", \"p999\": " << h.percentile(0.999) * 1e-3
+     << ", \"max\": " << h.max() * 1e-3 << "}";
+  return os.str();
+}
+
+std::string json_result(const result &r) {
+  std::ostringstream os;
+  os << "    {\"client\": " << json_string(r.client);
+  if (!r.error.empty()) {
+    os << ", \"error\": " << json_string(r.error) << "}";
+    return os.str();
+  }
+  // Losses at the tail of the run leave no gap behind them, so they are
+  // counted from what was sent rather than from the tracker.
+  auto delivered = r.sequence.received - r.sequence.duplicated;
+  auto msgs = static_cast<double>(r.sequence.received);
+  os << ",\n     \"sent\": " << r.sent
+     << ", \"publish_errors\": " << r.publish_errors
+     << ", \"received\": " << r.sequence.received
+     << ", \"lost\": " << (r.sent > delivered ? r.sent - delivered : 0)
+     << ", \"duplicated\": " << r.sequence.duplicated
+     << ", \"reordered\": " << r.sequence.reordered
+     << ", \"too_late\": " << r.sequence.too_late
+     << ", \"malformed\": " << r.sequence.malformed
+     << ",\n     \"seconds\": " << r.seconds
+     << ", \"throughput_msgs_per_s\": " << (r.seconds ? msgs / r.seconds : 0)
+     << ",\n     \"latency_us\": " << json_latency(r.latency)
+     << ",\n     \"publish_lag_us\": " << json_latency(r.lag)
+     << ",\n     \"allocations\": {\"count\": " << r.allocs.count
+     << ", \"bytes\": " << r.allocs.bytes
+     << ", \"per_msg\": " << (msgs ? r.allocs.count / msgs : 0)
+     << ", \"bytes_per_msg\": " << (msgs ? r.allocs.bytes / msgs : 0) << "}"
+     << ",\n     \"cpu\": {\"seconds\": " << r.cpu_seconds
+     << ", \"cores\": " << (r.seconds ? r.cpu_seconds / r.seconds : 0)
+     << ", \"us_per_msg\": " << (msgs ? r.cpu_seconds * 1e6 / msgs : 0)
+     << "}}";
+  return os.str();
+}
+
+int main(int argc, char **argv) {
+  spdlog::set_default_logger(spdlog::stderr_color_mt("compare"));
+  bench_options opts(argc, argv);
+  workload w;
+  w.host = _HOST;
+  w.port = _PORT;
+  w.topic = opts.get("topic", w.topic);
+  w.qos = opts.get("qos", 0);
+  w.payload_size = opts.get("payload-size", probe_header_size);
+  w.rate = opts.get("rate", w.rate);
+  w.poisson = opts.get("poisson", false);
+  w.warmup = opts.get("warmup", w.warmup);
+  w.duration = opts.get("duration", w.duration);
+  w.unix_path = opts.get("unix-socket", "");
+
+  std::vector<std::string> clients;
+  auto list = opts.get("clients", "all");
+  if (list == "all") {
+    clients = client_adapter_names();
+  } else {
+    std::istringstream is(list);
+    for (std::string name; std::getline(is, name, ',');) {
+      clients.push_back(name);
+    }
+  }
+
+  std::unique_ptr<loopback_broker> broker;
+  if (opts.get("embedded-broker", false)) {
+    if (w.unix_path.empty()) {
+      w.unix_path = (std::filesystem::temp_directory_path() /
+                     ("mqtt_compare." + std::to_string(get_ns()) + ".sock"))
+                        .string();
+    }
+    broker = std::make_unique<loopback_broker>(0, w.unix_path);
+    w.host = broker->host();
+    w.port = broker->port();
+  }
+
+  std::vector<std::string> results;
+  for (auto &name : clients) {
+    if (name == "mqtt_cpp_uds") {
+      spdlog::info("{}: {} msgs/s for {} s on unix://{}", name, w.rate,
+                   w.duration, w.unix_path);
+    } else {
+      spdlog::info("{}: {} msgs/s for {} s on {}:{}", name, w.rate,
+                   w.duration, w.host, w.port);
+    }
+    auto r = run_client(name, w);
+    if (r.error.empty()) {
+      spdlog::info("{}: latency {}", name, to_string(r.latency));
+    } else {
+      spdlog::error("{}: {}", name, r.error);
+    }
+    results.push_back(json_result(r));
+  }
+
+  std::ostringstream report;
+  report << "{\n  \"workload\": {\"broker\": "
+         << json_string(broker ? "embedded" : w.host + ":" +
+                                                  std::to_string(w.port))
+         << ", \"topic\": " << json_string(w.topic) << ", \"qos\": " << w.qos
+         << ", \"payload_size\": " << w.payload_size
+         << ", \"rate\": " << w.rate
+         << ", \"poisson\": " << (w.poisson ? "true" : "false")
+         << ", \"warmup_s\": " << w.warmup
+         << ", \"duration_s\": " << w.duration << "},\n  \"results\": [\n";
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    report << results[i] << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  report << "  ]\n}\n";
+
+  auto path = opts.get("report", "");
+  if (path.empty()) {
+    std::cout << report.str();
+  } else {
+    std::ofstream(path) << report.str();
+    spdlog::info("report written to {}", path);
+  }
+  return 0;
+}
@@ -0,0 +1,547 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "bench_options.hpp"
+#include "broker_address.hpp"
+#include "cpu_usage.hpp"
+#include "io_context_pool.hpp"
+#include "latency_histogram.hpp"
+#include "loopback_broker.hpp"
+#include "mqtt_client_cpp.hpp"
+#include "open_loop_publisher.hpp"
+#include "probe_payload.hpp"
+#include "proc_memory.hpp"
+#include "spdlog/sinks/stdout_color_sinks.h"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+// How many idle connections one process can hold, and what they cost.
+//
+//   mqtt_connection_scale [--connections=0,1000,10000] [--concurrency=100]
+//                         [--threads=4] [--keep-alive=10] [--idle=<s>]
+//                         [--rate=1000] [--duration=5]
+//                         [--payload-size=<bytes>] [--connect-timeout=60]
+//                         [--broker=tcp://host:port] [--report=<file>]
+//
+// Connections are opened on one io_context pool of --threads threads, up to
+// each --connections count in turn with at most --concurrency CONNECTs in
+// flight, and then left idle with the keep-alive the other clients use. At
+// every step it reports:
+//
+//   connect   connects/s over the ramp, and the CONNECT to CONNACK latency;
+//   memory    the resident size, and its growth per connection since before
+//             the first one was opened;
+//   idle      CPU time of the io threads, and of the whole process, over
+//             --idle seconds (three keep-alive periods by default) in which
+//             only pings go over the wire, per connection and per PINGRESP;
+//   latency   of a probe publisher and subscriber sharing the pool with the
+//             idle connections, publishing open-loop at --rate for
+//             --duration seconds.
+//
+// Without --broker the embedded broker is used, and its side of every
+// connection shows in the memory and process CPU figures, though not in the
+// io thread CPU. Each connection takes a socket (two with the broker
+// in-process), so the open file limit is raised as far as allowed, and a
+// local port: the ephemeral range, net.ipv4.ip_local_port_range, caps one
+// broker address at about 28k connections. Progress is logged to stderr; the
+// report goes to --report, or to stdout.
+
+constexpr auto _PROBE_TOPIC = "bench/connection_scale/probe";
+constexpr std::uint32_t _PUBLISHER_ID = 1;
+
+using client_t = decltype(MQTT_NS::make_async_client(
+    std::declval<boost::asio::io_context &>(), std::string(),
+    std::uint16_t()));
+using packet_id_t =
+    std::remove_reference_t<decltype(*std::declval<client_t>())>::packet_id_t;
+
+struct idle_connection {
+  explicit idle_connection(boost::asio::io_context &ioc) : ioc(ioc) {}
+
+  boost::asio::io_context &ioc;
+  client_t c;
+  // CONNECT under way; only touched on the io thread.
+  bool pending = false;
+  std::int64_t connect_ns = 0;
+};
+
+// The idle connections, and the ramp opening them: every connect that
+// finishes starts the next one, up to end, so the number in flight stays at
+// however many were started together.
+struct connection_set {
+  std::vector<std::unique_ptr<idle_connection>> conns;
+  std::atomic<std::size_t> end{0};
+  std::atomic<std::size_t> next{0};
+  std::atomic<std::size_t> finished{0};
+  std::atomic<std::size_t> connected{0};
+  std::atomic<std::size_t> failed{0};
+  std::atomic<std::size_t> lost{0};
+  std::atomic<std::uint64_t> pingresps{0};
+  std::mutex mutex;
+  latency_histogram connect_latency;
+};
+
+struct probe_pair {
+  probe_pair(boost::asio::io_context &pub_ioc,
+             boost::asio::io_context &sub_ioc, double rate,
+             std::size_t payload_size)
+      : pub_ioc(pub_ioc), sub_ioc(sub_ioc), timer(pub_ioc),
+        schedule(rate, false), probe(_PUBLISHER_ID, payload_size) {}
+
+  boost::asio::io_context &pub_ioc;
+  boost::asio::io_context &sub_ioc;
+  client_t pub;
+  client_t sub;
+  std::string topic = _PROBE_TOPIC;
+  // On the publisher's io thread.
+  boost::asio::steady_timer timer;
+  send_schedule schedule;
+  probe_encoder probe;
+  latency_histogram lag;
+  // On the subscriber's io thread.
+  latency_histogram latency;
+  std::uint64_t received = 0;
+  // Publisher connected, subscriber subscribed.
+  std::atomic_int ready{0};
+};
+
+struct probe_result {
+  std::uint64_t sent = 0;
+  std::uint64_t received = 0;
+  latency_histogram latency;
+  latency_histogram lag;
+};
+
+struct step_result {
+  std::size_t target = 0;
+  std::size_t connections = 0;
+  std::size_t opened = 0;
+  std::size_t failed = 0;
+  std::size_t lost = 0;
+  double ramp_s = 0;
+  latency_histogram connect_latency;
+  std::uint64_t rss_bytes = 0;
+  double rss_per_connection = 0;
+  double idle_s = 0;
+  double io_cpu_s = 0;
+  double process_cpu_s = 0;
+  std::uint64_t pingresps = 0;
+  probe_result probes;
+};
+
+// Runs f on the thread of ioc and waits for its result.
+template <typename F> auto run_on(boost::asio::io_context &ioc, F f) {
+  auto task =
+      std::make_shared<std::packaged_task<decltype(f())()>>(std::move(f));
+  auto result = task->get_future();
+  boost::asio::post(ioc, [task] { (*task)(); });
+  return result.get();
+}
+
+double io_cpu_seconds(io_context_pool &pool) {
+  double total = 0;
+  for (std::size_t k = 0; k < pool.size(); ++k) {
+    total += run_on(pool.at(k), thread_cpu_seconds);
+  }
+  return total;
+}
+
+// Lifts the open file limit to the hard limit, or to needed if that is
+// lower; warns if it still falls short.
+void raise_fd_limit(std::size_t needed) {
+  rlimit rl{};
+  getrlimit(RLIMIT_NOFILE, &rl);
+  if (rl.rlim_cur < needed) {
+    rl.rlim_cur = std::min<rlim_t>(rl.rlim_max, needed);
+    setrlimit(RLIMIT_NOFILE, &rl);
+    getrlimit(RLIMIT_NOFILE, &rl);
+  }
+  if (rl.rlim_cur < needed) {
+    spdlog::warn("open file limit {} is below the {} needed, see ulimit -n",
+                 rl.rlim_cur, needed);
+  }
+}
+
+void connect_next(connection_set &s);
+
+void finish(connection_set &s, idle_connection &conn, bool ok) {
+  if (!conn.pending) {
+    return;
+  }
+  conn.pending = false;
+  if (ok) {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.connect_latency.record(get_ns() - conn.connect_ns);
+    ++s.connected;
+  } else {
+    ++s.failed;
+  }
+  ++s.finished;
+  connect_next(s);
+}
+
+void connect_next(connection_set &s) {
+  auto i = s.next.load();
+  do {
+    if (i >= s.end.load(std::memory_order_acquire)) {
+      return;
+    }
+  } while (!s.next.compare_exchange_weak(i, i + 1));
+  auto &conn = *s.conns[i];
+  boost::asio::post(conn.ioc, [&s, &conn] {
+    conn.pending = true;
+    conn.connect_ns = get_ns();
+    conn.c->async_connect([&s, &conn](MQTT_NS::error_code ec) {
+      if (ec) {
+        finish(s, conn, false);
+      }
+    });
+  });
+}
+
+std::unique_ptr<idle_connection>
+make_connection(connection_set &s, boost::asio::io_context &ioc,
+                const broker_address &broker, std::size_t index,
+                int keep_alive) {
+  auto conn = std::make_unique<idle_connection>(ioc);
+  auto &cr = *conn;
+  cr.c = MQTT_NS::make_async_client(ioc, broker.host, broker.port);
+  cr.c->set_client_id("conn_scale_" + std::to_string(index));
+  cr.c->set_keep_alive_sec(keep_alive);
+  cr.c->set_clean_session(true);
+  cr.c->set_connack_handler(
+      [&s, &cr](bool, MQTT_NS::connect_return_code rc) {
+        finish(s, cr, rc == MQTT_NS::connect_return_code::accepted);
+        return true;
+      });
+  cr.c->set_pingresp_handler([&s] {
+    s.pingresps.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  });
+  auto drop = [&s, &cr] {
+    if (cr.pending) {
+      finish(s, cr, false);
+    } else {
+      ++s.lost;
+    }
+  };
+  cr.c->set_close_handler(drop);
+  cr.c->set_error_handler([drop](MQTT_NS::error_code) { drop(); });
+  return conn;
+}
+
+bool connect_probes(probe_pair &p, const broker_address &broker,
+                    int keep_alive) {
+  p.pub = MQTT_NS::make_async_client(p.pub_ioc, broker.host, broker.port);
+  p.pub->set_client_id("conn_scale_probe_pub");
+  p.pub->set_keep_alive_sec(keep_alive);
+  p.pub->set_clean_session(true);
+  p.pub->set_connack_handler([&p](bool, MQTT_NS::connect_return_code rc) {
+    if (rc == MQTT_NS::connect_return_code::accepted) {
+      ++p.ready;
+    }
+    return true;
+  });
+  p.pub->set_error_handler([](MQTT_NS::error_code ec) {
+    spdlog::error("probe publisher: {}", ec.message());
+  });
+
+  p.sub = MQTT_NS::make_async_client(p.sub_ioc, broker.host, broker.port);
+  p.sub->set_client_id("conn_scale_probe_sub");
+  p.sub->set_keep_alive_sec(keep_alive);
+  p.sub->set_clean_session(true);
+  p.sub->set_connack_handler([&p](bool, MQTT_NS::connect_return_code rc) {
+    if (rc == MQTT_NS::connect_return_code::accepted) {
+      p.sub->async_subscribe(p.topic, MQTT_NS::qos::at_most_once);
+    }
+    return true;
+  });
+  p.sub->set_suback_handler(
+      [&p](packet_id_t, std::vector<MQTT_NS::suback_return_code>) {
+        ++p.ready;
+        return true;
+      });
+  p.sub->set_publish_handler([&p](MQTT_NS::optional<packet_id_t>,
+                                  MQTT_NS::publish_options, MQTT_NS::buffer,
+                                  MQTT_NS::buffer contents) {
+    probe_header h;
+    if (decode_probe(contents, h) && h.publisher_id == _PUBLISHER_ID) {
+      p.latency.record(probe_age_ns(h));
+      ++p.received;
+    }
+    return true;
+  });
+  p.sub->set_error_handler([](MQTT_NS::error_code ec) {
+    spdlog::error("probe subscriber: {}", ec.message());
+  });
+
+  boost::asio::post(p.pub_ioc, [&p] { p.pub->async_connect(); });
+  boost::asio::post(p.sub_ioc, [&p] { p.sub->async_connect(); });
+  auto deadline = std::chrono::steady_clock::now() + 10s;
+  while (p.ready < 2 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(10ms);
+  }
+  return p.ready == 2;
+}
+
+probe_result run_probes(probe_pair &p, double duration) {
+  probe_result r;
+  run_on(p.sub_ioc, [&p] {
+    p.latency = latency_histogram();
+    p.received = 0;
+  });
+  auto sent_before = run_on(p.pub_ioc, [&p] {
+    p.lag = latency_histogram();
+    p.schedule.start(get_ns());
+    publish_open_loop(p.timer, p.schedule, p.lag,
+                      [&p](std::int64_t intended_ns) {
+                        p.pub->async_publish(
+                            p.topic, std::string(p.probe.next(intended_ns)),
+                            MQTT_NS::qos::at_most_once);
+                      });
+    return p.probe.sent();
+  });
+  std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+  r.sent = run_on(p.pub_ioc, [&p] {
+    p.timer.cancel();
+    return p.probe.sent();
+  });
+  r.sent -= sent_before;
+  r.lag = run_on(p.pub_ioc, [&p] { return p.lag; });
+  // Let in-flight probes arrive.
+  std::this_thread::sleep_for(200ms);
+  run_on(p.sub_ioc, [&p, &r] {
+    r.latency = p.latency;
+    r.received = p.received;
+  });
+  return r;
+}
+
+step_result run_step(std::size_t target, connection_set &s,
+                     io_context_pool &pool, probe_pair &probes,
+                     const broker_address &broker, const bench_options &opts,
+                     std::uint64_t rss_baseline) {
+  auto keep_alive = opts.get("keep-alive", 10);
+  auto concurrency = std::max(opts.get("concurrency", std::size_t(100)),
+                              std::size_t(1));
+  step_result r;
+  r.target = target;
+  auto connected_before = s.connected.load();
+  auto failed_before = s.failed.load();
+  while (s.conns.size() < target) {
+    s.conns.push_back(
+        make_connection(s, pool.next(), broker, s.conns.size(), keep_alive));
+  }
+
+  auto start = get_ns();
+  s.end.store(target, std::memory_order_release);
+  for (std::size_t k = 0; k < concurrency; ++k) {
+    connect_next(s);
+  }
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::duration<double>(
+                      opts.get("connect-timeout", 60.0));
+  while (s.finished < target && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(1ms);
+  }
+  r.ramp_s = (get_ns() - start) * 1e-9;
+  if (s.finished < target) {
+    spdlog::warn("{} connections: {} connects still pending", target,
+                 target - s.finished);
+  }
+  r.opened = s.connected - connected_before;
+  r.failed = s.failed - failed_before;
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    r.connect_latency = s.connect_latency;
+    s.connect_latency = latency_histogram();
+  }
+
+  // Idle: nothing but keep-alive.
+  auto lost_before = s.lost.load();
+  auto pings_before = s.pingresps.load();
+  auto io_before = io_cpu_seconds(pool);
+  cpu_meter cpu;
+  std::this_thread::sleep_for(
+      std::chrono::duration<double>(opts.get("idle", 3.0 * keep_alive)));
+  r.io_cpu_s = io_cpu_seconds(pool) - io_before;
+  r.process_cpu_s = cpu.cpu_seconds();
+  r.idle_s = cpu.wall_seconds();
+  r.pingresps = s.pingresps - pings_before;
+  r.lost = s.lost - lost_before;
+  r.connections = s.connected - s.lost;
+
+  r.rss_bytes = resident_bytes();
+  if (r.connections) {
+    r.rss_per_connection =
+        (double(r.rss_bytes) - double(rss_baseline)) / r.connections;
+  }
+  r.probes = run_probes(probes, opts.get("duration", 5.0));
+  return r;
+}
+
+std::string json_latency(const latency_histogram &h) {
+  std::ostringstream os;
+  os << "{\"count\": " << h.count() << ", \"min\": " << h.min() * 1e-3
+     << ", \"mean\": " << h.mean() * 1e-3
+     << ", \"p50\": " << h.percentile(0.5) * 1e-3
+     << ", \"p90\": " << h.percentile(0.9) * 1e-3
+     << ", \"p99\": " << h.percentile(0.99) * 1e-3
+     << ", \"p999\": " << h.percentile(0.999) * 1e-3
+     << ", \"max\": " << h.max() * 1e-3 << "}";
+  return os.str();
+}
+
+double per_second(double n, double seconds) {
+  return seconds > 0 ? n / seconds : 0;
+}
+
+std::string json_result(const step_result &r) {
+  auto n = static_cast<double>(r.connections);
+  std::ostringstream os;
+  os << "    {\"target\": " << r.target
+     << ", \"connections\": " << r.connections << ", \"failed\": " << r.failed
+     << ", \"lost\": " << r.lost
+     << ",\n     \"connect\": {\"opened\": " << r.opened
+     << ", \"seconds\": " << r.ramp_s
+     << ", \"per_s\": " << per_second(r.opened, r.ramp_s)
+     << ", \"latency_us\": " << json_latency(r.connect_latency) << "}"
+     << ",\n     \"memory\": {\"rss_bytes\": " << r.rss_bytes
+     << ", \"rss_per_connection\": " << r.rss_per_connection << "}"
+     << ",\n     \"idle\": {\"seconds\": " << r.idle_s
+     << ", \"pingresps\": " << r.pingresps
+     << ", \"io_cores\": " << per_second(r.io_cpu_s, r.idle_s)
+     << ", \"process_cores\": " << per_second(r.process_cpu_s, r.idle_s)
+     << ", \"io_us_per_connection_s\": "
+     << (n ? per_second(r.io_cpu_s * 1e6 / n, r.idle_s) : 0)
+     << ", \"io_us_per_ping\": "
+     << (r.pingresps ? r.io_cpu_s * 1e6 / r.pingresps : 0) << "}"
+     << ",\n     \"probe\": {\"sent\": " << r.probes.sent
+     << ", \"received\": " << r.probes.received
+     << ",\n       \"latency_us\": " << json_latency(r.probes.latency)
+     << ",\n       \"publish_lag_us\": " << json_latency(r.probes.lag)
+     << "}}";
+  return os.str();
+}
+
+int main(int argc, char **argv) {
+  spdlog::set_default_logger(spdlog::stderr_color_mt("scale"));
+  bench_options opts(argc, argv);
+  std::vector<std::size_t> counts;
+  std::istringstream is(opts.get("connections", "0,1000,10000"));
+  for (std::string n; std::getline(is, n, ',');) {
+    counts.push_back(std::stoul(n));
+  }
+  std::sort(counts.begin(), counts.end());
+  auto threads = opts.get("threads", std::size_t(4));
+  auto keep_alive = opts.get("keep-alive", 10);
+
+  broker_address broker;
+  std::unique_ptr<loopback_broker> embedded;
+  if (opts.has("broker")) {
+    auto a = broker_address::parse(opts.get("broker", ""));
+    if (!a || a->is_unix()) {
+      spdlog::error("--broker: expected tcp://host:port");
+      return 1;
+    }
+    broker = *a;
+  } else {
+    embedded = std::make_unique<loopback_broker>();
+    broker.host = embedded->host();
+    broker.port = embedded->port();
+  }
+  auto most = counts.empty() ? 0 : counts.back();
+  raise_fd_limit((embedded ? 2 : 1) * most + 256);
+  spdlog::info("up to {} connections to {}, {} io threads, keep-alive {} s",
+               most, broker.describe(), threads, keep_alive);
+
+  io_context_pool pool(threads);
+  pool.run();
+  connection_set s;
+  // connect_next() reads conns from the io threads while later steps add
+  // to it, so it must never reallocate.
+  s.conns.reserve(most);
+  probe_pair probes(pool.next(), pool.next(), opts.get("rate", 1000.0),
+                    opts.get("payload-size", probe_header_size));
+  if (!connect_probes(probes, broker, keep_alive)) {
+    spdlog::error("probe clients could not connect to {}", broker.describe());
+    pool.stop();
+    return 1;
+  }
+  auto rss_baseline = resident_bytes();
+
+  std::vector<std::string> results;
+  for (auto target : counts) {
+    auto r = run_step(target, s, pool, probes, broker, opts, rss_baseline);
+    spdlog::info("{:>6} connections: {:.0f} connects/s, {} failed, connect {}",
+                 r.connections, per_second(r.opened, r.ramp_s), r.failed,
+                 to_string(r.connect_latency));
+    spdlog::info("{:>6} connections: {:.1f} MiB resident, {:.0f} bytes each",
+                 r.connections, r.rss_bytes / 1048576.0,
+                 r.rss_per_connection);
+    spdlog::info("{:>6} connections: idle {:.3f} io cores, {:.3f} process "
+                 "cores, {} pings, {} lost",
+                 r.connections, per_second(r.io_cpu_s, r.idle_s),
+                 per_second(r.process_cpu_s, r.idle_s), r.pingresps, r.lost);
+    spdlog::info("{:>6} connections: probe sent {} received {}, latency {}",
+                 r.connections, r.probes.sent, r.probes.received,
+                 to_string(r.probes.latency));
+    results.push_back(json_result(r));
+  }
+
+  for (auto &conn : s.conns) {
+    boost::asio::post(conn->ioc, [&conn] {
+      if (conn->c->connected()) {
+        conn->c->async_disconnect();
+      }
+    });
+  }
+  boost::asio::post(probes.pub_ioc, [&probes] {
+    probes.pub->async_disconnect();
+  });
+  boost::asio::post(probes.sub_ioc, [&probes] {
+    probes.sub->async_disconnect();
+  });
+  std::this_thread::sleep_for(500ms);
+  pool.stop();
+
+  std::ostringstream report;
+  report << "{\n  \"workload\": {\"broker\": \"" << broker.describe()
+         << "\", \"embedded_broker\": " << (embedded ? "true" : "false")
+         << ", \"threads\": " << threads
+         << ", \"concurrency\": " << opts.get("concurrency", std::size_t(100))
+         << ", \"keep_alive_s\": " << keep_alive
+         << ",\n    \"rate\": " << opts.get("rate", 1000.0)
+         << ", \"duration_s\": " << opts.get("duration", 5.0)
+         << "},\n  \"results\": [\n";
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    report << results[i] << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  report << "  ]\n}\n";
+
+  auto path = opts.get("report", "");
+  if (path.empty()) {
+    std::cout << report.str();
+  } else {
+    std::ofstream(path) << report.str();
+    spdlog::info("report written to {}", path);
+  }
+  return 0;
+}
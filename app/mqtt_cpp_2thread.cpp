@@ -4,11 +4,35 @@
 // (See accompanying file LICENSE_1_0.txt or copy at
 // http://www.boost.org/LICENSE_1_0.txt)
 
+#include "alloc_counter.hpp"
+#include "bench_options.hpp"
+#include "hot_log.hpp"
+#include "io_context_runner.hpp"
+#include "latency_histogram.hpp"
+#include "loopback_broker.hpp"
+#include "metrics.hpp"
+#include "mpsc_queue.hpp"
 #include "mqtt_client_cpp.hpp"
+#include "open_loop_publisher.hpp"
+#include "payload_pool.hpp"
+#include "probe_payload.hpp"
+#include "proc_io.hpp"
+#include "protocol_options.hpp"
+#include "publish_batcher.hpp"
+#include "received_msg.hpp"
+#include "reconnect_engine.hpp"
+#include "shared_payload.hpp"
 #include "spdlog/spdlog.h"
+#include "thread_placement.hpp"
+#include "uds_transport.hpp"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <iostream>
+#include <iterator>
 #include <mutex>
+#include <optional>
 #include <signal.h>
 #include <thread>
 #include <vector>
@@ -19,36 +43,126 @@ constexpr auto _TOPIC = "hello_echo";
 constexpr auto _QOS = MQTT_NS::qos::at_most_once;
 constexpr auto _HOST = "localhost";
 constexpr auto _PORT = 1883;
+constexpr auto _REPORT_EVERY = 1000;
+constexpr auto _PUBLISHER_ID = 1;
+constexpr std::size_t _DRAIN_BATCH = 1024;
 
-auto get_ms() {
-  return std::chrono::steady_clock::now().time_since_epoch().count() * 1e-6;
-}
-
+// The topic is an interned id and the payload a shared, immutable buffer from
+// the producer's payload_pool: from the producer to the socket write a
+// message is moved, never copied, and nothing is allocated for it once the
+// pools and batches have grown to the traffic.
 struct Msg {
-  std::string topic;
-  std::string payload;
+  topic_table::id_t topic;
+  MQTT_NS::buffer payload;
   MQTT_NS::qos qos;
 };
 
+topic_table topics;
+const topic_table::id_t topic_id = topics.intern(_TOPIC);
+
 using msgs_t = std::vector<Msg>;
 
+// Messages handed from the producer threads to the pub thread, either through
+// a mutex-protected vector or, with --queue=ring, a lock-free ring. The pub
+// thread drains into pub_msgs and swaps its emptied capacity back, so the
+// vectors are recycled rather than reallocated.
 msgs_t all_msgs;
+msgs_t pub_msgs;
 std::mutex mutex;
+std::unique_ptr<mpsc_queue<Msg>> msg_queue;
 
 void push_msg(Msg &&msg) {
+  if (msg_queue) {
+    msg_queue->push(std::move(msg));
+    return;
+  }
   std::lock_guard lock(mutex);
-  all_msgs.push_back(msg);
+  all_msgs.push_back(std::move(msg));
 }
 
-msgs_t take_all_msgs() {
-  msgs_t res;
-  {
-    std::lock_guard lock(mutex);
-    res.swap(all_msgs);
+// Replaces the contents of out, keeping its capacity.
+void take_all_msgs(msgs_t &out) {
+  out.clear();
+  if (msg_queue) {
+    msg_queue->pop_bulk(std::back_inserter(out), _DRAIN_BATCH);
+    return;
   }
-  return res;
+  std::lock_guard lock(mutex);
+  out.swap(all_msgs);
 }
 
+// Producer threads feeding push_msg(); with none the pub thread publishes
+// directly.
+int producer_count = 0;
+double ingest_rate = 1000;
+std::mutex push_cost_mutex;
+latency_histogram push_cost;
+// Producer allocations after the first _WARMUP_MSGS messages of each.
+constexpr std::uint64_t _WARMUP_MSGS = 1000;
+alloc_stats producer_allocs;
+std::uint64_t producer_msgs = 0;
+std::size_t producer_pool_blocks = 0;
+
+// Set by main before the client threads start.
+broker_address broker_addr;
+thread_placement placement;
+
+// Only touched by the thread consuming received messages (the sub thread, or
+// the consumer thread with --consumer); read by main after joining it.
+latency_histogram sub_latency;
+sequence_tracker sub_sequence;
+// With --consumer the sub thread hands received messages over as slices of
+// the client's receive buffers instead of decoding them itself.
+std::unique_ptr<mpsc_queue<received_msg>> receive_queue;
+// Cleared by main once the sub thread has exited, so the consumer drains
+// everything it pushed and a blocking push never waits on a consumer that
+// is already gone.
+std::atomic_bool consumer_running = true;
+// The consumer parks on consumer_wake when the queue runs dry; the sub thread
+// only takes consumer_mutex to wake it while consumer_parked is set.
+std::mutex consumer_mutex;
+std::condition_variable consumer_wake;
+std::atomic_bool consumer_parked = false;
+
+// After a push to receive_queue, and after clearing consumer_running. The
+// fences pair with the ones in park_consumer(): either the consumer sees the
+// new element (or flag), or this sees it parked.
+void wake_consumer() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (consumer_parked.load(std::memory_order_relaxed)) {
+    std::lock_guard lock(consumer_mutex);
+    consumer_wake.notify_one();
+  }
+}
+
+void park_consumer() {
+  std::unique_lock lock(consumer_mutex);
+  consumer_parked.store(true, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  consumer_wake.wait(lock, [] {
+    return receive_queue->size_approx() > 0 || !consumer_running;
+  });
+  consumer_parked.store(false, std::memory_order_relaxed);
+}
+
+latency_histogram handoff_latency;
+alloc_stats sub_allocs;
+alloc_stats consumer_allocs;
+// Only touched by the pub thread once main has configured it.
+std::unique_ptr<payload_pool> pub_pool;
+shared_probe_encoder pub_probe(_PUBLISHER_ID);
+// Open-loop mode when > 0 msgs/s, otherwise re-arm a 1 ms timer per publish.
+double pub_rate = 0;
+bool pub_poisson = false;
+latency_histogram pub_lag;
+// Coalesce drained messages into gathered writes when batch.max_msgs > 1.
+batch_limits batch{1};
+std::uint64_t pub_sent = 0;
+std::uint64_t pub_batches = 0;
+proc_io pub_io;
+proc_io sub_io;
+double pub_seconds = 0;
+
 std::atomic_bool running = true;
 std::atomic_int signal_status;
 void signal_handler(int signal) {
@@ -56,57 +170,114 @@ void signal_handler(int signal) {
   signal_status = signal;
 }
 
-void run_ioc(boost::asio::io_context *ioc) {
-#if 0
-  ioc->run();
-#else
-  while (running) {
-    ioc->run_one();
+// Set by main before the client threads start.
+run_mode ioc_mode = run_mode::blocking;
+std::chrono::microseconds ioc_spin{50};
+backoff_policy reconnect_backoff;
+protocol_options protocol;
+
+void run_ioc(boost::asio::io_context *ioc, const std::string &name) {
+  io_context_runner runner(*ioc, ioc_mode, ioc_spin, &running);
+  runner.run();
+  spdlog::info("{} thread: {} run, {:.3f} cpu s over {:.3f} s wall, {} "
+               "handlers",
+               name, to_string(runner.mode()), runner.cpu_seconds(),
+               runner.wall_seconds(), runner.handlers());
+}
+
+// Calls f with a client for broker_addr: mqtt_cpp's TCP client, or a Unix
+// domain socket one for unix:// addresses. Both take the same handlers.
+template <typename F> void with_client(boost::asio::io_context &ioc, F &&f) {
+  if (broker_addr.is_unix()) {
+    f(make_uds_client(ioc, broker_addr.unix_path, protocol.version()));
+  } else {
+    f(MQTT_NS::make_async_client(ioc, broker_addr.host, broker_addr.port,
+                                 protocol.version()));
   }
-#endif
 }
 
-template <typename C>
-void reconnect_client(boost::asio::steady_timer &timer, C &c) {
-  std::cout << "Start reconnect timer" << std::endl;
-  // Set an expiry time relative to now.
-  timer.expires_after(std::chrono::seconds(1));
-  timer.async_wait([&timer, &c](const boost::system::error_code &error) {
-    if (error != boost::asio::error::operation_aborted) {
-      std::cout << "Reconnect now !!" << std::endl;
-
-      // Connect
-      c->async_connect(
-          // [optional] checking underlying layer completion code
-          [&timer, &c](MQTT_NS::error_code ec) {
-            std::cout << "async_connect callback: " << ec.message()
-                      << std::endl;
-            if (ec && ec != boost::asio::error::operation_aborted) {
-              reconnect_client(timer, c);
-            }
-          });
+// Decodes the probe in a received payload and records its latency; cnt is
+// the caller's count of messages consumed so far.
+void consume(spdlog::logger &log, std::string_view payload,
+             std::uint64_t &cnt) {
+  auto &metrics = client_metrics();
+  metrics.msgs_received.add();
+  metrics.bytes_received.add(payload.size());
+  probe_header h;
+  if (!decode_probe(payload, h)) {
+    sub_sequence.on_malformed();
+    return;
+  }
+  sub_sequence.on_receive(h);
+  auto delay = probe_age_ns(h);
+  sub_latency.record(delay);
+  metrics.latency.record(delay);
+  hot_log(log, spdlog::level::info, "{}, time elapsed : {} ms", ++cnt,
+          delay * 1e-6);
+  if (cnt % _REPORT_EVERY == 0) {
+    log.info("latency {}", to_string(sub_latency));
+    log.info("sequence {}", to_string(sub_sequence.get()));
+  }
+}
+
+void consumer_thread_entry() {
+  placement.enter(placement.consumer);
+  static auto log = spdlog::default_logger()->clone("consumer");
+  std::vector<received_msg> msgs;
+  msgs.reserve(_DRAIN_BATCH);
+  std::uint64_t cnt = 0;
+  auto allocs_start = thread_allocations();
+  for (;;) {
+    // Read before popping: once the sub thread is gone, an empty pop means
+    // the queue is drained for good.
+    bool last = !consumer_running;
+    if (!receive_queue->pop_bulk(std::back_inserter(msgs), _DRAIN_BATCH)) {
+      if (last) {
+        break;
+      }
+      park_consumer();
+      continue;
     }
-  });
+    auto now = get_ns();
+    for (auto &m : msgs) {
+      handoff_latency.record(now - m.recv_ns);
+      consume(*log, m.payload_view(), cnt);
+    }
+    // Dropping the slices releases the receive buffers.
+    msgs.clear();
+  }
+  consumer_allocs = thread_allocations() - allocs_start;
 }
 
-void sub_thread_entry() {
+template <typename C> void sub_session(boost::asio::io_context &ioc, C &c) {
   static auto log = spdlog::default_logger()->clone("sub");
-  boost::asio::io_context ioc;
-  boost::asio::steady_timer reconnect_timer(ioc);
-  auto c = MQTT_NS::make_async_client(ioc, _HOST, _PORT);
+  reconnect_engine reconnect(ioc, reconnect_backoff, [&] {
+    log->info("Reconnect now !!");
+    protocol.async_connect(
+        c,
+        // [optional] checking underlying layer completion code
+        [&](MQTT_NS::error_code ec) {
+          log->info("async_connect callback: {}", ec.message());
+          if (ec && ec != boost::asio::error::operation_aborted) {
+            reconnect.retry();
+          }
+        });
+  });
   using packet_id_t =
       typename std::remove_reference_t<decltype(*c)>::packet_id_t;
 
   c->set_client_id(log->name());
   c->set_keep_alive_sec(10);
   c->set_clean_session(true);
+  protocol.apply(c);
 
-  // Setup handlers
-  c->set_connack_handler([&](bool sp,
-                             MQTT_NS::connect_return_code connack_return_code) {
+  // Setup handlers; v3.1.1 and v5 handlers share the bodies.
+  auto on_connack = [&](bool sp, bool accepted, const char *return_code) {
     log->info("Session Present: {}", sp);
-    log->info("Connack Return Code: {}",
-              MQTT_NS::connect_return_code_to_str(connack_return_code));
+    log->info("Connack Return Code: {}", return_code);
+    if (accepted) {
+      reconnect.on_connected();
+    }
     c->async_subscribe(c->acquire_unique_packet_id(), {{_TOPIC, _QOS}},
                        // [optional] checking async_subscribe completion code
                        [](MQTT_NS::error_code ec) {
@@ -114,6 +285,19 @@ void sub_thread_entry() {
                                    ec.message());
                        });
     return true;
+  };
+  c->set_connack_handler([&](bool sp,
+                             MQTT_NS::connect_return_code connack_return_code) {
+    return on_connack(
+        sp, connack_return_code == MQTT_NS::connect_return_code::accepted,
+        MQTT_NS::connect_return_code_to_str(connack_return_code));
+  });
+  c->set_v5_connack_handler([&](bool sp,
+                                MQTT_NS::v5::connect_reason_code reason_code,
+                                MQTT_NS::v5::properties) {
+    return on_connack(
+        sp, reason_code == MQTT_NS::v5::connect_reason_code::success,
+        MQTT_NS::v5::connect_reason_code_to_str(reason_code));
   });
   c->set_suback_handler([&](packet_id_t packet_id,
                             std::vector<MQTT_NS::suback_return_code> results) {
@@ -123,101 +307,388 @@ void sub_thread_entry() {
     }
     return true;
   });
+  c->set_v5_suback_handler(
+      [&](packet_id_t packet_id,
+          std::vector<MQTT_NS::v5::suback_reason_code> reasons,
+          MQTT_NS::v5::properties) {
+        log->info("suback received. packet_id: {}", packet_id);
+        for (auto const &e : reasons) {
+          log->info("[client] subscribe result: {}", int(e));
+        }
+        return true;
+      });
   c->set_close_handler([]() { log->info("closed."); });
 
   c->set_error_handler([&](MQTT_NS::error_code ec) {
     log->error("{}", ec.message());
-    reconnect_client(reconnect_timer, c);
+    reconnect.retry();
   });
 
-  c->set_publish_handler([&](MQTT_NS::optional<packet_id_t> packet_id,
-                             MQTT_NS::publish_options pubopts,
+  // Messages consumed on this thread, when there is no consumer thread.
+  std::uint64_t received = 0;
+  auto on_publish = [&](MQTT_NS::buffer topic_name,
+                        MQTT_NS::buffer contents) {
+    reconnect.on_message();
+    if (receive_queue) {
+      // Moves two references to the receive buffer; nothing is copied.
+      receive_queue->push(
+          {std::move(topic_name), std::move(contents), get_ns()});
+      wake_consumer();
+    } else {
+      consume(*log, contents, received);
+    }
+    return true;
+  };
+  c->set_publish_handler([&](MQTT_NS::optional<packet_id_t>,
+                             MQTT_NS::publish_options,
                              MQTT_NS::buffer topic_name,
                              MQTT_NS::buffer contents) {
-    static int cnt;
-    log->info("{}, time elapsed : {} ms", ++cnt,
-              get_ms() - std::stod(contents.to_string()));
-    return true;
+    return on_publish(std::move(topic_name), std::move(contents));
+  });
+  c->set_v5_publish_handler([&](MQTT_NS::optional<packet_id_t>,
+                                MQTT_NS::publish_options,
+                                MQTT_NS::buffer topic_name,
+                                MQTT_NS::buffer contents,
+                                MQTT_NS::v5::properties) {
+    return on_publish(std::move(topic_name), std::move(contents));
   });
 
   // Connect
-  c->async_connect(
+  protocol.async_connect(
+      c,
       // Initial connect should succeed, otherwise we shutdown
       [&](MQTT_NS::error_code ec) {
         log->info("async_connect callback: {}", ec.message());
         if (ec) {
-          reconnect_client(reconnect_timer, c);
+          reconnect.retry();
         }
       });
-  run_ioc(&ioc);
+  auto io_start = thread_io();
+  auto allocs_start = thread_allocations();
+  run_ioc(&ioc, log->name());
+  sub_allocs = thread_allocations() - allocs_start;
+  sub_io = thread_io() - io_start;
+  log->info("reconnect {}", to_string(reconnect));
 }
 
-template <typename C> void publish_msg(boost::asio::steady_timer &timer, C &c) {
-  // Publish a message every 5 seconds
+void sub_thread_entry() {
+  placement.enter(placement.sub);
+  boost::asio::io_context ioc;
+  with_client(ioc, [&](auto c) { sub_session(ioc, c); });
+}
+
+template <typename C, typename B>
+void publish_msg(boost::asio::steady_timer &timer, C &c, B *batcher) {
+  // Every millisecond: publish what the producers queued or, without
+  // producers, one probe.
   timer.expires_after(1ms);
-  timer.async_wait([&timer, &c](boost::system::error_code const &error) {
+  timer.async_wait([&timer, &c,
+                    batcher](boost::system::error_code const &error) {
     if (error != boost::asio::error::operation_aborted) {
-#if 0
-      while (1) {
-        auto msgs = take_all_msgs();
-        if (msgs.empty()) {
-          break;
-        }
-        for (const auto &[topic, payload, qos] : msgs) {
-          c->async_publish(topic, std::to_string(get_ms()), qos);
+      if (producer_count > 0) {
+        // Payloads were stamped when produced, so queueing delay is part of
+        // the measured latency.
+        auto &metrics = client_metrics();
+        while (1) {
+          take_all_msgs(pub_msgs);
+          metrics.queue_depth.set(pub_msgs.size());
+          if (pub_msgs.empty()) {
+            break;
+          }
+          for (auto &[topic, payload, qos] : pub_msgs) {
+            metrics.bytes_sent.add(payload.size());
+            if (batcher) {
+              batcher->add(topics.buffer(topic), std::move(payload), qos);
+            } else {
+              c->async_publish(topics.buffer(topic), std::move(payload), qos);
+            }
+          }
+          pub_sent += pub_msgs.size();
+          metrics.msgs_sent.add(pub_msgs.size());
         }
+      } else {
+        c->async_publish(topics.buffer(topic_id), pub_probe.next(), _QOS);
+        ++pub_sent;
+        client_metrics().msgs_sent.add();
+        client_metrics().bytes_sent.add(pub_probe.size());
       }
-#else
-      c->async_publish(_TOPIC, std::to_string(get_ms()), _QOS);
-#endif
-      publish_msg(timer, c);
+      publish_msg(timer, c, batcher);
     }
   });
 }
-void pub_thread_entry() {
+template <typename C> void pub_session(boost::asio::io_context &ioc, C &c) {
   static auto log = spdlog::default_logger()->clone("pub");
-  boost::asio::io_context ioc;
   boost::asio::steady_timer publish_timer(ioc);
-  boost::asio::steady_timer reconnect_timer(ioc);
 
-  auto c = MQTT_NS::make_async_client(ioc, _HOST, _PORT);
+  std::optional<send_schedule> schedule;
+  if (pub_rate > 0 && producer_count == 0) {
+    schedule.emplace(pub_rate, pub_poisson);
+  }
+
+  reconnect_engine reconnect(ioc, reconnect_backoff, [&] {
+    log->info("Reconnect now !!");
+    protocol.async_connect(
+        c,
+        // [optional] checking underlying layer completion code
+        [&](MQTT_NS::error_code ec) {
+          log->info("async_connect callback: {}", ec.message());
+          if (ec && ec != boost::asio::error::operation_aborted) {
+            reconnect.retry();
+          }
+        });
+  });
   using packet_id_t =
       typename std::remove_reference_t<decltype(*c)>::packet_id_t;
 
   c->set_client_id(log->name());
   c->set_keep_alive_sec(10);
   c->set_clean_session(true);
+  protocol.apply(c);
+
+  std::optional<publish_batcher<C>> batcher;
+  if (batch.max_msgs > 1) {
+    batcher.emplace(c, ioc, batch);
+  }
+  auto io_start = thread_io();
+  auto start = get_ns();
 
   // Setup handlers
+  auto on_connack = [&](bool sp, bool accepted, const char *return_code) {
+    log->info("Session Present: {}", sp);
+    log->info("Connack Return Code: {}", return_code);
+    if (accepted) {
+      reconnect.on_connected();
+    }
+    if (schedule) {
+      // The timeline restarts on every (re)connect.
+      schedule->start(get_ns());
+      publish_open_loop(publish_timer, *schedule, pub_lag,
+                        [&](std::int64_t intended_ns) {
+                          c->async_publish(topics.buffer(topic_id),
+                                           pub_probe.next(intended_ns), _QOS);
+                          ++pub_sent;
+                          client_metrics().msgs_sent.add();
+                          client_metrics().bytes_sent.add(pub_probe.size());
+                        });
+    } else {
+      publish_msg(publish_timer, c, batcher ? &*batcher : nullptr);
+    }
+    return true;
+  };
   c->set_connack_handler(
       [&](bool sp, MQTT_NS::connect_return_code connack_return_code) {
-        log->info("Session Present: {}", sp);
-        log->info("Connack Return Code: {}",
-                  MQTT_NS::connect_return_code_to_str(connack_return_code));
-        publish_msg(publish_timer, c);
-        return true;
+        return on_connack(
+            sp, connack_return_code == MQTT_NS::connect_return_code::accepted,
+            MQTT_NS::connect_return_code_to_str(connack_return_code));
       });
+  c->set_v5_connack_handler([&](bool sp,
+                                MQTT_NS::v5::connect_reason_code reason_code,
+                                MQTT_NS::v5::properties) {
+    return on_connack(sp,
+                      reason_code == MQTT_NS::v5::connect_reason_code::success,
+                      MQTT_NS::v5::connect_reason_code_to_str(reason_code));
+  });
   c->set_close_handler([]() { log->info("closed."); });
   c->set_error_handler([&](MQTT_NS::error_code ec) {
     log->error("{}", ec.message());
-    reconnect_client(reconnect_timer, c);
+    reconnect.retry();
   });
 
   // Connect
-  c->async_connect(
+  protocol.async_connect(
+      c,
       // Initial connect should succeed, otherwise we shutdown
       [&](MQTT_NS::error_code ec) {
         log->info("async_connect callback: {}", ec.message());
+        if (ec) {
+          reconnect.retry();
+        }
       });
-  run_ioc(&ioc);
+  run_ioc(&ioc, log->name());
+  log->info("reconnect {}", to_string(reconnect));
+  pub_io = thread_io() - io_start;
+  pub_seconds = (get_ns() - start) * 1e-9;
+  pub_batches = batcher ? batcher->batches() : 0;
+}
+
+void pub_thread_entry() {
+  placement.enter(placement.pub);
+  boost::asio::io_context ioc;
+  with_client(ioc, [&](auto c) { pub_session(ioc, c); });
+}
+
+void producer_thread_entry(std::uint32_t id, std::size_t payload_size) {
+  placement.enter(placement.producers);
+  payload_pool pool(std::max(payload_size, probe_header_size));
+  shared_probe_encoder probe(id, payload_size, &pool);
+  send_schedule schedule(ingest_rate, false);
+  latency_histogram cost;
+  alloc_stats warm;
+  schedule.start(get_ns());
+  while (running) {
+    auto intended = schedule.next_ns();
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+        std::chrono::nanoseconds(intended)));
+    if (probe.sent() == _WARMUP_MSGS) {
+      warm = thread_allocations();
+    }
+    auto start = get_ns();
+    push_msg({topic_id, probe.next(intended), _QOS});
+    cost.record(get_ns() - start);
+    schedule.advance();
+  }
+  auto steady = thread_allocations() - warm;
+  std::lock_guard lock(push_cost_mutex);
+  push_cost.merge(cost);
+  if (probe.sent() > _WARMUP_MSGS) {
+    producer_allocs += steady;
+    producer_msgs += probe.sent() - _WARMUP_MSGS;
+  }
+  producer_pool_blocks += pool.blocks();
 }
 
 int main(int argc, char **argv) {
+  bench_options opts(argc, argv);
+  auto payload_size = opts.get("payload-size", probe_header_size);
+  pub_pool = std::make_unique<payload_pool>(
+      std::max(payload_size, probe_header_size));
+  pub_probe = shared_probe_encoder(_PUBLISHER_ID, payload_size, pub_pool.get());
+  pub_rate = opts.get("rate", 0.0);
+  pub_poisson = opts.get("poisson", false);
+  producer_count = opts.get("producers", 0);
+  ingest_rate = opts.get("ingest-rate", ingest_rate);
+  batch.max_msgs = opts.get("batch", batch.max_msgs);
+  batch.max_bytes = opts.get("batch-bytes", batch.max_bytes);
+  batch.max_delay = std::chrono::microseconds(
+      opts.get("batch-delay-us", static_cast<int>(batch.max_delay.count())));
+  auto mode = opts.get("run-mode", "blocking");
+  if (auto m = parse_run_mode(mode)) {
+    ioc_mode = *m;
+  } else {
+    spdlog::error("unknown --run-mode={}", mode);
+    return 1;
+  }
+  ioc_spin = std::chrono::microseconds(opts.get("spin-us", 50));
+  auto queue = opts.get("queue", "mutex");
+  placement = thread_placement::from_options(opts);
+  spdlog::info("placement {}", placement.describe());
+  if (queue == "ring") {
+    auto full = opts.get("queue-full", "block");
+    // Allocated where the pub thread, its consumer, will run.
+    placement.run_as(placement.pub, [&] {
+      msg_queue = std::make_unique<mpsc_queue<Msg>>(
+          opts.get("queue-capacity", std::size_t(65536)),
+          full == "drop-oldest"   ? full_policy::drop_oldest
+          : full == "drop-newest" ? full_policy::drop_newest
+                                  : full_policy::block);
+    });
+  }
+  if (opts.get("consumer", false)) {
+    // Allocated where the consumer thread will run.
+    placement.run_as(placement.consumer, [&] {
+      receive_queue = std::make_unique<mpsc_queue<received_msg>>(
+          opts.get("receive-queue-capacity", std::size_t(65536)));
+    });
+  }
+  auto address = opts.get("broker", std::string("tcp://") + _HOST + ":" +
+                                        std::to_string(_PORT));
+  if (auto a = broker_address::parse(address)) {
+    broker_addr = *a;
+  } else {
+    spdlog::error("bad --broker={}", address);
+    return 1;
+  }
+  std::unique_ptr<loopback_broker> broker;
+  if (opts.get("embedded-broker", false)) {
+    // A unix:// --broker names the socket the embedded broker listens on.
+    broker = std::make_unique<loopback_broker>(0, broker_addr.unix_path);
+    if (!broker_addr.is_unix()) {
+      broker_addr.host = broker->host();
+      broker_addr.port = broker->port();
+    }
+    spdlog::info("embedded broker on {}", broker_addr.describe());
+  }
+  if (!broker_addr.is_unix()) {
+    broker_addr.host = resolve_once(broker_addr.host, broker_addr.port);
+  }
+  reconnect_backoff = backoff_policy::from_options(opts);
+  protocol = protocol_options::from_options(opts);
+  auto hot_logging = opts.get("hot-log", false);
+  if (hot_logging) {
+    hot_log_backend::instance().start();
+    if (placement.log) {
+      pin_thread(hot_log_backend::instance().thread().native_handle(),
+                 *placement.log);
+    }
+  }
+  metrics_exporter exporter(metrics_options::from_options(opts));
+  if (exporter.port()) {
+    spdlog::info("metrics on 127.0.0.1:{}", exporter.port());
+  }
   signal(SIGINT, signal_handler);
   std::thread sub_thread(sub_thread_entry);
+  std::thread consumer_thread;
+  if (receive_queue) {
+    consumer_thread = std::thread(consumer_thread_entry);
+  }
   std::thread pub_thread(pub_thread_entry);
+  std::vector<std::thread> producers;
+  for (int i = 0; i < producer_count; ++i) {
+    producers.emplace_back(producer_thread_entry, _PUBLISHER_ID + 1 + i,
+                           payload_size);
+  }
+  for (auto &t : producers) {
+    t.join();
+  }
   sub_thread.join();
+  if (consumer_thread.joinable()) {
+    consumer_running = false;
+    wake_consumer();
+    consumer_thread.join();
+  }
   pub_thread.join();
+  if (hot_logging) {
+    hot_log_backend::instance().stop();
+    spdlog::info("hot log dropped {}", hot_log_backend::instance().dropped());
+  }
+  if (producer_count > 0) {
+    spdlog::info("{} producers, {} queue, push cost {}", producer_count,
+                 queue, to_string(push_cost));
+    spdlog::info("producers after warm-up: {:.3f} allocs/msg over {} msgs, "
+                 "{} pool blocks",
+                 producer_msgs ? double(producer_allocs.count) / producer_msgs
+                               : 0.0,
+                 producer_msgs, producer_pool_blocks);
+    if (msg_queue) {
+      spdlog::info("queue dropped {}", msg_queue->dropped());
+    }
+  }
+  spdlog::info("[{}] latency {}", placement.name, to_string(sub_latency));
+  spdlog::info("sequence {}", to_string(sub_sequence.get()));
+  if (pub_rate > 0) {
+    spdlog::info("publish lag {}", to_string(pub_lag));
+  }
+  spdlog::info("[{} {}] pub thread: {} msgs in {:.3f} s ({:.0f} msgs/s), {} "
+               "batches, {:.3f} write syscalls/msg, {:.1f} bytes/msg",
+               protocol.describe(), broker_addr.is_unix() ? "uds" : "tcp",
+               pub_sent, pub_seconds,
+               pub_sent / pub_seconds, pub_batches,
+               pub_sent ? double(pub_io.syscw) / pub_sent : 0.0,
+               pub_sent ? double(pub_io.wchar) / pub_sent : 0.0);
+  auto sub_received = sub_sequence.get().received;
+  auto per_msg = [sub_received](std::uint64_t n) {
+    return sub_received ? double(n) / sub_received : 0.0;
+  };
+  spdlog::info("[{}] sub thread: {:.1f} bytes/msg read, {:.3f} allocs/msg",
+               protocol.describe(), per_msg(sub_io.rchar),
+               per_msg(sub_allocs.count));
+  if (receive_queue) {
+    spdlog::info("consumer: {:.3f} allocs/msg, handoff {}",
+                 per_msg(consumer_allocs.count), to_string(handoff_latency));
+  }
+  if (broker) {
+    spdlog::info("broker forward {}", to_string(broker->forward_latency()));
+  }
   spdlog::info("quit with {}", signal_status);
   return 0;
 }
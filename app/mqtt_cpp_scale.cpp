@@ -0,0 +1,266 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "bench_options.hpp"
+#include "cpu_usage.hpp"
+#include "io_context_pool.hpp"
+#include "latency_histogram.hpp"
+#include "loopback_broker.hpp"
+#include "metrics.hpp"
+#include "mqtt_client_cpp.hpp"
+#include "open_loop_publisher.hpp"
+#include "probe_payload.hpp"
+#include "spdlog/spdlog.h"
+#include "thread_placement.hpp"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+// N publishers x M subscribers over T topics, spread over an io_context pool.
+//
+//   mqtt_cpp_scale --pubs=N --subs=M --topics=T --threads=K
+//                  [--rate=<msgs/s per publisher>] [--poisson]
+//                  [--duration=<s>] [--payload-size=<bytes>]
+//                  [--run-mode=blocking|busy-poll|hybrid] [--spin-us=<us>]
+//                  [--placement=<name> --pin-io=<cpus> --numa-local]
+//                  [--embedded-broker] [--metrics-json=<file> ...]
+//
+// Publisher i publishes to topic i % T and subscriber j subscribes to topic
+// j % T, so N > T gives fan-in and M > T gives fan-out. Publishing starts once
+// every subscription is acknowledged.
+
+constexpr auto _TOPIC_PREFIX = "bench/scale/";
+constexpr auto _QOS = MQTT_NS::qos::at_most_once;
+constexpr auto _HOST = "localhost";
+constexpr auto _PORT = 1883;
+
+using client_t = decltype(MQTT_NS::make_async_client(
+    std::declval<boost::asio::io_context &>(), std::string(),
+    std::uint16_t()));
+
+struct publisher {
+  publisher(boost::asio::io_context &ioc, std::uint32_t id, double rate,
+            bool poisson, std::size_t payload_size)
+      : ioc(ioc), timer(ioc), schedule(rate, poisson),
+        probe(id, payload_size) {}
+
+  boost::asio::io_context &ioc;
+  client_t c;
+  std::string topic;
+  boost::asio::steady_timer timer;
+  send_schedule schedule;
+  probe_encoder probe;
+  latency_histogram lag;
+};
+
+struct subscriber {
+  explicit subscriber(boost::asio::io_context &ioc) : ioc(ioc) {}
+
+  boost::asio::io_context &ioc;
+  client_t c;
+  std::string topic;
+  latency_histogram latency;
+  sequence_tracker sequence;
+};
+
+int main(int argc, char **argv) {
+  bench_options opts(argc, argv);
+  auto pub_count = opts.get("pubs", 1);
+  auto sub_count = opts.get("subs", 1);
+  auto topic_count = std::max(opts.get("topics", 1), 1);
+  auto thread_count = opts.get("threads", 1);
+  auto rate = opts.get("rate", 1000.0);
+  auto poisson = opts.get("poisson", false);
+  auto duration = opts.get("duration", 10.0);
+  auto payload_size = opts.get("payload-size", probe_header_size);
+  auto mode = parse_run_mode(opts.get("run-mode", "blocking"));
+  if (!mode) {
+    spdlog::error("unknown --run-mode");
+    return 1;
+  }
+
+  std::unique_ptr<loopback_broker> broker;
+  std::string host = _HOST;
+  std::uint16_t port = _PORT;
+  if (opts.get("embedded-broker", false)) {
+    broker = std::make_unique<loopback_broker>();
+    host = broker->host();
+    port = broker->port();
+  }
+  spdlog::info("{} pubs x {} subs over {} topics, {} threads, {} msgs/s per "
+               "pub, broker {}:{}",
+               pub_count, sub_count, topic_count, thread_count, rate, host,
+               port);
+
+  io_context_pool pool(thread_count);
+  std::atomic_int connected_pubs = 0;
+  std::atomic_int subscribed_subs = 0;
+
+  std::vector<std::unique_ptr<subscriber>> subs;
+  for (int j = 0; j < sub_count; ++j) {
+    auto s = std::make_unique<subscriber>(pool.next());
+    s->topic = _TOPIC_PREFIX + std::to_string(j % topic_count);
+    s->c = MQTT_NS::make_async_client(s->ioc, host, port);
+    using packet_id_t =
+        typename std::remove_reference_t<decltype(*s->c)>::packet_id_t;
+    s->c->set_client_id("scale_sub_" + std::to_string(j));
+    s->c->set_keep_alive_sec(10);
+    s->c->set_clean_session(true);
+    auto &sr = *s;
+    s->c->set_connack_handler(
+        [&sr](bool, MQTT_NS::connect_return_code connack_return_code) {
+          if (connack_return_code == MQTT_NS::connect_return_code::accepted) {
+            sr.c->async_subscribe(sr.topic, _QOS);
+          }
+          return true;
+        });
+    s->c->set_suback_handler(
+        [&subscribed_subs](packet_id_t,
+                           std::vector<MQTT_NS::suback_return_code>) {
+          ++subscribed_subs;
+          return true;
+        });
+    s->c->set_error_handler([&sr](MQTT_NS::error_code ec) {
+      spdlog::error("{}: {}", sr.c->get_client_id(), ec.message());
+    });
+    s->c->set_publish_handler([&sr](MQTT_NS::optional<packet_id_t>,
+                                    MQTT_NS::publish_options,
+                                    MQTT_NS::buffer,
+                                    MQTT_NS::buffer contents) {
+      auto &metrics = client_metrics();
+      metrics.msgs_received.add();
+      metrics.bytes_received.add(contents.size());
+      probe_header h;
+      if (!decode_probe(contents.data(), contents.size(), h)) {
+        sr.sequence.on_malformed();
+        return true;
+      }
+      sr.sequence.on_receive(h);
+      auto delay = probe_age_ns(h);
+      sr.latency.record(delay);
+      metrics.latency.record(delay);
+      return true;
+    });
+    subs.push_back(std::move(s));
+  }
+
+  std::vector<std::unique_ptr<publisher>> pubs;
+  for (int i = 0; i < pub_count; ++i) {
+    auto p = std::make_unique<publisher>(pool.next(), i, rate, poisson,
+                                         payload_size);
+    p->topic = _TOPIC_PREFIX + std::to_string(i % topic_count);
+    p->c = MQTT_NS::make_async_client(p->ioc, host, port);
+    p->c->set_client_id("scale_pub_" + std::to_string(i));
+    p->c->set_keep_alive_sec(10);
+    p->c->set_clean_session(true);
+    auto &pr = *p;
+    p->c->set_connack_handler(
+        [&connected_pubs](bool, MQTT_NS::connect_return_code) {
+          ++connected_pubs;
+          return true;
+        });
+    p->c->set_error_handler([&pr](MQTT_NS::error_code ec) {
+      spdlog::error("{}: {}", pr.c->get_client_id(), ec.message());
+    });
+    pubs.push_back(std::move(p));
+  }
+
+  // io thread k is pinned to the k-th CPU of --pin-io, if given.
+  auto placement = thread_placement::from_options(opts);
+  spdlog::info("placement {}", placement.describe());
+  pool.run(*mode, std::chrono::microseconds(opts.get("spin-us", 50)),
+           [&placement](std::size_t k) {
+             placement.enter(placement.io ? std::optional(placement.io->nth(k))
+                                          : std::nullopt);
+           });
+  for (auto &s : subs) {
+    boost::asio::post(s->ioc, [&s] { s->c->async_connect(); });
+  }
+  for (auto &p : pubs) {
+    boost::asio::post(p->ioc, [&p] { p->c->async_connect(); });
+  }
+
+  auto deadline = std::chrono::steady_clock::now() + 10s;
+  while ((connected_pubs < pub_count || subscribed_subs < sub_count) &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(10ms);
+  }
+  spdlog::info("{}/{} pubs connected, {}/{} subs subscribed",
+               connected_pubs.load(), pub_count, subscribed_subs.load(),
+               sub_count);
+
+  metrics_exporter exporter(metrics_options::from_options(opts));
+  cpu_meter cpu;
+  for (auto &p : pubs) {
+    boost::asio::post(p->ioc, [&p] {
+      auto &pr = *p;
+      pr.schedule.start(get_ns());
+      publish_open_loop(pr.timer, pr.schedule, pr.lag,
+                        [&pr](std::int64_t intended_ns) {
+                          auto payload = pr.probe.next(intended_ns);
+                          pr.c->async_publish(pr.topic, std::string(payload),
+                                              _QOS);
+                          client_metrics().msgs_sent.add();
+                          client_metrics().bytes_sent.add(payload.size());
+                        });
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+  for (auto &p : pubs) {
+    boost::asio::post(p->ioc, [&p] { p->timer.cancel(); });
+  }
+  // Let in-flight messages drain before measuring.
+  std::this_thread::sleep_for(200ms);
+  auto wall = cpu.wall_seconds();
+  auto cpu_seconds = cpu.cpu_seconds();
+
+  for (auto &p : pubs) {
+    boost::asio::post(p->ioc, [&p] { p->c->async_disconnect(); });
+  }
+  for (auto &s : subs) {
+    boost::asio::post(s->ioc, [&s] { s->c->async_disconnect(); });
+  }
+  std::this_thread::sleep_for(100ms);
+  pool.stop();
+
+  std::uint64_t sent = 0;
+  latency_histogram lag;
+  for (auto &p : pubs) {
+    sent += p->probe.sent();
+    lag.merge(p->lag);
+  }
+  std::uint64_t received = 0;
+  latency_histogram latency;
+  for (std::size_t j = 0; j < subs.size(); ++j) {
+    auto &s = *subs[j];
+    received += s.sequence.get().received;
+    latency.merge(s.latency);
+    spdlog::info("sub {} latency {}", j, to_string(s.latency));
+    spdlog::info("sub {} sequence {}", j, to_string(s.sequence.get()));
+  }
+  spdlog::info("sent {} ({:.0f} msgs/s), received {} ({:.0f} msgs/s)", sent,
+               sent / wall, received, received / wall);
+  spdlog::info("cpu {:.3f} s over {:.3f} s wall ({:.2f} cores, {:.3f} us/msg)",
+               cpu_seconds, wall, cpu_seconds / wall,
+               received ? cpu_seconds * 1e6 / received : 0.0);
+  for (std::size_t k = 0; k < pool.runners().size(); ++k) {
+    auto &r = *pool.runners()[k];
+    spdlog::info("io thread {}: {} run, {:.3f} cpu s, {} handlers", k,
+                 to_string(r.mode()), r.cpu_seconds(), r.handlers());
+  }
+  spdlog::info("[{}] latency {}", placement.name, to_string(latency));
+  spdlog::info("publish lag {}", to_string(lag));
+  if (broker) {
+    spdlog::info("broker forward {}", to_string(broker->forward_latency()));
+  }
+  return 0;
+}
@@ -3,10 +3,16 @@
 // Distributed under the Boost Software License, Version 1.0.
 // (See accompanying file LICENSE_1_0.txt or copy at
 // http://www.boost.org/LICENSE_1_0.txt)
+#include "bench_options.hpp"
+#include "hot_log.hpp"
+#include "latency_histogram.hpp"
+#include "loopback_broker.hpp"
+#include "metrics.hpp"
+#include "probe_payload.hpp"
+#include "reconnect_engine.hpp"
 #include <iomanip>
 #include <iostream>
 #include <map>
-#include <math.h>
 #include <mqtt_client_cpp.hpp>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
@@ -17,41 +23,45 @@ constexpr auto _TOPIC = "hello_echo";
 constexpr auto _QOS = MQTT_NS::qos::at_most_once;
 constexpr auto _HOST = "localhost";
 constexpr auto _PORT = 1883;
-
-auto get_ms() {
-  return std::chrono::steady_clock::now().time_since_epoch().count() * 1e-6;
-}
+constexpr auto _REPORT_EVERY = 1000;
+constexpr auto _PUBLISHER_ID = 1;
 
 boost::asio::io_context ioc;
-auto c = MQTT_NS::make_sync_client(ioc, _HOST, _PORT);
+std::unique_ptr<loopback_broker> broker;
+decltype(MQTT_NS::make_sync_client(ioc, _HOST, _PORT)) c;
 int count = 0;
-double total_latency = 0;
-std::vector<double> arr;
+latency_histogram latency;
+probe_encoder probe(_PUBLISHER_ID);
+sequence_tracker sequence;
 auto logger = spdlog::logger(
     "echo", {std::make_shared<spdlog::sinks::basic_file_sink_mt>(
                  "test_echo_cpp.log", true),
              std::make_shared<spdlog::sinks::stdout_color_sink_mt>()});
 
-template <class T> T square(T v) { return v * v; }
-
 void publish(int n) {
-  std::string payload = std::to_string(get_ms());
-  c->publish(_TOPIC, payload, _QOS);
-  logger.debug("time {} ,topic published:{}", payload, n);
-}
-
-double stdev(std::vector<double> vec, double m, double n) {
-  double sum = 0;
-  double variance = 0;
-  for (auto it = vec.begin(); it != vec.end(); ++it) {
-    sum += square(*it - m);
-  }
-  variance = sqrt(sum / (n));
-  return variance;
+  auto now = get_ns();
+  std::string payload(probe.next(now));
+  client_metrics().msgs_sent.add();
+  client_metrics().bytes_sent.add(payload.size());
+  c->publish(_TOPIC, std::move(payload), _QOS);
+  hot_log(logger, spdlog::level::debug, "time {} ,topic published:{}", now, n);
 }
 
 int main(int argc, char **argv) {
+  bench_options opts(argc, argv);
+  probe = probe_encoder(_PUBLISHER_ID,
+                        opts.get("payload-size", probe_header_size));
   logger.set_level(spdlog::level::debug);
+  if (opts.get("hot-log", false)) {
+    hot_log_backend::instance().start();
+  }
+  if (opts.get("embedded-broker", false)) {
+    broker = std::make_unique<loopback_broker>();
+    logger.info("embedded broker on {}:{}", broker->host(), broker->port());
+    c = MQTT_NS::make_sync_client(ioc, broker->host(), broker->port());
+  } else {
+    c = MQTT_NS::make_sync_client(ioc, resolve_once(_HOST, _PORT), _PORT);
+  }
   using packet_id_t =
       typename std::remove_reference_t<decltype(*c)>::packet_id_t;
   // Setup client
@@ -59,31 +69,23 @@ int main(int argc, char **argv) {
   c->set_keep_alive_sec(10);
   c->set_clean_session(true);
   // Setup handlers
-  boost::asio::steady_timer tim(ioc);
-  std::function<void()> reconnect;
-  reconnect = [&] {
-    // wait 3 seconds and connect again
-    tim.expires_after(std::chrono::seconds(3));
-    tim.async_wait([&](boost::system::error_code const &ec) {
-      if (!ec) {
-        // timer fired
-        std::cout << "try connect again" << std::endl;
-        mqtt::error_code ec;
-        c->connect(ec); // connect again
-        if (ec) {
-          std::cout << "error " << ec.message() << std::endl;
-          reconnect();
-        }
-      }
-    });
-  };
+  reconnect_engine reconnect(ioc, backoff_policy::from_options(opts), [&] {
+    std::cout << "try connect again" << std::endl;
+    MQTT_NS::error_code ec;
+    c->connect(ec); // connect again
+    if (ec) {
+      std::cout << "error " << ec.message() << std::endl;
+      reconnect.retry();
+    }
+  });
 
-  c->set_connack_handler([](bool sp,
-                            mqtt::connect_return_code connack_return_code) {
+  c->set_connack_handler([&](bool sp,
+                             MQTT_NS::connect_return_code connack_return_code) {
     std::cout << "Connack handler called" << std::endl;
     std::cout << "Session Present: " << std::boolalpha << sp << std::endl;
     std::cout << "Connack Return Code: " << connack_return_code << std::endl;
-    if (connack_return_code == mqtt::connect_return_code::accepted) {
+    if (connack_return_code == MQTT_NS::connect_return_code::accepted) {
+      reconnect.on_connected();
       c->subscribe(_TOPIC, _QOS);
     }
     return true;
@@ -100,31 +102,56 @@ int main(int argc, char **argv) {
 
   c->set_close_handler([&] {
     std::cout << "connection closed" << std::endl;
-    reconnect();
+    reconnect.retry();
   });
   c->set_error_handler([&](boost::system::error_code const &ec) {
     std::cout << "connection error " << ec.message() << std::endl;
-    reconnect();
+    reconnect.retry();
   });
 
   c->set_publish_handler([&](MQTT_NS::optional<packet_id_t> packet_id,
                              MQTT_NS::publish_options pubopts,
                              MQTT_NS::buffer topic_name,
                              MQTT_NS::buffer contents) {
-    auto now = get_ms();
-    auto delay = now - std::stod(contents.data());
-    arr.push_back(delay);
+    probe_header h;
+    if (!decode_probe(contents.data(), contents.size(), h)) {
+      sequence.on_malformed();
+      return true;
+    }
+    auto delay = probe_age_ns(h);
+    reconnect.on_message();
+    sequence.on_receive(h);
     count++;
-    total_latency += delay;
-    double _mean = total_latency / (count);
-    double _std = stdev(arr, _mean, count);
-    logger.debug("time {} ,topic recieved:{} , time elapsed {} ms ,time "
-                 "elapsed _mean {} ms ,time elapsed std  {}",
-                 now, count - 1, delay, _mean, _std);
+    latency.record(delay);
+    auto &metrics = client_metrics();
+    metrics.msgs_received.add();
+    metrics.bytes_received.add(contents.size());
+    metrics.latency.record(delay);
+    hot_log(logger, spdlog::level::debug,
+            "time {} ,topic recieved:{} , time elapsed {} ms",
+            h.send_ns + delay, count - 1, delay * 1e-6);
+    if (count % _REPORT_EVERY == 0) {
+      logger.info("latency {}", to_string(latency));
+      logger.info("sequence {}", to_string(sequence.get()));
+      if (reconnect.attempts()) {
+        logger.info("reconnect {}", to_string(reconnect));
+      }
+      if (hot_log_backend::instance().enabled()) {
+        logger.info("hot log dropped {}",
+                    hot_log_backend::instance().dropped());
+      }
+      if (broker) {
+        logger.info("broker forward {}", to_string(broker->forward_latency()));
+      }
+    }
     publish(count);
     return true;
   });
 
+  metrics_exporter exporter(metrics_options::from_options(opts));
+  if (exporter.port()) {
+    logger.info("metrics on 127.0.0.1:{}", exporter.port());
+  }
   c->connect();
   ioc.run();
 }
@@ -0,0 +1,221 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "bench_options.hpp"
+#include "gateway.hpp"
+#include "latency_histogram.hpp"
+#include "loopback_broker.hpp"
+#include "metrics.hpp"
+#include "mqtt_client_cpp.hpp"
+#include "open_loop_publisher.hpp"
+#include "probe_payload.hpp"
+#include "shared_payload.hpp"
+#include "spdlog/spdlog.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <signal.h>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+// Echo/bridge gateway: subscribes to the input topics of its routes, runs
+// every message through a transform on a worker pool and republishes it on
+// the route's output topic (see gateway.hpp for the pipeline).
+//
+//   mqtt_gateway [--broker=tcp://host:port | --embedded-broker]
+//                [--routes=<filter>=<topic>,...] [--transform=echo|upper|
+//                reverse|spin:<us>] [--workers=2] [--queue-capacity=4096]
+//                [--queue-full=block|drop-oldest|drop-newest] [--qos=0]
+//                [--stats-every=<s>] [metrics options]
+//
+// By default it echoes hello_delay_tx to hello_delay_rx on localhost:1883,
+// the service mqtt_test expects. It runs until SIGINT, logging the gateway
+// counters, per-stage queue depth and latency every --stats-every seconds.
+//
+//   mqtt_gateway --self-test [--rate=1000] [--duration=5]
+//                [--payload-size=<bytes>] [...]
+//
+// runs a round trip through the gateway instead, against the embedded
+// broker unless --broker is given: probes are published open-loop on the
+// first route's input topic (wildcard levels filled in) and timed when they
+// come back on its output, then the round trip and the gateway's own share
+// of it are logged.
+
+constexpr std::uint32_t _PUBLISHER_ID = 1;
+
+std::atomic_bool running = true;
+void signal_handler(int) { running = false; }
+
+// A concrete topic matching filter.
+std::string sample_topic(std::string_view filter) {
+  std::string out;
+  for (;;) {
+    auto slash = filter.find('/');
+    auto level = filter.substr(0, slash);
+    out += level == "+" || level == "#" ? "self_test" : std::string(level);
+    if (slash == std::string_view::npos) {
+      return out;
+    }
+    out += '/';
+    filter.remove_prefix(slash + 1);
+  }
+}
+
+int self_test(const gateway &gw, const gateway_config &config,
+              const bench_options &opts) {
+  auto &route = config.routes.front();
+  auto in_topic = sample_topic(route.filter);
+  auto out_topic = route.out_topic.back() == '/' ? route.out_topic + in_topic
+                                                 : route.out_topic;
+  auto rate = opts.get("rate", 1000.0);
+  auto duration = opts.get("duration", 5.0);
+  auto payload_size = opts.get("payload-size", probe_header_size);
+
+  boost::asio::io_context ioc;
+  auto c = MQTT_NS::make_async_client(ioc, config.broker.host,
+                                      config.broker.port);
+  using packet_id_t =
+      typename std::remove_reference_t<decltype(*c)>::packet_id_t;
+  c->set_client_id("gateway_self_test");
+  c->set_keep_alive_sec(30);
+  c->set_clean_session(true);
+  std::promise<void> ready;
+  c->set_connack_handler([&](bool, MQTT_NS::connect_return_code rc) {
+    if (rc == MQTT_NS::connect_return_code::accepted) {
+      c->async_subscribe(out_topic, MQTT_NS::qos::at_most_once);
+    }
+    return true;
+  });
+  c->set_suback_handler(
+      [&](packet_id_t, std::vector<MQTT_NS::suback_return_code>) {
+        ready.set_value();
+        return true;
+      });
+  std::mutex mutex;
+  latency_histogram round_trip;
+  std::atomic<std::uint64_t> received{0};
+  c->set_publish_handler([&](MQTT_NS::optional<packet_id_t>,
+                             MQTT_NS::publish_options, MQTT_NS::buffer,
+                             MQTT_NS::buffer contents) {
+    probe_header h;
+    if (decode_probe(contents, h) && h.publisher_id == _PUBLISHER_ID) {
+      std::lock_guard<std::mutex> lock(mutex);
+      round_trip.record(probe_age_ns(h));
+      received.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+  });
+  c->set_error_handler([](MQTT_NS::error_code ec) {
+    spdlog::error("self test client: {}", ec.message());
+  });
+  auto connected = ready.get_future();
+  c->async_connect();
+  std::thread io([&] { ioc.run(); });
+  if (connected.wait_for(10s) != std::future_status::ready) {
+    spdlog::error("self test client could not subscribe");
+    ioc.stop();
+    io.join();
+    return 1;
+  }
+
+  spdlog::info("self test: {} msgs/s for {} s, {} -> {}", rate, duration,
+               in_topic, out_topic);
+  auto topic = MQTT_NS::allocate_buffer(in_topic.begin(), in_topic.end());
+  send_schedule schedule(rate, false);
+  probe_encoder probe(_PUBLISHER_ID, payload_size);
+  schedule.start(get_ns());
+  auto end_ns = get_ns() + static_cast<std::int64_t>(duration * 1e9);
+  for (auto t = schedule.next_ns(); t < end_ns && running;
+       t = schedule.next_ns()) {
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+        std::chrono::nanoseconds(t)));
+    boost::asio::post(ioc, [&, p = make_shared_payload(probe.next(t))] {
+      c->async_publish(topic, p, MQTT_NS::qos::at_most_once);
+    });
+    schedule.advance();
+  }
+  auto deadline = std::chrono::steady_clock::now() + 2s;
+  while (received.load() < probe.sent() &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(1ms);
+  }
+  boost::asio::post(ioc, [&c] { c->async_disconnect(); });
+  std::this_thread::sleep_for(100ms);
+  ioc.stop();
+  io.join();
+
+  std::lock_guard<std::mutex> lock(mutex);
+  spdlog::info("self test: sent {} received {}", probe.sent(),
+               received.load());
+  spdlog::info("round trip {}", to_string(round_trip));
+  std::ostringstream os;
+  os << gw.stats();
+  spdlog::info("gateway {}", os.str());
+  return received.load() ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  bench_options opts(argc, argv);
+  signal(SIGINT, signal_handler);
+  gateway_config config;
+  try {
+    config = gateway_config::from_options(opts);
+  } catch (const std::exception &e) {
+    spdlog::error("{}", e.what());
+    return 1;
+  }
+  bool self = opts.get("self-test", false);
+  std::unique_ptr<loopback_broker> broker;
+  if (opts.get("embedded-broker", false) || (self && !opts.has("broker"))) {
+    broker = std::make_unique<loopback_broker>();
+    config.broker.host = broker->host();
+    config.broker.port = broker->port();
+  }
+
+  metrics_exporter exporter(metrics_options::from_options(opts));
+  if (exporter.port()) {
+    spdlog::info("metrics on 127.0.0.1:{}", exporter.port());
+  }
+  std::unique_ptr<gateway> gw;
+  try {
+    gw = std::make_unique<gateway>(config);
+  } catch (const std::exception &e) {
+    spdlog::error("{}", e.what());
+    return 1;
+  }
+  spdlog::info("gateway on {}: {} routes, transform {}, {} workers",
+               config.broker.describe(), config.routes.size(),
+               config.transform, config.workers);
+  for (auto &r : config.routes) {
+    spdlog::info("  {} -> {}", r.filter, r.out_topic);
+  }
+  if (self) {
+    return self_test(*gw, config, opts);
+  }
+
+  auto every = std::chrono::milliseconds(
+      static_cast<std::int64_t>(opts.get("stats-every", 10.0) * 1000));
+  auto next = std::chrono::steady_clock::now() + every;
+  while (running) {
+    std::this_thread::sleep_for(100ms);
+    if (std::chrono::steady_clock::now() >= next) {
+      next += every;
+      std::ostringstream os;
+      os << gw->stats();
+      spdlog::info("gateway {}", os.str());
+    }
+  }
+  std::ostringstream os;
+  os << gw->stats();
+  spdlog::info("gateway {}", os.str());
+  return 0;
+}
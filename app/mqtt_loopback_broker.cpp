@@ -0,0 +1,43 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "bench_options.hpp"
+#include "loopback_broker.hpp"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <signal.h>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+// Stand-alone run of the embedded benchmark broker, for clients living in
+// other processes (e.g. the Paho C samples).
+//
+//   mqtt_loopback_broker [--port=1883] [--unix-socket=<path>]
+//
+// With --unix-socket it accepts on that Unix domain socket as well, e.g. for
+// clients given --broker=unix:///run/mqtt.sock.
+
+std::atomic_bool running = true;
+void signal_handler(int) { running = false; }
+
+int main(int argc, char **argv) {
+  bench_options opts(argc, argv);
+  signal(SIGINT, signal_handler);
+  loopback_broker broker(static_cast<std::uint16_t>(opts.get("port", 1883)),
+                         opts.get("unix-socket", ""));
+  std::cout << "listening on " << broker.host() << ":" << broker.port()
+            << std::endl;
+  if (!broker.unix_path().empty()) {
+    std::cout << "listening on unix://" << broker.unix_path() << std::endl;
+  }
+  while (running) {
+    std::this_thread::sleep_for(100ms);
+  }
+  std::cout << "broker forward " << broker.forward_latency() << std::endl;
+  return 0;
+}
@@ -0,0 +1,367 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "alloc_counter.hpp"
+#include "bench_options.hpp"
+#include "loopback_broker.hpp"
+#include "mqtt_client_cpp.hpp"
+#include "probe_payload.hpp"
+#include "shared_payload.hpp"
+#include "spdlog/sinks/stdout_color_sinks.h"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Sweeps the payload size and compares the copying publish path with the
+// zero-copy one.
+//
+//   mqtt_payload_sweep [--min-size=16] [--max-size=1048576] [--step=4]
+//                      [--bytes-per-size=<bytes>] [--window=<publishes>]
+//                      [--fanout=<topics>] [--paths=copy,shared]
+//                      [--embedded-broker] [--report=<file>]
+//
+// For every size the publisher builds a fresh payload per message and
+// publishes it, QoS 0, to each of the fanout topics, keeping at most window
+// publishes queued in the client. On the copy path the payload is a
+// std::string handed over per topic, the way the benchmarks used to publish;
+// on the shared path it is built once in an MQTT_NS::buffer that every topic
+// and the socket write share. Throughput is payload bytes received by the
+// subscriber per second. Copies per message are the payload-sized bytes the
+// publishing thread allocates per publish, divided by the payload size;
+// building the payload counts as one, so the shared path reads 1 / fanout.
+// Small fixed allocations per publish make this read a little high for tiny
+// payloads. The report goes to --report, or to stdout; progress is logged to
+// stderr.
+
+constexpr auto _HOST = "localhost";
+constexpr auto _PORT = 1883;
+
+using client_t = decltype(MQTT_NS::make_async_client(
+    std::declval<boost::asio::io_context &>(), std::string(),
+    std::uint16_t()));
+using packet_id_t =
+    std::remove_reference_t<decltype(*std::declval<client_t>())>::packet_id_t;
+
+enum class publish_path { copy, shared };
+
+const char *to_string(publish_path p) {
+  return p == publish_path::copy ? "copy" : "shared";
+}
+
+struct step_result {
+  publish_path path;
+  std::size_t size = 0;
+  std::uint64_t published = 0;
+  std::uint64_t received = 0;
+  std::uint64_t received_bytes = 0;
+  double seconds = 0;
+  alloc_stats allocs;
+};
+
+// Written on the sub thread, read by main.
+struct receiver {
+  std::atomic<std::uint64_t> msgs{0};
+  std::atomic<std::uint64_t> bytes{0};
+  std::atomic<std::int64_t> last_ns{0};
+
+  void reset() {
+    msgs = 0;
+    bytes = 0;
+    last_ns = 0;
+  }
+};
+
+// A client on its own io_context thread.
+struct connection {
+  boost::asio::io_context ioc;
+  client_t c;
+  std::thread thread;
+
+  connection(const std::string &host, std::uint16_t port, const char *id)
+      : c(MQTT_NS::make_async_client(ioc, host, port)) {
+    c->set_client_id(id);
+    c->set_keep_alive_sec(30);
+    c->set_clean_session(true);
+    c->set_error_handler([id](MQTT_NS::error_code ec) {
+      spdlog::error("{}: {}", id, ec.message());
+    });
+  }
+
+  void run() {
+    boost::asio::post(ioc, [this] { c->async_connect(); });
+    thread = std::thread([this] { ioc.run(); });
+  }
+
+  ~connection() {
+    if (!thread.joinable()) {
+      return;
+    }
+    boost::asio::post(ioc, [this] { c->async_disconnect(); });
+    // run() returns once the broker has closed the connection.
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ioc.stop();
+    thread.join();
+  }
+};
+
+// Publishes count payloads of one size, each to every topic, on the pub
+// connection's thread. The write completion of one publish lets the next one
+// in, so at most window are queued in the client at any time.
+class pump {
+public:
+  pump(client_t &c, publish_path path, std::size_t size, std::uint64_t count,
+       std::size_t window, const std::vector<std::string> &topics)
+      : c_(c), path_(path), size_(size), count_(count), window_(window),
+        topics_(topics) {
+    for (auto &t : topics_) {
+      topic_buffers_.push_back(static_buffer(t));
+    }
+  }
+
+  // Call on the connection's thread.
+  void start() { fill(); }
+
+  std::future<void> done() { return done_.get_future(); }
+  std::uint64_t published() const { return published_; }
+  const alloc_stats &allocs() const { return allocs_; }
+
+private:
+  void fill() {
+    while (inflight_ + topics_.size() <= window_ && sent_ < count_) {
+      publish_one();
+    }
+    if (inflight_ == 0 && sent_ == count_) {
+      done_.set_value();
+    }
+  }
+
+  void publish_one() {
+    auto on_written = [this](MQTT_NS::error_code) {
+      --inflight_;
+      fill();
+    };
+    auto before = thread_allocations();
+    if (path_ == publish_path::copy) {
+      auto payload = make_payload();
+      for (auto &t : topics_) {
+        c_->async_publish(t, payload, MQTT_NS::qos::at_most_once, on_written);
+      }
+    } else {
+      auto payload = make_buffer();
+      for (auto &t : topic_buffers_) {
+        c_->async_publish(t, payload, MQTT_NS::qos::at_most_once, on_written);
+      }
+    }
+    allocs_ += thread_allocations() - before;
+    inflight_ += topics_.size();
+    published_ += topics_.size();
+    ++sent_;
+  }
+
+  std::string make_payload() {
+    std::string p(size_, '\0');
+    stamp(p.data());
+    return p;
+  }
+
+  MQTT_NS::buffer make_buffer() {
+    std::shared_ptr<char[]> p(new char[size_]);
+    std::memset(p.get(), 0, size_);
+    stamp(p.get());
+    MQTT_NS::string_view view(p.get(), size_);
+    return MQTT_NS::buffer(view, std::move(p));
+  }
+
+  // Sequence number in the leading bytes, as far as they go.
+  void stamp(char *p) {
+    std::memcpy(p, &sent_, std::min(size_, sizeof(sent_)));
+  }
+
+  client_t &c_;
+  publish_path path_;
+  std::size_t size_;
+  std::uint64_t count_;
+  std::size_t window_;
+  const std::vector<std::string> &topics_;
+  std::vector<MQTT_NS::buffer> topic_buffers_;
+  std::uint64_t sent_ = 0;
+  std::uint64_t published_ = 0;
+  std::size_t inflight_ = 0;
+  alloc_stats allocs_;
+  std::promise<void> done_;
+};
+
+step_result run_step(connection &pub, receiver &rx, publish_path path,
+                     std::size_t size, std::uint64_t count, std::size_t window,
+                     const std::vector<std::string> &topics) {
+  step_result r;
+  r.path = path;
+  r.size = size;
+  rx.reset();
+  pump p(pub.c, path, size, count, window, topics);
+  auto done = p.done();
+  auto start = get_ns();
+  boost::asio::post(pub.ioc, [&p] { p.start(); });
+  done.wait();
+  // QoS 0 over loopback should not drop, but do not wait for ever.
+  auto expected = count * topics.size();
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (rx.msgs.load() < expected &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  r.published = p.published();
+  r.received = rx.msgs.load();
+  r.received_bytes = rx.bytes.load();
+  r.seconds = r.received ? (rx.last_ns.load() - start) * 1e-9 : 0;
+  r.allocs = p.allocs();
+  return r;
+}
+
+double copies_per_msg(const step_result &r) {
+  return r.published ? double(r.allocs.bytes) / r.published / r.size : 0;
+}
+
+double gbytes_per_s(const step_result &r) {
+  return r.seconds ? r.received_bytes / r.seconds * 1e-9 : 0;
+}
+
+std::string json_result(const step_result &r) {
+  std::ostringstream os;
+  os << "    {\"path\": \"" << to_string(r.path) << "\", \"size\": " << r.size
+     << ", \"published\": " << r.published << ", \"received\": " << r.received
+     << ", \"lost\": "
+     << (r.published > r.received ? r.published - r.received : 0)
+     << ", \"seconds\": " << r.seconds
+     << ", \"msgs_per_s\": " << (r.seconds ? r.received / r.seconds : 0)
+     << ", \"gbytes_per_s\": " << gbytes_per_s(r)
+     << ", \"copies_per_msg\": " << copies_per_msg(r)
+     << ", \"allocs_per_msg\": "
+     << (r.published ? double(r.allocs.count) / r.published : 0) << "}";
+  return os.str();
+}
+
+int main(int argc, char **argv) {
+  spdlog::set_default_logger(spdlog::stderr_color_mt("sweep"));
+  bench_options opts(argc, argv);
+  auto min_size = opts.get("min-size", std::size_t(16));
+  auto max_size = opts.get("max-size", std::size_t(1) << 20);
+  auto step = std::max(opts.get("step", std::size_t(4)), std::size_t(2));
+  auto bytes_per_size = opts.get("bytes-per-size", std::size_t(256) << 20);
+  auto window = opts.get("window", std::size_t(64));
+  auto fanout = std::max(opts.get("fanout", std::size_t(1)), std::size_t(1));
+  window = std::max(window, fanout);
+
+  std::vector<publish_path> paths;
+  std::istringstream is(opts.get("paths", "copy,shared"));
+  for (std::string name; std::getline(is, name, ',');) {
+    if (name == "copy") {
+      paths.push_back(publish_path::copy);
+    } else if (name == "shared") {
+      paths.push_back(publish_path::shared);
+    } else {
+      spdlog::error("unknown path {}", name);
+      return 1;
+    }
+  }
+
+  std::vector<std::string> topics;
+  for (std::size_t i = 0; i < fanout; ++i) {
+    topics.push_back("sweep/" + std::to_string(i));
+  }
+
+  std::string host = _HOST;
+  std::uint16_t port = _PORT;
+  std::unique_ptr<loopback_broker> broker;
+  if (opts.get("embedded-broker", false)) {
+    broker = std::make_unique<loopback_broker>();
+    host = broker->host();
+    port = broker->port();
+  }
+
+  receiver rx;
+  connection sub(host, port, "sweep_sub");
+  connection pub(host, port, "sweep_pub");
+  std::promise<void> sub_ready, pub_ready;
+  sub.c->set_connack_handler([&](bool, MQTT_NS::connect_return_code rc) {
+    if (rc == MQTT_NS::connect_return_code::accepted) {
+      sub.c->async_subscribe("sweep/#", MQTT_NS::qos::at_most_once);
+    }
+    return true;
+  });
+  sub.c->set_suback_handler(
+      [&](packet_id_t, std::vector<MQTT_NS::suback_return_code>) {
+        sub_ready.set_value();
+        return true;
+      });
+  sub.c->set_publish_handler(
+      [&rx](MQTT_NS::optional<packet_id_t>, MQTT_NS::publish_options,
+            MQTT_NS::buffer, MQTT_NS::buffer contents) {
+        rx.bytes.fetch_add(contents.size(), std::memory_order_relaxed);
+        rx.last_ns.store(get_ns(), std::memory_order_relaxed);
+        rx.msgs.fetch_add(1, std::memory_order_release);
+        return true;
+      });
+  pub.c->set_connack_handler([&](bool, MQTT_NS::connect_return_code rc) {
+    if (rc == MQTT_NS::connect_return_code::accepted) {
+      pub_ready.set_value();
+    }
+    return true;
+  });
+  auto sub_done = sub_ready.get_future();
+  auto pub_done = pub_ready.get_future();
+  sub.run();
+  pub.run();
+  using namespace std::chrono_literals;
+  if (sub_done.wait_for(10s) != std::future_status::ready ||
+      pub_done.wait_for(10s) != std::future_status::ready) {
+    spdlog::error("timed out connecting to {}:{}", host, port);
+    return 1;
+  }
+
+  std::vector<std::string> results;
+  for (auto size = min_size; size <= max_size; size *= step) {
+    auto count = std::clamp<std::uint64_t>(bytes_per_size / size, 200, 100000);
+    for (auto path : paths) {
+      auto r = run_step(pub, rx, path, size, count, window, topics);
+      spdlog::info("{:>8} B {:>6}: {:.3f} GB/s, {:.0f} msgs/s, {:.2f} "
+                   "copies/msg, {} lost",
+                   size, to_string(path), gbytes_per_s(r),
+                   r.seconds ? r.received / r.seconds : 0, copies_per_msg(r),
+                   r.published > r.received ? r.published - r.received : 0);
+      results.push_back(json_result(r));
+    }
+  }
+
+  std::ostringstream report;
+  report << "{\n  \"workload\": {\"broker\": \""
+         << (broker ? "embedded" : host + ":" + std::to_string(port))
+         << "\", \"fanout\": " << fanout << ", \"window\": " << window
+         << ", \"bytes_per_size\": " << bytes_per_size
+         << "},\n  \"results\": [\n";
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    report << results[i] << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  report << "  ]\n}\n";
+
+  auto path = opts.get("report", "");
+  if (path.empty()) {
+    std::cout << report.str();
+  } else {
+    std::ofstream(path) << report.str();
+    spdlog::info("report written to {}", path);
+  }
+  return 0;
+}
@@ -0,0 +1,307 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "alloc_counter.hpp"
+#include "bench_options.hpp"
+#include "loopback_broker.hpp"
+#include "mqtt_client_cpp.hpp"
+#include "probe_payload.hpp"
+#include "spdlog/sinks/stdout_color_sinks.h"
+#include "spdlog/spdlog.h"
+#include "topic_router.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Measures topic_router at growing subscription counts, next to the linear
+// filter scan the loopback broker does.
+//
+//   mqtt_topic_router_bench [--filters=10,1000,100000] [--messages=1000000]
+//                           [--wildcards=0.1] [--misses=0.1]
+//                           [--subscribe] [--per-packet=256]
+//                           [--report=<file>]
+//
+// Filters look like a gateway's device subscriptions,
+// site/<s>/device/<d>/<metric>, one device each: mostly exact, with a
+// --wildcards fraction of site/<s>/device/<d>/+ and, one in ten of those,
+// site/<s>/#. Messages go to metrics of the subscribed devices, and a
+// --misses fraction to devices nobody subscribed to. Match time is per
+// message, handler calls included; the linear scan runs fewer messages at
+// large filter counts, and so does not time every topic.
+//
+// With --subscribe, a client subscribes to each filter set on the embedded
+// broker, --per-packet filters to a SUBSCRIBE, and the time from CONNACK to
+// the last SUBACK is reported. The report goes to --report, or to stdout;
+// progress is logged to stderr.
+
+using handler_t = std::function<void(std::string_view)>;
+using client_t = decltype(MQTT_NS::make_async_client(
+    std::declval<boost::asio::io_context &>(), std::string(),
+    std::uint16_t()));
+using packet_id_t =
+    std::remove_reference_t<decltype(*std::declval<client_t>())>::packet_id_t;
+
+const char *const _METRICS[] = {"temperature", "humidity", "power", "status"};
+constexpr std::size_t _DEVICES_PER_SITE = 100;
+
+struct step_result {
+  std::size_t filters = 0;
+  std::size_t distinct = 0;
+  std::size_t nodes = 0;
+  std::size_t trie_bytes = 0;
+  std::uint64_t messages = 0;
+  double match_ns = 0;
+  double routes_per_msg = 0;
+  alloc_stats allocs;
+  std::uint64_t linear_messages = 0;
+  double linear_ns = 0;
+  std::size_t subscribe_packets = 0;
+  double subscribe_ms = 0;
+  std::string error;
+};
+
+std::string device_topic(std::size_t device, const char *metric) {
+  return "site/" + std::to_string(device / _DEVICES_PER_SITE) + "/device/" +
+         std::to_string(device % _DEVICES_PER_SITE) + "/" + metric;
+}
+
+std::vector<std::string> make_filters(std::size_t n, double wildcards,
+                                      std::mt19937_64 &rng) {
+  std::uniform_real_distribution<double> coin;
+  std::vector<std::string> filters;
+  filters.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    if (coin(rng) >= wildcards) {
+      filters.push_back(device_topic(i, _METRICS[i % 4]));
+    } else if (coin(rng) >= 0.1) {
+      filters.push_back(device_topic(i, "+"));
+    } else {
+      filters.push_back("site/" + std::to_string(i / _DEVICES_PER_SITE) +
+                        "/#");
+    }
+  }
+  return filters;
+}
+
+std::vector<std::string> make_topics(std::size_t n, std::size_t filters,
+                                     double misses, std::mt19937_64 &rng) {
+  std::uniform_real_distribution<double> coin;
+  std::uniform_int_distribution<std::size_t> device(0, filters - 1);
+  std::vector<std::string> topics;
+  topics.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    auto d = device(rng);
+    if (coin(rng) < misses) {
+      d += filters + _DEVICES_PER_SITE;
+    }
+    topics.push_back(device_topic(d, _METRICS[rng() % 4]));
+  }
+  return topics;
+}
+
+// The loopback broker's matcher: one filter against one topic.
+bool topic_matches(std::string_view filter, std::string_view topic) {
+  while (true) {
+    auto f = filter.substr(0, filter.find('/'));
+    if (f == "#") {
+      return true;
+    }
+    auto t = topic.substr(0, topic.find('/'));
+    if (f != "+" && f != t) {
+      return false;
+    }
+    bool filter_done = f.size() == filter.size();
+    bool topic_done = t.size() == topic.size();
+    if (filter_done || topic_done) {
+      return topic_done && (filter_done || filter.substr(f.size()) == "/#");
+    }
+    filter.remove_prefix(f.size() + 1);
+    topic.remove_prefix(t.size() + 1);
+  }
+}
+
+// Subscribes one client to filters on the broker; returns the time from
+// CONNACK to the last SUBACK.
+double subscribe_all(const loopback_broker &broker,
+                     const topic_router<handler_t> &router,
+                     std::size_t per_packet, std::size_t &packets) {
+  boost::asio::io_context ioc;
+  auto c = MQTT_NS::make_async_client(ioc, broker.host(), broker.port());
+  c->set_client_id("router_bench");
+  c->set_keep_alive_sec(30);
+  c->set_clean_session(true);
+  std::int64_t start = 0;
+  std::int64_t end = 0;
+  std::size_t acked = 0;
+  c->set_connack_handler([&](bool, MQTT_NS::connect_return_code rc) {
+    if (rc == MQTT_NS::connect_return_code::accepted) {
+      start = get_ns();
+      packets = subscribe_routes(*c, router, MQTT_NS::qos::at_most_once,
+                                 per_packet);
+    }
+    return true;
+  });
+  c->set_suback_handler(
+      [&](packet_id_t, std::vector<MQTT_NS::suback_return_code>) {
+        if (++acked == packets) {
+          end = get_ns();
+          c->async_disconnect();
+        }
+        return true;
+      });
+  c->set_error_handler([](MQTT_NS::error_code ec) {
+    spdlog::error("router_bench: {}", ec.message());
+  });
+  c->async_connect();
+  ioc.run_for(std::chrono::seconds(60));
+  if (!end) {
+    throw std::runtime_error("timed out subscribing");
+  }
+  return (end - start) * 1e-6;
+}
+
+step_result run_step(std::size_t n, const bench_options &opts,
+                     const loopback_broker *broker) {
+  step_result r;
+  r.filters = n;
+  std::mt19937_64 rng(n);
+  auto filters = make_filters(n, opts.get("wildcards", 0.1), rng);
+  r.messages = opts.get("messages", std::size_t(1000000));
+  auto topics = make_topics(std::min<std::size_t>(r.messages, 65536), n,
+                            opts.get("misses", 0.1), rng);
+
+  std::uint64_t delivered = 0;
+  handler_t count = [&delivered](std::string_view) { ++delivered; };
+  topic_router<handler_t> router;
+  for (auto &f : filters) {
+    router.add(f, count);
+  }
+  r.distinct = router.filters().size();
+  r.nodes = router.nodes();
+  r.trie_bytes = router.memory_bytes();
+
+  auto allocs_start = allocations();
+  auto start = get_ns();
+  for (std::uint64_t i = 0; i < r.messages; ++i) {
+    const auto &t = topics[i % topics.size()];
+    router.dispatch(t, t);
+  }
+  r.match_ns = double(get_ns() - start) / r.messages;
+  r.allocs = allocations() - allocs_start;
+  r.routes_per_msg = double(delivered) / r.messages;
+
+  // Keep the scan to a few hundred million comparisons.
+  r.linear_messages = std::min<std::uint64_t>(
+      r.messages, std::max<std::uint64_t>(200000000 / n, 1000));
+  std::vector<std::pair<std::string, handler_t>> linear;
+  for (auto &f : filters) {
+    linear.emplace_back(f, count);
+  }
+  start = get_ns();
+  for (std::uint64_t i = 0; i < r.linear_messages; ++i) {
+    const auto &t = topics[i % topics.size()];
+    for (auto &[filter, h] : linear) {
+      if (topic_matches(filter, t)) {
+        h(t);
+      }
+    }
+  }
+  r.linear_ns = double(get_ns() - start) / r.linear_messages;
+
+  if (broker) {
+    try {
+      r.subscribe_ms = subscribe_all(*broker, router,
+                                     opts.get("per-packet", std::size_t(256)),
+                                     r.subscribe_packets);
+    } catch (const std::exception &e) {
+      r.error = e.what();
+    }
+  }
+  return r;
+}
+
+std::string json_result(const step_result &r) {
+  std::ostringstream os;
+  os << "    {\"filters\": " << r.filters << ", \"distinct\": " << r.distinct
+     << ", \"trie_nodes\": " << r.nodes << ", \"trie_bytes\": " << r.trie_bytes
+     << ",\n     \"messages\": " << r.messages
+     << ", \"match_ns_per_msg\": " << r.match_ns
+     << ", \"routes_per_msg\": " << r.routes_per_msg
+     << ", \"allocs_per_msg\": " << double(r.allocs.count) / r.messages
+     << ",\n     \"linear_messages\": " << r.linear_messages
+     << ", \"linear_ns_per_msg\": " << r.linear_ns;
+  if (r.subscribe_packets) {
+    os << ",\n     \"subscribe_packets\": " << r.subscribe_packets
+       << ", \"subscribe_ms\": " << r.subscribe_ms;
+  }
+  if (!r.error.empty()) {
+    os << ", \"error\": \"" << r.error << "\"";
+  }
+  os << "}";
+  return os.str();
+}
+
+int main(int argc, char **argv) {
+  spdlog::set_default_logger(spdlog::stderr_color_mt("router"));
+  bench_options opts(argc, argv);
+  std::vector<std::size_t> counts;
+  std::istringstream is(opts.get("filters", "10,1000,100000"));
+  for (std::string n; std::getline(is, n, ',');) {
+    counts.push_back(std::stoul(n));
+  }
+
+  std::unique_ptr<loopback_broker> broker;
+  if (opts.get("subscribe", false)) {
+    broker = std::make_unique<loopback_broker>();
+  }
+
+  std::vector<std::string> results;
+  for (auto n : counts) {
+    auto r = run_step(n, opts, broker.get());
+    spdlog::info("{:>7} filters: {:.1f} ns/msg trie, {:.1f} ns/msg linear, "
+                 "{:.2f} routes/msg, {} allocs",
+                 n, r.match_ns, r.linear_ns, r.routes_per_msg,
+                 r.allocs.count);
+    if (r.subscribe_packets) {
+      spdlog::info("{:>7} filters: subscribed in {:.1f} ms, {} packets", n,
+                   r.subscribe_ms, r.subscribe_packets);
+    }
+    if (!r.error.empty()) {
+      spdlog::error("{:>7} filters: {}", n, r.error);
+    }
+    results.push_back(json_result(r));
+  }
+
+  std::ostringstream report;
+  report << "{\n  \"workload\": {\"wildcards\": "
+         << opts.get("wildcards", 0.1)
+         << ", \"misses\": " << opts.get("misses", 0.1)
+         << ", \"per_packet\": " << opts.get("per-packet", std::size_t(256))
+         << "},\n  \"results\": [\n";
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    report << results[i] << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  report << "  ]\n}\n";
+
+  auto path = opts.get("report", "");
+  if (path.empty()) {
+    std::cout << report.str();
+  } else {
+    std::ofstream(path) << report.str();
+    spdlog::info("report written to {}", path);
+  }
+  return 0;
+}
@@ -0,0 +1,475 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "bench_options.hpp"
+#include "connect_timing.hpp"
+#include "cpu_usage.hpp"
+#include "latency_histogram.hpp"
+#include "loopback_broker.hpp"
+#include "mqtt_client_cpp.hpp"
+#include "open_loop_publisher.hpp"
+#include "probe_payload.hpp"
+#include "proc_io.hpp"
+#include "shared_payload.hpp"
+#include "spdlog/sinks/stdout_color_sinks.h"
+#include "spdlog/spdlog.h"
+#include "tls_identity.hpp"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Measures what TLS and WebSocket cost an MQTT connection, against the
+// embedded broker listening on all four transports.
+//
+//   mqtt_transport_bench [--transports=tcp,tls,ws,wss] [--handshakes=100]
+//                        [--rate=<msgs/s>] [--payload-size=<bytes>]
+//                        [--warmup=<s>] [--duration=<s>] [--report=<file>]
+//
+// For every transport:
+//   handshake  --handshakes fresh connections, each timed step by step (TCP
+//              connect, TLS handshake, WebSocket upgrade, CONNECT/CONNACK)
+//              by connect_prober.
+//   reconnect  TLS transports only: as many reconnects again, offering the
+//              previous TLS session, next to the full handshakes above, and
+//              the fraction of them the broker resumed.
+//   traffic    an mqtt_cpp publisher and subscriber over the transport,
+//              open-loop at --rate, QoS 0: latency, throughput, CPU, and the
+//              bytes the publishing thread writes per message (TLS records
+//              and WebSocket frames included) against the bare PUBLISH size.
+//
+// The broker's certificate is self-signed, generated at startup, and the
+// only one the clients trust. The report goes to --report, or to stdout;
+// progress is logged to stderr.
+//
+// Needs OpenSSL and Boost.Beast, so it is only built with
+// -DBUILD_TRANSPORT_BENCH=ON (which adds vcpkg's transport-bench feature).
+
+constexpr auto _HOST = "localhost";
+constexpr auto _TOPIC = "bench/transport";
+constexpr std::uint32_t _WARMUP_ID = 0;
+constexpr std::uint32_t _MEASURED_ID = 1;
+
+struct traffic_options {
+  double rate = 1000;
+  std::size_t payload_size = probe_header_size;
+  double warmup = 1;
+  double duration = 5;
+};
+
+struct traffic_result {
+  std::uint64_t sent = 0;
+  std::uint64_t received = 0;
+  latency_histogram latency;
+  double seconds = 0;
+  double cpu_seconds = 0;
+  proc_io pub_io;
+};
+
+struct transport_result {
+  transport t = transport::tcp;
+  std::string error;
+  latency_histogram tcp, tls, ws, mqtt, total;
+  latency_histogram resumed;
+  std::uint64_t resumed_count = 0;
+  traffic_result traffic;
+  std::size_t publish_size = 0;
+};
+
+// Size of a QoS 0 PUBLISH of payload bytes to _TOPIC, before any framing.
+std::size_t mqtt_publish_size(std::size_t payload) {
+  auto remaining = 2 + std::char_traits<char>::length(_TOPIC) + payload;
+  std::size_t length_bytes = 1;
+  for (auto n = remaining / 128; n; n /= 128) {
+    ++length_bytes;
+  }
+  return 1 + length_bytes + remaining;
+}
+
+// Measured probes seen by the subscriber, written on its io thread.
+struct receiver {
+  std::mutex mutex;
+  latency_histogram latency;
+  std::atomic<std::uint64_t> measured{0};
+
+  void on_receive(const char *data, std::size_t size) {
+    auto now = get_ns();
+    probe_header h;
+    if (!decode_probe(data, size, h) || h.publisher_id != _MEASURED_ID) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    latency.record(now - h.send_ns);
+    measured.fetch_add(1, std::memory_order_relaxed);
+  }
+};
+
+// A client of any transport on its own io_context thread.
+template <typename C> struct connection {
+  boost::asio::io_context &ioc;
+  C c;
+  std::thread thread;
+
+  connection(boost::asio::io_context &ioc, C client, const char *id)
+      : ioc(ioc), c(std::move(client)) {
+    c->set_client_id(id);
+    c->set_keep_alive_sec(30);
+    c->set_clean_session(true);
+    c->set_error_handler([id](MQTT_NS::error_code ec) {
+      spdlog::error("{}: {}", id, ec.message());
+    });
+  }
+
+  void run() {
+    boost::asio::post(ioc, [this] { c->async_connect(); });
+    thread = std::thread([this] { ioc.run(); });
+  }
+
+  // I/O counters of the io thread.
+  proc_io io() {
+    std::promise<proc_io> p;
+    auto f = p.get_future();
+    boost::asio::post(ioc, [&p] { p.set_value(thread_io()); });
+    return f.get();
+  }
+
+  ~connection() {
+    if (!thread.joinable()) {
+      return;
+    }
+    boost::asio::post(ioc, [this] { c->async_disconnect(); });
+    // run() returns once the broker has closed the connection.
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ioc.stop();
+    thread.join();
+  }
+};
+
+// Publishes probes on the schedule, on the pub thread, until end_ns.
+template <typename C>
+void publish_until(connection<C> &pub, send_schedule &schedule,
+                   probe_encoder &probe, std::int64_t end_ns) {
+  static const auto topic = static_buffer(_TOPIC);
+  for (auto t = schedule.next_ns(); t < end_ns; t = schedule.next_ns()) {
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+        std::chrono::nanoseconds(t)));
+    boost::asio::post(pub.ioc,
+                      [&pub, p = make_shared_payload(probe.next(t))] {
+                        pub.c->async_publish(topic, p,
+                                             MQTT_NS::qos::at_most_once);
+                      });
+    schedule.advance();
+  }
+}
+
+// make(ioc) returns a client of the transport under test.
+template <typename Make>
+traffic_result run_traffic(Make make, const traffic_options &w) {
+  using client_t = decltype(make(std::declval<boost::asio::io_context &>()));
+  using packet_id_t = typename std::remove_reference_t<
+      decltype(*std::declval<client_t>())>::packet_id_t;
+  traffic_result r;
+  receiver rx;
+  boost::asio::io_context sub_ioc, pub_ioc;
+  connection<client_t> sub(sub_ioc, make(sub_ioc), "transport_sub");
+  connection<client_t> pub(pub_ioc, make(pub_ioc), "transport_pub");
+  std::promise<void> sub_ready, pub_ready;
+  sub.c->set_connack_handler([&](bool, MQTT_NS::connect_return_code rc) {
+    if (rc == MQTT_NS::connect_return_code::accepted) {
+      sub.c->async_subscribe(_TOPIC, MQTT_NS::qos::at_most_once);
+    }
+    return true;
+  });
+  sub.c->set_suback_handler(
+      [&](packet_id_t, std::vector<MQTT_NS::suback_return_code>) {
+        sub_ready.set_value();
+        return true;
+      });
+  sub.c->set_publish_handler(
+      [&rx](MQTT_NS::optional<packet_id_t>, MQTT_NS::publish_options,
+            MQTT_NS::buffer, MQTT_NS::buffer contents) {
+        rx.on_receive(contents.data(), contents.size());
+        return true;
+      });
+  pub.c->set_connack_handler([&](bool, MQTT_NS::connect_return_code rc) {
+    if (rc == MQTT_NS::connect_return_code::accepted) {
+      pub_ready.set_value();
+    }
+    return true;
+  });
+  auto sub_done = sub_ready.get_future();
+  auto pub_done = pub_ready.get_future();
+  sub.run();
+  pub.run();
+  using namespace std::chrono_literals;
+  if (sub_done.wait_for(10s) != std::future_status::ready ||
+      pub_done.wait_for(10s) != std::future_status::ready) {
+    throw std::runtime_error("timed out connecting");
+  }
+
+  send_schedule schedule(w.rate, false);
+  probe_encoder warmup(_WARMUP_ID, w.payload_size);
+  probe_encoder measured(_MEASURED_ID, w.payload_size);
+  schedule.start(get_ns());
+  publish_until(pub, schedule, warmup,
+                get_ns() + static_cast<std::int64_t>(w.warmup * 1e9));
+
+  auto io_start = pub.io();
+  cpu_meter cpu;
+  publish_until(pub, schedule, measured,
+                get_ns() + static_cast<std::int64_t>(w.duration * 1e9));
+  r.sent = measured.sent();
+  auto deadline = std::chrono::steady_clock::now() + 2s;
+  while (rx.measured.load() < r.sent &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(1ms);
+  }
+  r.seconds = cpu.wall_seconds();
+  r.cpu_seconds = cpu.cpu_seconds();
+  r.pub_io = pub.io() - io_start;
+  std::lock_guard<std::mutex> lock(rx.mutex);
+  r.received = rx.measured.load();
+  r.latency = rx.latency;
+  return r;
+}
+
+traffic_result run_traffic(transport t, std::uint16_t port,
+                           const tls_identity &id,
+                           const traffic_options &w) {
+  switch (t) {
+  case transport::tcp:
+    return run_traffic(
+        [&](boost::asio::io_context &ioc) {
+          return MQTT_NS::make_async_client(ioc, _HOST, port);
+        },
+        w);
+  case transport::tls:
+    return run_traffic(
+        [&](boost::asio::io_context &ioc) {
+          auto c = MQTT_NS::make_tls_async_client(ioc, _HOST, port);
+          id.trust(c->get_ssl_context());
+          return c;
+        },
+        w);
+  case transport::ws:
+    return run_traffic(
+        [&](boost::asio::io_context &ioc) {
+          return MQTT_NS::make_async_client_ws(ioc, _HOST, port);
+        },
+        w);
+  case transport::wss:
+    return run_traffic(
+        [&](boost::asio::io_context &ioc) {
+          auto c = MQTT_NS::make_tls_async_client_ws(ioc, _HOST, port);
+          id.trust(c->get_ssl_context());
+          return c;
+        },
+        w);
+  }
+  throw std::logic_error("unknown transport");
+}
+
+transport_result run_transport(transport t, std::uint16_t port,
+                               const tls_identity &id,
+                               boost::asio::ssl::context &client_tls,
+                               std::size_t handshakes,
+                               const traffic_options &w) {
+  transport_result r;
+  r.t = t;
+  r.publish_size = mqtt_publish_size(w.payload_size);
+  try {
+    connect_prober prober(t, _HOST, port, &client_tls);
+    // The first connection pays for one-off setup (resolver, TLS context).
+    prober.connect(false);
+    for (std::size_t i = 0; i < handshakes; ++i) {
+      auto p = prober.connect(false);
+      r.tcp.record(p.tcp_ns);
+      r.tls.record(p.tls_ns);
+      r.ws.record(p.ws_ns);
+      r.mqtt.record(p.mqtt_ns);
+      r.total.record(p.total_ns);
+    }
+    if (uses_tls(t)) {
+      for (std::size_t i = 0; i < handshakes; ++i) {
+        auto p = prober.connect(true);
+        r.resumed.record(p.total_ns);
+        r.resumed_count += p.resumed;
+      }
+    }
+    r.traffic = run_traffic(t, port, id, w);
+  } catch (const std::exception &e) {
+    r.error = e.what();
+  }
+  return r;
+}
+
+std::string json_string(const std::string &s) {
+  std::string out = "\"";
+  for (auto ch : s) {
+    if (ch == '"' || ch == '\\') {
+      out += '\\';
+      out += ch;
+    } else if (static_cast<unsigned char>(ch) < 0x20) {
+      out += ' ';
+    } else {
+      out += ch;
+    }
+  }
+  return out + "\"";
+}
+
+// Latency summary in microseconds.
+std::string json_latency(const latency_histogram &h) {
+  std::ostringstream os;
+  os << "{\"count\": " << h.count() << ", \"min\": " << h.min() * 1e-3
+     << ", \"mean\": " << h.mean() * 1e-3
+     << ", \"p50\": " << h.percentile(0.5) * 1e-3
+     << ", \"p90\": " << h.percentile(0.9) * 1e-3
+     << ", \"p99\": " << h.percentile(0.99) * 1e-3
+     << ", \"p999\": " << h.percentile(0.999) * 1e-3
+     << ", \"max\": " << h.max() * 1e-3 << "}";
+  return os.str();
+}
+
+std::string json_result(const transport_result &r) {
+  std::ostringstream os;
+  os << "    {\"transport\": \"" << to_string(r.t) << "\"";
+  if (!r.error.empty()) {
+    os << ", \"error\": " << json_string(r.error) << "}";
+    return os.str();
+  }
+  os << ",\n     \"handshake_us\": {\"tcp\": " << json_latency(r.tcp);
+  if (uses_tls(r.t)) {
+    os << ",\n       \"tls\": " << json_latency(r.tls);
+  }
+  if (uses_ws(r.t)) {
+    os << ",\n       \"ws\": " << json_latency(r.ws);
+  }
+  os << ",\n       \"mqtt\": " << json_latency(r.mqtt)
+     << ",\n       \"total\": " << json_latency(r.total) << "}";
+  if (uses_tls(r.t)) {
+    os << ",\n     \"reconnect_us\": {\"full\": " << json_latency(r.total)
+       << ",\n       \"resumed\": " << json_latency(r.resumed)
+       << ",\n       \"resumed_fraction\": "
+       << (r.resumed.count() ? double(r.resumed_count) / r.resumed.count()
+                             : 0)
+       << "}";
+  }
+  auto &t = r.traffic;
+  auto msgs = static_cast<double>(t.sent);
+  auto wire = msgs ? t.pub_io.wchar / msgs : 0;
+  os << ",\n     \"traffic\": {\"sent\": " << t.sent
+     << ", \"received\": " << t.received
+     << ", \"lost\": " << (t.sent > t.received ? t.sent - t.received : 0)
+     << ", \"throughput_msgs_per_s\": "
+     << (t.seconds ? t.received / t.seconds : 0)
+     << ",\n       \"latency_us\": " << json_latency(t.latency)
+     << ",\n       \"publish_bytes\": " << r.publish_size
+     << ", \"wire_bytes_per_msg\": " << wire
+     << ", \"overhead_bytes_per_msg\": "
+     << (msgs ? wire - static_cast<double>(r.publish_size) : 0)
+     << ", \"write_syscalls_per_msg\": "
+     << (msgs ? t.pub_io.syscw / msgs : 0)
+     << ", \"cpu_us_per_msg\": " << (msgs ? t.cpu_seconds * 1e6 / msgs : 0)
+     << "}}";
+  return os.str();
+}
+
+int main(int argc, char **argv) {
+  spdlog::set_default_logger(spdlog::stderr_color_mt("transport"));
+  bench_options opts(argc, argv);
+  traffic_options w;
+  w.rate = opts.get("rate", w.rate);
+  w.payload_size = opts.get("payload-size", w.payload_size);
+  w.warmup = opts.get("warmup", w.warmup);
+  w.duration = opts.get("duration", w.duration);
+  auto handshakes = opts.get("handshakes", std::size_t(100));
+
+  std::vector<transport> transports;
+  std::istringstream is(opts.get("transports", "tcp,tls,ws,wss"));
+  for (std::string name; std::getline(is, name, ',');) {
+    if (auto t = parse_transport(name)) {
+      transports.push_back(*t);
+    } else {
+      spdlog::error("unknown transport {}", name);
+      return 1;
+    }
+  }
+
+  auto id = tls_identity::generate();
+  boost::asio::ssl::context client_tls(boost::asio::ssl::context::tls_client);
+  id.trust(client_tls);
+  loopback_broker broker;
+  std::map<transport, std::uint16_t> ports;
+  for (auto t : transports) {
+    if (ports.count(t)) {
+      continue;
+    }
+    switch (t) {
+    case transport::tcp:
+      ports[t] = broker.port();
+      break;
+    case transport::tls:
+      ports[t] = broker.listen_tls(id.cert_pem, id.key_pem);
+      break;
+    case transport::ws:
+      ports[t] = broker.listen_ws();
+      break;
+    case transport::wss:
+      ports[t] = broker.listen_wss(id.cert_pem, id.key_pem);
+      break;
+    }
+  }
+
+  std::vector<std::string> results;
+  for (auto t : transports) {
+    auto port = ports[t];
+    spdlog::info("{}: {} handshakes, then {} msgs/s for {} s on port {}",
+                 to_string(t), handshakes, w.rate, w.duration, port);
+    auto r = run_transport(t, port, id, client_tls, handshakes, w);
+    if (!r.error.empty()) {
+      spdlog::error("{}: {}", to_string(t), r.error);
+    } else {
+      spdlog::info("{}: handshake {}", to_string(t), to_string(r.total));
+      if (uses_tls(t)) {
+        spdlog::info("{}: resumed {} ({} of {})", to_string(t),
+                     to_string(r.resumed), r.resumed_count,
+                     r.resumed.count());
+      }
+      spdlog::info("{}: latency {}", to_string(t),
+                   to_string(r.traffic.latency));
+    }
+    results.push_back(json_result(r));
+  }
+
+  std::ostringstream report;
+  report << "{\n  \"workload\": {\"handshakes\": " << handshakes
+         << ", \"rate\": " << w.rate
+         << ", \"payload_size\": " << w.payload_size
+         << ", \"warmup_s\": " << w.warmup
+         << ", \"duration_s\": " << w.duration << "},\n  \"results\": [\n";
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    report << results[i] << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  report << "  ]\n}\n";
+
+  auto path = opts.get("report", "");
+  if (path.empty()) {
+    std::cout << report.str();
+  } else {
+    std::ofstream(path) << report.str();
+    spdlog::info("report written to {}", path);
+  }
+  return 0;
+}
@@ -0,0 +1,88 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "latency_histogram.hpp"
+#include "probe_payload.hpp"
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+// Absolute send timeline for an open-loop publisher.
+//
+// Send times are derived from the start of the run rather than from the
+// previous send, so handler cost and stalls never lower the offered load:
+// a late publisher is simply behind its timeline, and stamping probes with
+// the intended time charges that delay to the measured latency instead of
+// hiding it (coordinated omission).
+class send_schedule {
+public:
+  send_schedule(double rate_per_sec, bool poisson,
+                std::uint64_t seed = std::random_device{}())
+      : period_ns_(1e9 / rate_per_sec), poisson_(poisson), rng_(seed),
+        interval_(rate_per_sec * 1e-9) {}
+
+  void start(std::int64_t now_ns) {
+    start_ns_ = now_ns;
+    index_ = 0;
+    offset_ns_ = poisson_ ? interval_(rng_) : 0;
+  }
+
+  // Intended time of the next send, steady clock ns.
+  std::int64_t next_ns() const {
+    auto offset = poisson_ ? offset_ns_ : std::floor(index_ * period_ns_);
+    return start_ns_ + static_cast<std::int64_t>(offset);
+  }
+
+  void advance() {
+    ++index_;
+    if (poisson_) {
+      offset_ns_ += interval_(rng_);
+    }
+  }
+
+private:
+  double period_ns_;
+  bool poisson_;
+  std::mt19937_64 rng_;
+  // Exponential inter-arrival times in ns for Poisson arrivals.
+  std::exponential_distribution<double> interval_;
+  std::int64_t start_ns_ = 0;
+  std::uint64_t index_ = 0;
+  double offset_ns_ = 0;
+};
+
+// Upper bound of sends per timer wake-up when the publisher is behind, so a
+// long backlog does not starve the other handlers on the io_context.
+constexpr int open_loop_max_burst = 1024;
+
+// Publishes on the schedule's timeline until the timer is cancelled.
+// publish(intended_ns) is invoked once per intended send; lag records how far
+// behind its intended time each send actually happened.
+template <typename Publish>
+void publish_open_loop(boost::asio::steady_timer &timer,
+                       send_schedule &schedule, latency_histogram &lag,
+                       Publish publish) {
+  timer.expires_at(std::chrono::steady_clock::time_point(
+      std::chrono::nanoseconds(schedule.next_ns())));
+  timer.async_wait([&timer, &schedule, &lag,
+                    publish](boost::system::error_code const &error) mutable {
+    if (error == boost::asio::error::operation_aborted) {
+      return;
+    }
+    auto now = get_ns();
+    for (int i = 0; i < open_loop_max_burst && schedule.next_ns() <= now; ++i) {
+      auto intended = schedule.next_ns();
+      lag.record(get_ns() - intended);
+      publish(intended);
+      schedule.advance();
+    }
+    publish_open_loop(timer, schedule, lag, std::move(publish));
+  });
+}
@@ -0,0 +1,274 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+
+// Append-only ring of outbound messages in a memory-mapped file.
+//
+// A message is appended before it is sent and stays in the journal until it
+// is acknowledged (PUBACK/PUBCOMP, or the socket write for QoS 0), so
+// whatever was published while disconnected, or was still unacknowledged
+// when the connection or the process died, can be replayed after the next
+// connect. Appending is a bounds check and a memcpy into the mapping; nothing
+// is flushed on the hot path. sync() writes dirty pages back with msync and
+// is meant to be called in batches, e.g. from a timer. A process crash loses
+// nothing, since the pages live in the page cache; after an OS crash the
+// journal is recovered up to the last record whose checksum is intact.
+//
+// Records are 8-byte aligned and never wrap: one that does not fit before
+// the end of the ring is preceded by a padding record. The head only moves
+// past acknowledged records, so a slow ack holds back the space behind it;
+// append() fails rather than overwrite unacknowledged messages.
+class outbound_journal {
+public:
+  // Identifies a record for ack().
+  struct entry {
+    std::uint64_t seq;
+    std::uint64_t pos;
+  };
+
+  struct stats {
+    std::uint64_t appended = 0;
+    std::uint64_t acked = 0;
+    std::uint64_t rejected = 0;  // append() failed: journal full
+    std::uint64_t recovered = 0; // pending records found when opening
+  };
+
+  outbound_journal(const std::string &path, std::size_t capacity) {
+    capacity = (capacity + 7) & ~std::size_t(7);
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0) {
+      throw std::system_error(errno, std::generic_category(), path);
+    }
+    struct stat st {};
+    ::fstat(fd_, &st);
+    bool fresh = static_cast<std::size_t>(st.st_size) < header_size;
+    if (!fresh) {
+      // An existing journal keeps its own capacity.
+      header h;
+      if (::pread(fd_, &h, sizeof(h), 0) == sizeof(h) && h.magic == magic &&
+          h.version == version) {
+        capacity = h.capacity;
+      } else {
+        fresh = true;
+      }
+    }
+    size_ = header_size + capacity;
+    if (::ftruncate(fd_, size_) != 0) {
+      auto e = errno;
+      ::close(fd_);
+      throw std::system_error(e, std::generic_category(), path);
+    }
+    auto p = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_,
+                    0);
+    if (p == MAP_FAILED) {
+      auto e = errno;
+      ::close(fd_);
+      throw std::system_error(e, std::generic_category(), path);
+    }
+    base_ = static_cast<char *>(p);
+    data_ = base_ + header_size;
+    header_ = reinterpret_cast<header *>(base_);
+    if (fresh) {
+      *header_ = header{magic, version, capacity, 0, 0, 0};
+    } else {
+      recover();
+    }
+  }
+
+  ~outbound_journal() {
+    sync();
+    ::munmap(base_, size_);
+    ::close(fd_);
+  }
+
+  outbound_journal(const outbound_journal &) = delete;
+  outbound_journal &operator=(const outbound_journal &) = delete;
+
+  std::optional<entry> append(std::string_view topic, std::string_view payload,
+                              std::uint8_t qos) {
+    auto size = align(record_size + topic.size() + payload.size());
+    auto cap = header_->capacity;
+    auto tail = header_->tail;
+    auto room = cap - tail % cap;
+    auto pad = room < size ? room : 0;
+    if (size > cap || tail + pad + size - header_->head > cap) {
+      ++stats_.rejected;
+      return std::nullopt;
+    }
+    if (pad) {
+      record r{};
+      r.size = static_cast<std::uint32_t>(pad);
+      r.state = state_pad;
+      std::memcpy(data_ + tail % cap, &r, 8);
+      tail += pad;
+    }
+    auto p = data_ + tail % cap;
+    record r{static_cast<std::uint32_t>(size),
+             state_pending,
+             qos,
+             static_cast<std::uint16_t>(topic.size()),
+             static_cast<std::uint32_t>(payload.size()),
+             0,
+             header_->next_seq};
+    std::memcpy(p + record_size, topic.data(), topic.size());
+    std::memcpy(p + record_size + topic.size(), payload.data(), payload.size());
+    r.checksum = checksum(r, p + record_size);
+    std::memcpy(p, &r, record_size);
+    entry e{r.seq, tail};
+    header_->tail = tail + size;
+    ++header_->next_seq;
+    ++stats_.appended;
+    return e;
+  }
+
+  // Marks a record acknowledged and frees the space in front of the oldest
+  // pending record. Stale entries (already acked or overwritten) are ignored.
+  void ack(const entry &e) {
+    if (e.pos < header_->head || e.pos >= header_->tail) {
+      return;
+    }
+    auto r = at(e.pos);
+    if (r->seq != e.seq || r->state != state_pending) {
+      return;
+    }
+    r->state = state_acked;
+    ++stats_.acked;
+    auto head = header_->head;
+    while (head < header_->tail && at(head)->state != state_pending) {
+      head += at(head)->size;
+    }
+    header_->head = head;
+  }
+
+  // Calls f(entry, topic, payload, qos) for every pending record, oldest
+  // first.
+  template <typename F> std::size_t replay(F f) const {
+    std::size_t n = 0;
+    for (auto pos = header_->head; pos < header_->tail; pos += at(pos)->size) {
+      auto r = at(pos);
+      if (r->state != state_pending) {
+        continue;
+      }
+      auto body = reinterpret_cast<const char *>(r) + record_size;
+      f(entry{r->seq, pos}, std::string_view(body, r->topic_size),
+        std::string_view(body + r->topic_size, r->payload_size), r->qos);
+      ++n;
+    }
+    return n;
+  }
+
+  // Writes dirty pages back to the file; blocks until they are on disk.
+  void sync() { ::msync(base_, size_, MS_SYNC); }
+
+  std::size_t capacity() const { return header_->capacity; }
+  std::size_t used() const { return header_->tail - header_->head; }
+  const stats &get() const { return stats_; }
+
+private:
+  static constexpr std::uint32_t magic = 0x4e524a4f; // "OJRN"
+  static constexpr std::uint32_t version = 1;
+  static constexpr std::size_t header_size = 4096;
+  static constexpr std::uint8_t state_pending = 1;
+  static constexpr std::uint8_t state_acked = 2;
+  static constexpr std::uint8_t state_pad = 3;
+
+  // Positions are logical byte offsets that only grow; the ring offset is
+  // pos % capacity.
+  struct header {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t capacity;
+    std::uint64_t head;
+    std::uint64_t tail;
+    std::uint64_t next_seq;
+  };
+
+  // Padding records only use the first 8 bytes.
+  struct record {
+    std::uint32_t size;
+    std::uint8_t state;
+    std::uint8_t qos;
+    std::uint16_t topic_size;
+    std::uint32_t payload_size;
+    std::uint32_t checksum;
+    std::uint64_t seq;
+  };
+  static constexpr std::size_t record_size = sizeof(record);
+  static_assert(record_size == 24);
+
+  static std::size_t align(std::size_t n) { return (n + 7) & ~std::size_t(7); }
+
+  record *at(std::uint64_t pos) const {
+    return reinterpret_cast<record *>(data_ + pos % header_->capacity);
+  }
+
+  // FNV-1a over the immutable part of a record; state is left out since ack()
+  // rewrites it in place.
+  static std::uint32_t checksum(const record &r, const char *body) {
+    std::uint32_t h = 2166136261u;
+    auto mix = [&h](const void *p, std::size_t n) {
+      auto b = static_cast<const unsigned char *>(p);
+      for (std::size_t i = 0; i < n; ++i) {
+        h = (h ^ b[i]) * 16777619u;
+      }
+    };
+    mix(&r.seq, sizeof(r.seq));
+    mix(&r.qos, sizeof(r.qos));
+    mix(body, std::size_t(r.topic_size) + r.payload_size);
+    return h;
+  }
+
+  // Keeps the records from the head up to the first torn or corrupt one.
+  void recover() {
+    auto cap = header_->capacity;
+    auto pos = header_->head;
+    auto next_seq = header_->next_seq;
+    while (pos < header_->tail) {
+      auto r = at(pos);
+      auto room = cap - pos % cap;
+      if (r->size < 8 || r->size > room || r->size % 8) {
+        break;
+      }
+      if (r->state != state_pad) {
+        if (r->size < record_size ||
+            record_size + r->topic_size + r->payload_size > r->size ||
+            checksum(*r, reinterpret_cast<const char *>(r) + record_size) !=
+                r->checksum) {
+          break;
+        }
+        if (r->state == state_pending) {
+          ++stats_.recovered;
+        }
+        next_seq = std::max(next_seq, r->seq + 1);
+      }
+      pos += r->size;
+    }
+    header_->tail = pos;
+    header_->next_seq = next_seq;
+  }
+
+  int fd_ = -1;
+  std::size_t size_ = 0;
+  char *base_ = nullptr;
+  char *data_ = nullptr;
+  header *header_ = nullptr;
+  stats stats_;
+};
@@ -1,3 +1,7 @@
+#include "bench_options.hpp"
+#include "gateway.hpp"
+#include "loopback_broker.hpp"
+#include "metrics.hpp"
 #include "mqtt/client.h"
 #include <cctype>
 #include <chrono>
@@ -12,7 +16,37 @@ using namespace std::chrono;
 using namespace std::chrono_literals;
 
 int main(int argc, char *argv[]) {
-  const string SERVER_ADDRESS{"tcp://localhost:1883"};
+  bench_options opts(argc, argv);
+  string SERVER_ADDRESS{"tcp://localhost:1883"};
+  unique_ptr<loopback_broker> broker;
+  if (opts.get("embedded-broker", false)) {
+    broker = make_unique<loopback_broker>();
+    SERVER_ADDRESS = string("tcp://") + broker->host() + ":" +
+                     to_string(broker->port());
+    cout << "Embedded broker on " << SERVER_ADDRESS << endl;
+  }
+  // With --gateway the round trip goes through an in-process echo gateway,
+  // hello_delay_tx to hello_delay_rx, instead of straight back from the
+  // broker.
+  unique_ptr<gateway> echo;
+  string TX_TOPIC{"test_echo"};
+  string RX_TOPIC{"test_echo"};
+  if (opts.get("gateway", false)) {
+    gateway_config config;
+    if (broker) {
+      config.broker.host = broker->host();
+      config.broker.port = broker->port();
+    }
+    echo = make_unique<gateway>(config);
+    TX_TOPIC = config.routes.front().filter;
+    RX_TOPIC = config.routes.front().out_topic;
+    cout << "Echo gateway " << TX_TOPIC << " -> " << RX_TOPIC << endl;
+  }
+  metrics_exporter exporter(metrics_options::from_options(opts));
+  if (exporter.port()) {
+    cout << "Metrics on 127.0.0.1:" << exporter.port() << endl;
+  }
+  auto &metrics = client_metrics();
   mqtt::client sub(SERVER_ADDRESS, "");
   mqtt::client pub(SERVER_ADDRESS, "");
 
@@ -22,7 +56,7 @@ int main(int argc, char *argv[]) {
                       .clean_session(true)
                       .finalize();
 
-  const vector<string> TOPICS{"test_echo"};
+  const vector<string> TOPICS{RX_TOPIC};
   const vector<int> QOS{0};
   try {
     cout << "Connecting to the MQTT server..." << flush;
@@ -42,9 +76,11 @@ int main(int argc, char *argv[]) {
     for (int i = 0; i < 100; ++i) {
       auto start = chrono::steady_clock::now();
       {
-        auto msg = mqtt::make_message(TOPICS[0], "hello delay");
+        auto msg = mqtt::make_message(TX_TOPIC, "hello delay");
         msg->set_qos(0);
         pub.publish(msg);
+        metrics.msgs_sent.add();
+        metrics.bytes_sent.add(msg->get_payload().size());
         printf("time %lld,topic published: %d\n",
                chrono::steady_clock::now().time_since_epoch().count(), i);
       }
@@ -53,6 +89,10 @@ int main(int argc, char *argv[]) {
         printf("time %lld,topic received: %d\n",
                chrono::steady_clock::now().time_since_epoch().count(), i);
         auto end = chrono::steady_clock::now();
+        metrics.msgs_received.add();
+        metrics.bytes_received.add(msg->get_payload().size());
+        metrics.latency.record(
+            chrono::duration_cast<chrono::nanoseconds>(end - start).count());
         printf("time elapsed %lld ms : %d\n",
                chrono::duration_cast<chrono::milliseconds>(end - start).count(),
                i);
@@ -64,6 +104,12 @@ int main(int argc, char *argv[]) {
     cout << "\nDisconnecting from the MQTT server..." << flush;
     sub.disconnect();
     cout << "OK" << endl;
+    if (broker) {
+      cout << "broker forward " << broker->forward_latency() << endl;
+    }
+    if (echo) {
+      cout << "gateway " << echo->stats() << endl;
+    }
   } catch (const mqtt::exception &exc) {
     cerr << exc.what() << endl;
   }
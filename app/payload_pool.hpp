@@ -0,0 +1,145 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "mqtt_client_cpp.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Recycling storage for outbound payloads, owned by one producing thread.
+//
+// Blocks are carved out of slabs allocated blocks_per_slab at a time, and
+// every block gets its reference count once, when its slab is created.
+// make() hands a block out as an MQTT_NS::buffer that shares that count
+// (shared_ptr aliasing), so no allocation happens per message. A block is
+// free again as soon as the last buffer referring to it is gone, on
+// whichever thread that happens (typically the client's, after the socket
+// write); make() finds it by its count dropping back to the pool's own
+// reference. A new slab is only added when every block is still in flight,
+// so once the pool has grown to the number of messages in flight, ingest
+// does not allocate. Payloads larger than block_size go to the heap.
+//
+// Slab memory is kept alive by the blocks themselves, so buffers may outlive
+// the pool.
+class payload_pool {
+public:
+  explicit payload_pool(std::size_t block_size,
+                        std::size_t blocks_per_slab = 1024)
+      : block_size_(block_size), blocks_per_slab_(blocks_per_slab) {}
+
+  payload_pool(const payload_pool &) = delete;
+  payload_pool &operator=(const payload_pool &) = delete;
+
+  // A buffer of size bytes, filled in by write(char *).
+  template <typename F> MQTT_NS::buffer make(std::size_t size, F &&write) {
+    if (size > block_size_) {
+      ++oversized_;
+      std::shared_ptr<char[]> p(new char[size]);
+      write(p.get());
+      MQTT_NS::string_view view(p.get(), size);
+      return MQTT_NS::buffer(view, std::move(p));
+    }
+    auto &owner = blocks_[acquire()];
+    write(owner.get());
+    MQTT_NS::string_view view(owner.get(), size);
+    return MQTT_NS::buffer(view, std::shared_ptr<char[]>(owner, owner.get()));
+  }
+
+  std::size_t block_size() const { return block_size_; }
+  std::size_t blocks() const { return blocks_.size(); }
+  std::uint64_t slabs() const { return slabs_; }
+  std::uint64_t oversized() const { return oversized_; }
+
+private:
+  // Index of a block nobody else refers to. Blocks tend to come back in the
+  // order they went out, so the search starts after the last one handed out.
+  std::size_t acquire() {
+    for (std::size_t i = 0; i < blocks_.size(); ++i) {
+      auto k = next_;
+      next_ = next_ + 1 == blocks_.size() ? 0 : next_ + 1;
+      if (blocks_[k].use_count() == 1) {
+        // Pairs with the release of the last buffer, so the block's previous
+        // readers are done before it is written again.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return k;
+      }
+    }
+    add_slab();
+    auto k = blocks_.size() - blocks_per_slab_;
+    next_ = (k + 1) % blocks_.size();
+    return k;
+  }
+
+  void add_slab() {
+    std::shared_ptr<char[]> slab(new char[block_size_ * blocks_per_slab_]);
+    blocks_.reserve(blocks_.size() + blocks_per_slab_);
+    for (std::size_t i = 0; i < blocks_per_slab_; ++i) {
+      blocks_.emplace_back(slab.get() + i * block_size_,
+                           [slab](char *) { /* slab freed with last block */ });
+    }
+    ++slabs_;
+  }
+
+  std::size_t block_size_;
+  std::size_t blocks_per_slab_;
+  std::vector<std::shared_ptr<char>> blocks_;
+  std::size_t next_ = 0;
+  std::uint64_t slabs_ = 0;
+  std::uint64_t oversized_ = 0;
+};
+
+// Topic names interned to small ids, so queued messages carry a 2-byte id
+// instead of a string. Names are registered up front (intern() takes a
+// lock); looking an id up is a plain array read and returns a buffer that
+// refers to the table's copy of the name, so publishing it copies nothing.
+// The table must outlive the publishes of its topics.
+class topic_table {
+public:
+  using id_t = std::uint16_t;
+
+  explicit topic_table(std::size_t capacity = 1024)
+      : names_(new std::string[capacity]),
+        buffers_(new MQTT_NS::buffer[capacity]), capacity_(capacity) {}
+
+  // The id of name, registering it if it is new. Throws when full.
+  id_t intern(std::string_view name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto n = size_.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < n; ++i) {
+      if (names_[i] == name) {
+        return static_cast<id_t>(i);
+      }
+    }
+    if (n == capacity_ || n > std::size_t(UINT16_MAX)) {
+      throw std::length_error("topic_table full");
+    }
+    names_[n] = std::string(name);
+    buffers_[n] = MQTT_NS::buffer(
+        MQTT_NS::string_view(names_[n].data(), names_[n].size()));
+    size_.store(n + 1, std::memory_order_release);
+    return static_cast<id_t>(n);
+  }
+
+  // id must come from intern().
+  const MQTT_NS::buffer &buffer(id_t id) const { return buffers_[id]; }
+  const std::string &name(id_t id) const { return names_[id]; }
+  std::size_t size() const { return size_.load(std::memory_order_acquire); }
+
+private:
+  std::mutex mutex_;
+  std::unique_ptr<std::string[]> names_;
+  std::unique_ptr<MQTT_NS::buffer[]> buffers_;
+  std::size_t capacity_;
+  std::atomic<std::size_t> size_{0};
+};
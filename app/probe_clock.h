@@ -0,0 +1,251 @@
+/*
+ * Copyright ips_gateway contributors 2026
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#ifndef PROBE_CLOCK_H
+#define PROBE_CLOCK_H
+
+/*
+ * Clocks and wire formats shared by the C and C++ latency probes.
+ *
+ * Every probe carries the clock its send stamp was taken on, so a receiver
+ * always subtracts readings of the same clock:
+ *
+ *   monotonic  Never steps. System-wide on Linux, so it also works between
+ *              processes on one host. The default, and what the C++ probes
+ *              use within a process.
+ *   realtime   Nanoseconds since the Unix epoch. Comparable across hosts only
+ *              as far as their clocks agree; measure how far that is with the
+ *              calibration exchange below.
+ *
+ * Probe layout (little endian, 24 bytes), optionally followed by padding:
+ *   0  u32 magic "MQP" + clock letter ('R' monotonic, 'W' realtime)
+ *   4  u32 publisher id
+ *   8  u64 sequence number
+ *   16 i64 send timestamp, nanoseconds on that clock
+ *
+ * Clock offset calibration, for a publisher and subscriber in separate
+ * processes (NTP style): the requester stamps t1 and sends a sync message,
+ * the responder stamps t2 on receipt and t3 just before echoing it back, and
+ * the requester stamps t4 when the echo arrives. Then
+ *
+ *   offset = ((t2 - t1) + (t3 - t4)) / 2    responder clock - requester clock
+ *   rtt    = (t4 - t1) - (t3 - t2)
+ *
+ * The offset is exact when both legs take equally long, and off by at most
+ * rtt / 2 otherwise, so the estimator keeps the sample with the smallest rtt.
+ * Sync layout (little endian, 32 bytes):
+ *   0  u32 magic "MQS" + clock letter
+ *   4  u32 requester id
+ *   8  i64 t1, 16 i64 t2, 24 i64 t3
+ *
+ * In C, include this header before any system header (or build with
+ * _DEFAULT_SOURCE defined): clock_gettime() is not declared under a strict
+ * -std=c11 otherwise. _POSIX_C_SOURCE alone would do for that, but would
+ * hide usleep(), which the C clients call as well.
+ */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum probe_clock_id {
+  PROBE_CLOCK_MONOTONIC = 0,
+  PROBE_CLOCK_REALTIME = 1
+} probe_clock_id;
+
+typedef struct probe_header {
+  uint32_t publisher_id;
+  uint64_t seq;
+  int64_t send_ns;
+  probe_clock_id clock;
+} probe_header;
+
+typedef struct probe_sync_msg {
+  uint32_t requester_id;
+  probe_clock_id clock;
+  int64_t t1;
+  int64_t t2;
+  int64_t t3;
+} probe_sync_msg;
+
+/* Best sample so far; offset_ns maps the requester's clock onto the
+ * responder's (responder = requester + offset_ns). */
+typedef struct probe_offset_estimator {
+  int64_t offset_ns;
+  int64_t rtt_ns;
+  uint32_t samples;
+} probe_offset_estimator;
+
+#define PROBE_HEADER_SIZE 24
+#define PROBE_SYNC_SIZE 32
+
+static inline int64_t probe_monotonic_ns(void) {
+#if defined(_WIN32)
+  static LARGE_INTEGER freq;
+  LARGE_INTEGER c;
+  if (freq.QuadPart == 0) {
+    QueryPerformanceFrequency(&freq);
+  }
+  QueryPerformanceCounter(&c);
+  return c.QuadPart / freq.QuadPart * 1000000000 +
+         c.QuadPart % freq.QuadPart * 1000000000 / freq.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+static inline int64_t probe_realtime_ns(void) {
+#if defined(_WIN32)
+  /* 100 ns ticks since 1601-01-01. */
+  FILETIME ft;
+  int64_t t;
+  GetSystemTimePreciseAsFileTime(&ft);
+  t = (int64_t)(((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime);
+  return (t - 116444736000000000LL) * 100;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+static inline int64_t probe_now_ns(probe_clock_id clock) {
+  return clock == PROBE_CLOCK_REALTIME ? probe_realtime_ns()
+                                       : probe_monotonic_ns();
+}
+
+static inline void probe_store_le(char *p, uint64_t v, size_t n) {
+  size_t i;
+  for (i = 0; i < n; ++i) {
+    p[i] = (char)(v >> (8 * i));
+  }
+}
+
+static inline uint64_t probe_load_le(const char *p, size_t n) {
+  uint64_t v = 0;
+  size_t i;
+  for (i = 0; i < n; ++i) {
+    v |= (uint64_t)(unsigned char)p[i] << (8 * i);
+  }
+  return v;
+}
+
+/* "MQ" + kind + clock letter, as a little-endian u32. */
+static inline uint32_t probe_magic_of(char kind, probe_clock_id clock) {
+  uint32_t letter = clock == PROBE_CLOCK_REALTIME ? 'W' : 'R';
+  return 0x514du | (uint32_t)(unsigned char)kind << 16 | letter << 24;
+}
+
+/* The clock named by magic for the given kind; -1 if it is not one. */
+static inline int probe_clock_of(uint32_t magic, char kind) {
+  if (magic == probe_magic_of(kind, PROBE_CLOCK_MONOTONIC)) {
+    return PROBE_CLOCK_MONOTONIC;
+  }
+  if (magic == probe_magic_of(kind, PROBE_CLOCK_REALTIME)) {
+    return PROBE_CLOCK_REALTIME;
+  }
+  return -1;
+}
+
+/* Writes the header into out[0, PROBE_HEADER_SIZE). out must be at least that
+ * large; bytes after the header are left untouched. */
+static inline void probe_encode(char *out, const probe_header *h) {
+  probe_store_le(out, probe_magic_of('P', h->clock), 4);
+  probe_store_le(out + 4, h->publisher_id, 4);
+  probe_store_le(out + 8, h->seq, 8);
+  probe_store_le(out + 16, (uint64_t)h->send_ns, 8);
+}
+
+/* Returns 0 if the payload is too short or does not carry a probe magic. */
+static inline int probe_decode(const char *data, size_t size,
+                               probe_header *h) {
+  int clock;
+  if (size < PROBE_HEADER_SIZE ||
+      (clock = probe_clock_of((uint32_t)probe_load_le(data, 4), 'P')) < 0) {
+    return 0;
+  }
+  h->clock = (probe_clock_id)clock;
+  h->publisher_id = (uint32_t)probe_load_le(data + 4, 4);
+  h->seq = probe_load_le(data + 8, 8);
+  h->send_ns = (int64_t)probe_load_le(data + 16, 8);
+  return 1;
+}
+
+/* Time since h was sent, read on the clock it was stamped with. offset_ns
+ * comes from a calibration against the sender (0 on the same host). */
+static inline int64_t probe_latency_ns(const probe_header *h,
+                                       int64_t offset_ns) {
+  return probe_now_ns(h->clock) + offset_ns - h->send_ns;
+}
+
+static inline void probe_sync_encode(char *out, const probe_sync_msg *m) {
+  probe_store_le(out, probe_magic_of('S', m->clock), 4);
+  probe_store_le(out + 4, m->requester_id, 4);
+  probe_store_le(out + 8, (uint64_t)m->t1, 8);
+  probe_store_le(out + 16, (uint64_t)m->t2, 8);
+  probe_store_le(out + 24, (uint64_t)m->t3, 8);
+}
+
+static inline int probe_sync_decode(const char *data, size_t size,
+                                    probe_sync_msg *m) {
+  int clock;
+  if (size < PROBE_SYNC_SIZE ||
+      (clock = probe_clock_of((uint32_t)probe_load_le(data, 4), 'S')) < 0) {
+    return 0;
+  }
+  m->clock = (probe_clock_id)clock;
+  m->requester_id = (uint32_t)probe_load_le(data + 4, 4);
+  m->t1 = (int64_t)probe_load_le(data + 8, 8);
+  m->t2 = (int64_t)probe_load_le(data + 16, 8);
+  m->t3 = (int64_t)probe_load_le(data + 24, 8);
+  return 1;
+}
+
+/* Responder side: stamps t2 (receipt) and t3 (reply) in place. */
+static inline void probe_sync_answer(probe_sync_msg *m, int64_t t2) {
+  m->t2 = t2;
+  m->t3 = probe_now_ns(m->clock);
+}
+
+static inline void probe_offset_init(probe_offset_estimator *e) {
+  e->offset_ns = 0;
+  e->rtt_ns = INT64_MAX;
+  e->samples = 0;
+}
+
+/* Requester side: folds in an answered sync message that arrived at t4. */
+static inline void probe_offset_add(probe_offset_estimator *e,
+                                    const probe_sync_msg *m, int64_t t4) {
+  int64_t rtt = (t4 - m->t1) - (m->t3 - m->t2);
+  ++e->samples;
+  if (rtt >= 0 && rtt < e->rtt_ns) {
+    e->rtt_ns = rtt;
+    e->offset_ns = ((m->t2 - m->t1) + (m->t3 - t4)) / 2;
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PROBE_CLOCK_H */
@@ -0,0 +1,147 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "probe_clock.h"
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Binary latency probe carried at the start of every benchmark payload. The
+// clocks and the wire format live in probe_clock.h, which the C examples
+// share; these are the C++ spellings of it.
+//
+// probe_header is the C struct: publisher_id, seq, send_ns and the clock
+// send_ns was read on. The C++ probes stamp the monotonic clock.
+constexpr std::size_t probe_header_size = PROBE_HEADER_SIZE;
+
+inline std::int64_t get_ns() { return probe_monotonic_ns(); }
+
+// Writes the header into out[0, probe_header_size). out must be at least that
+// large; bytes after the header are left untouched.
+inline void encode_probe(char *out, const probe_header &h) {
+  probe_encode(out, &h);
+}
+
+// Returns false if the payload is too short or does not carry the magic.
+inline bool decode_probe(const char *data, std::size_t size, probe_header &h) {
+  return probe_decode(data, size, &h) != 0;
+}
+
+inline bool decode_probe(std::string_view payload, probe_header &h) {
+  return decode_probe(payload.data(), payload.size(), h);
+}
+
+// Time since h was sent, on the clock it names; offset_ns maps this host's
+// clock onto the sender's when they are in different places.
+inline std::int64_t probe_age_ns(const probe_header &h,
+                                 std::int64_t offset_ns = 0) {
+  return probe_latency_ns(&h, offset_ns);
+}
+
+// Stamps consecutive probes into a payload buffer that is allocated once.
+// The returned view stays valid until the next call to next().
+class probe_encoder {
+public:
+  explicit probe_encoder(std::uint32_t publisher_id,
+                         std::size_t payload_size = probe_header_size)
+      : publisher_id_(publisher_id),
+        buf_(std::max(payload_size, probe_header_size), '\0') {}
+
+  std::string_view next(std::int64_t send_ns = get_ns()) {
+    encode_probe(buf_.data(),
+                 {publisher_id_, seq_++, send_ns, PROBE_CLOCK_MONOTONIC});
+    return buf_;
+  }
+
+  std::uint64_t sent() const { return seq_; }
+
+private:
+  std::uint32_t publisher_id_;
+  std::uint64_t seq_ = 0;
+  std::string buf_;
+};
+
+// Per-publisher sequence bookkeeping. A sliding 64-entry window behind the
+// highest sequence seen tells a late (reordered) message from a duplicate.
+// Anything older than the window is too late to tell apart: it is counted
+// as too_late and, like a reordered one, taken off lost, where the gap put
+// it (a duplicate that old is unlikely).
+class sequence_tracker {
+public:
+  struct stats {
+    std::uint64_t received = 0;
+    std::uint64_t lost = 0;
+    std::uint64_t duplicated = 0;
+    std::uint64_t reordered = 0;
+    std::uint64_t too_late = 0;
+    std::uint64_t malformed = 0;
+  };
+
+  void on_malformed() { ++stats_.malformed; }
+
+  void on_receive(const probe_header &h) {
+    ++stats_.received;
+    auto &w = windows_[h.publisher_id];
+    if (!w.started || h.seq >= w.next) {
+      auto gap = w.started ? h.seq - w.next : 0;
+      stats_.lost += gap;
+      w.seen = gap + 1 >= 64 ? 0 : w.seen << (gap + 1);
+      w.seen |= 1;
+      w.next = h.seq + 1;
+      w.started = true;
+      return;
+    }
+    auto back = w.next - 1 - h.seq;
+    if (back >= 64) {
+      if (stats_.lost) {
+        --stats_.lost;
+      }
+      ++stats_.too_late;
+      return;
+    }
+    auto bit = std::uint64_t(1) << back;
+    if (w.seen & bit) {
+      ++stats_.duplicated;
+    } else {
+      // It was counted as lost when the gap opened.
+      w.seen |= bit;
+      --stats_.lost;
+      ++stats_.reordered;
+    }
+  }
+
+  const stats &get() const { return stats_; }
+
+private:
+  struct window {
+    bool started = false;
+    std::uint64_t next = 0;
+    // Bit i set: sequence (next - 1 - i) was received.
+    std::uint64_t seen = 0;
+  };
+
+  std::unordered_map<std::uint32_t, window> windows_;
+  stats stats_;
+};
+
+inline std::ostream &operator<<(std::ostream &os,
+                                const sequence_tracker::stats &s) {
+  return os << "received=" << s.received << " lost=" << s.lost
+            << " duplicated=" << s.duplicated << " reordered=" << s.reordered
+            << " too_late=" << s.too_late << " malformed=" << s.malformed;
+}
+
+inline std::string to_string(const sequence_tracker::stats &s) {
+  std::ostringstream os;
+  os << s;
+  return os.str();
+}
@@ -0,0 +1,45 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// I/O accounting of the calling thread from /proc/thread-self/io (Linux).
+// syscw counts write-family syscalls and wchar the bytes they were asked to
+// write, which for a thread that only talks to its socket is the wire cost.
+struct proc_io {
+  std::uint64_t rchar = 0;
+  std::uint64_t wchar = 0;
+  std::uint64_t syscr = 0;
+  std::uint64_t syscw = 0;
+
+  proc_io operator-(const proc_io &o) const {
+    return {rchar - o.rchar, wchar - o.wchar, syscr - o.syscr,
+            syscw - o.syscw};
+  }
+};
+
+inline proc_io thread_io() {
+  proc_io io;
+  std::ifstream f("/proc/thread-self/io");
+  std::string key;
+  std::uint64_t value;
+  while (f >> key >> value) {
+    if (key == "rchar:") {
+      io.rchar = value;
+    } else if (key == "wchar:") {
+      io.wchar = value;
+    } else if (key == "syscr:") {
+      io.syscr = value;
+    } else if (key == "syscw:") {
+      io.syscw = value;
+    }
+  }
+  return io;
+}
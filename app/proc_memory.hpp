@@ -0,0 +1,24 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <unistd.h>
+
+// Resident set size of the process from /proc/self/statm (Linux), or 0 where
+// that is not available. Freed heap memory the allocator keeps counts as
+// resident, so compare sizes taken after growth rather than after teardown.
+inline std::uint64_t resident_bytes() {
+  std::ifstream f("/proc/self/statm");
+  std::uint64_t size = 0;
+  std::uint64_t resident = 0;
+  if (!(f >> size >> resident)) {
+    return 0;
+  }
+  return resident * static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+}
@@ -0,0 +1,91 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "bench_options.hpp"
+#include "mqtt_client_cpp.hpp"
+#include <cstdint>
+#include <string>
+#include <utility>
+
+// MQTT protocol version and v5 connection settings for mqtt_cpp clients:
+//
+//   --mqtt-version=3.1.1|5 --topic-alias=0|1 --receive-maximum=<n>
+//   --maximum-packet-size=<bytes>
+//
+// With v5 and topic aliases (the v5 default) the first PUBLISH to a topic
+// registers an alias and later ones carry the 2-byte alias instead of the
+// topic string; the client also accepts aliases from the broker. Receive
+// maximum and maximum packet size are only sent when set.
+struct protocol_options {
+  bool v5 = false;
+  bool topic_alias = true;
+  std::uint16_t receive_maximum = 0;
+  std::uint32_t maximum_packet_size = 0;
+
+  static protocol_options from_options(const bench_options &opts) {
+    protocol_options p;
+    p.v5 = opts.get("mqtt-version", "3.1.1") == "5";
+    p.topic_alias = opts.get("topic-alias", p.topic_alias);
+    p.receive_maximum =
+        static_cast<std::uint16_t>(opts.get("receive-maximum", 0));
+    p.maximum_packet_size = static_cast<std::uint32_t>(
+        opts.get("maximum-packet-size", std::size_t(0)));
+    return p;
+  }
+
+  MQTT_NS::protocol_version version() const {
+    return v5 ? MQTT_NS::protocol_version::v5
+              : MQTT_NS::protocol_version::v3_1_1;
+  }
+
+  MQTT_NS::v5::properties connect_properties() const {
+    MQTT_NS::v5::properties props;
+    if (topic_alias) {
+      props.emplace_back(MQTT_NS::v5::property::topic_alias_maximum(0xffff));
+    }
+    if (receive_maximum) {
+      props.emplace_back(
+          MQTT_NS::v5::property::receive_maximum(receive_maximum));
+    }
+    if (maximum_packet_size) {
+      props.emplace_back(
+          MQTT_NS::v5::property::maximum_packet_size(maximum_packet_size));
+    }
+    return props;
+  }
+
+  // Call before connecting. Aliases are only used once the broker's CONNACK
+  // allows them.
+  template <typename C> void apply(C &c) const {
+    if (v5 && topic_alias) {
+      c->set_auto_map_topic_alias_send(true);
+    }
+  }
+
+  template <typename C, typename F> void async_connect(C &c, F &&f) const {
+    if (v5) {
+      c->async_connect(connect_properties(), std::forward<F>(f));
+    } else {
+      c->async_connect(std::forward<F>(f));
+    }
+  }
+
+  std::string describe() const {
+    if (!v5) {
+      return "v3.1.1";
+    }
+    std::string s = topic_alias ? "v5+aliases" : "v5";
+    if (receive_maximum) {
+      s += " receive-maximum=" + std::to_string(receive_maximum);
+    }
+    if (maximum_packet_size) {
+      s += " maximum-packet-size=" + std::to_string(maximum_packet_size);
+    }
+    return s;
+  }
+};
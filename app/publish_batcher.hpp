@@ -0,0 +1,81 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "mqtt_client_cpp.hpp"
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+struct batch_limits {
+  std::size_t max_msgs = 64;
+  std::size_t max_bytes = 64 * 1024;
+  std::chrono::microseconds max_delay{100};
+};
+
+// Coalesces publishes into gathered socket writes.
+//
+// Messages are held until max_msgs or max_bytes is reached, or max_delay has
+// passed since the first one, and then handed to the client back to back.
+// The client's send queue is configured to concatenate everything queued
+// behind an in-flight write into one scatter/gather async_write, so a batch
+// costs about two writes instead of one per message. Payloads are held by
+// reference (see shared_payload.hpp), so batching copies nothing.
+template <typename C> class publish_batcher {
+public:
+  publish_batcher(C &c, boost::asio::io_context &ioc, batch_limits limits)
+      : c_(c), timer_(ioc), limits_(limits) {
+    c_->set_max_queue_send_count(limits.max_msgs);
+    c_->set_max_queue_send_size(limits.max_bytes);
+    pending_.reserve(limits.max_msgs);
+  }
+
+  void add(MQTT_NS::buffer topic, MQTT_NS::buffer payload, MQTT_NS::qos qos) {
+    bytes_ += topic.size() + payload.size();
+    pending_.push_back({std::move(topic), std::move(payload), qos});
+    if (pending_.size() >= limits_.max_msgs || bytes_ >= limits_.max_bytes) {
+      flush();
+    } else if (pending_.size() == 1) {
+      timer_.expires_after(limits_.max_delay);
+      timer_.async_wait([this](boost::system::error_code const &error) {
+        if (!error) {
+          flush();
+        }
+      });
+    }
+  }
+
+  void flush() {
+    timer_.cancel();
+    if (pending_.empty()) {
+      return;
+    }
+    for (auto &p : pending_) {
+      c_->async_publish(std::move(p.topic), std::move(p.payload), p.qos);
+    }
+    ++batches_;
+    pending_.clear();
+    bytes_ = 0;
+  }
+
+  std::uint64_t batches() const { return batches_; }
+
+private:
+  struct pending_publish {
+    MQTT_NS::buffer topic;
+    MQTT_NS::buffer payload;
+    MQTT_NS::qos qos;
+  };
+
+  C &c_;
+  boost::asio::steady_timer timer_;
+  batch_limits limits_;
+  std::vector<pending_publish> pending_;
+  std::size_t bytes_ = 0;
+  std::uint64_t batches_ = 0;
+};
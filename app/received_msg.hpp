@@ -0,0 +1,40 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "mqtt_client_cpp.hpp"
+#include <cstdint>
+#include <string_view>
+
+// A received PUBLISH as handed from a client's io thread to consumers.
+//
+// The client reads each packet into one ref-counted buffer and passes topic
+// and payload to the publish handler as slices of it. Holding the slices
+// keeps that buffer alive, so a message crosses to another thread, through
+// a queue, without its bytes being copied. The slices are not
+// null-terminated: go by size(), or the views and the bounds-checked slice
+// below, never by C string functions.
+struct received_msg {
+  MQTT_NS::buffer topic;
+  MQTT_NS::buffer payload;
+  std::int64_t recv_ns = 0;
+
+  std::string_view topic_view() const { return {topic.data(), topic.size()}; }
+  std::string_view payload_view() const {
+    return {payload.data(), payload.size()};
+  }
+
+  // Up to n payload bytes from pos, sharing the receive buffer; empty when
+  // pos is past the end.
+  MQTT_NS::buffer payload_slice(std::size_t pos,
+                                std::size_t n = std::string_view::npos) const {
+    if (pos > payload.size()) {
+      return MQTT_NS::buffer();
+    }
+    return payload.substr(pos, n);
+  }
+};
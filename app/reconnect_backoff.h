@@ -0,0 +1,122 @@
+/*
+ * Copyright ips_gateway contributors 2026
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#ifndef RECONNECT_BACKOFF_H
+#define RECONNECT_BACKOFF_H
+
+/*
+ * Reconnect delays for the Paho C clients, the same policy as the C++
+ * backoff in reconnect_engine.hpp: the first attempt after a loss goes out at
+ * once, every further one waits a delay drawn uniformly from
+ * [initial, 3 * previous delay], capped at max (decorrelated jitter). Clients
+ * that lost the same broker at the same moment spread out instead of
+ * retrying in lockstep.
+ *
+ * Include it before any system header (or build with _DEFAULT_SOURCE
+ * defined): nanosleep() and clock_gettime() are not declared under a strict
+ * -std=c11 otherwise.
+ */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct reconnect_backoff {
+  int64_t initial_ms;
+  int64_t max_ms;
+  int64_t prev_ms;
+  unsigned attempts;
+  uint64_t rng;
+} reconnect_backoff;
+
+static inline uint64_t reconnect_backoff_seed(void) {
+#if defined(_WIN32)
+  LARGE_INTEGER c;
+  QueryPerformanceCounter(&c);
+  return (uint64_t)c.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static inline void reconnect_backoff_init(reconnect_backoff *b,
+                                          int64_t initial_ms,
+                                          int64_t max_ms) {
+  b->initial_ms = initial_ms;
+  b->max_ms = max_ms;
+  b->prev_ms = initial_ms;
+  b->attempts = 0;
+  /* Clients started together still differ in the address of b. */
+  b->rng = reconnect_backoff_seed() ^ (uint64_t)(uintptr_t)b;
+  if (b->rng == 0) {
+    b->rng = 1;
+  }
+}
+
+/* xorshift64*; plenty for spreading out retries. */
+static inline uint64_t reconnect_backoff_rand(reconnect_backoff *b) {
+  b->rng ^= b->rng >> 12;
+  b->rng ^= b->rng << 25;
+  b->rng ^= b->rng >> 27;
+  return b->rng * 0x2545f4914f6cdd1dULL;
+}
+
+/* The delay before the next attempt, in milliseconds. */
+static inline int64_t reconnect_backoff_next(reconnect_backoff *b) {
+  int64_t hi;
+  if (++b->attempts == 1) {
+    return 0;
+  }
+  hi = b->prev_ms * 3 > b->initial_ms ? b->prev_ms * 3 : b->initial_ms;
+  b->prev_ms = b->initial_ms + (int64_t)(reconnect_backoff_rand(b) %
+                                         (uint64_t)(hi - b->initial_ms + 1));
+  if (b->prev_ms > b->max_ms) {
+    b->prev_ms = b->max_ms;
+  }
+  return b->prev_ms;
+}
+
+/* After a successful connect. */
+static inline void reconnect_backoff_reset(reconnect_backoff *b) {
+  b->attempts = 0;
+  b->prev_ms = b->initial_ms;
+}
+
+static inline void reconnect_backoff_sleep(int64_t ms) {
+  if (ms <= 0) {
+    return;
+  }
+#if defined(_WIN32)
+  Sleep((DWORD)ms);
+#else
+  struct timespec ts;
+  ts.tv_sec = (time_t)(ms / 1000);
+  ts.tv_nsec = (long)(ms % 1000 * 1000000);
+  nanosleep(&ts, NULL);
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RECONNECT_BACKOFF_H */
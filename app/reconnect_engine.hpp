@@ -0,0 +1,199 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "bench_options.hpp"
+#include "latency_histogram.hpp"
+#include "metrics.hpp"
+#include "probe_payload.hpp"
+#include <algorithm>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+// Reconnect delays:
+//
+//   --backoff-initial-ms=<ms> --backoff-max-ms=<ms> --immediate-retry=0|1
+struct backoff_policy {
+  std::chrono::milliseconds initial{100};
+  std::chrono::milliseconds max{10000};
+  // The first attempt after a loss goes out at once; most drops are brief.
+  bool immediate_first = true;
+
+  static backoff_policy from_options(const bench_options &opts) {
+    backoff_policy p;
+    p.initial = std::chrono::milliseconds(
+        opts.get("backoff-initial-ms", int(p.initial.count())));
+    p.max = std::chrono::milliseconds(
+        opts.get("backoff-max-ms", int(p.max.count())));
+    p.immediate_first = opts.get("immediate-retry", p.immediate_first);
+    return p;
+  }
+};
+
+// Exponential backoff with decorrelated jitter: each delay is drawn
+// uniformly from [initial, 3 * previous delay] and capped at max. Clients
+// that lost the same broker at the same moment spread out instead of
+// retrying in lockstep.
+class backoff {
+public:
+  explicit backoff(backoff_policy policy,
+                   std::uint64_t seed = std::random_device{}())
+      : policy_(policy), rng_(seed) {}
+
+  std::chrono::milliseconds next() {
+    ++attempts_;
+    if (attempts_ == 1 && policy_.immediate_first) {
+      return std::chrono::milliseconds(0);
+    }
+    auto lo = policy_.initial.count();
+    auto hi = std::max(lo, prev_.count() * 3);
+    prev_ = std::min(
+        policy_.max,
+        std::chrono::milliseconds(
+            std::uniform_int_distribution<std::int64_t>(lo, hi)(rng_)));
+    return prev_;
+  }
+
+  void reset() {
+    attempts_ = 0;
+    prev_ = policy_.initial;
+  }
+
+  unsigned attempts() const { return attempts_; }
+
+private:
+  backoff_policy policy_;
+  std::mt19937_64 rng_;
+  unsigned attempts_ = 0;
+  std::chrono::milliseconds prev_ = policy_.initial;
+};
+
+// Drives reconnection of one client on its io_context.
+//
+// connect starts a single attempt; the owner reports the outcome with
+// on_connected(), or retry() when the attempt fails or the connection is
+// lost. Duplicate retry() calls for the same loss (error and close handlers
+// both firing, say) are ignored while an attempt is pending. Recorded per
+// outage: the time from the loss to the next accepted connection, and from
+// there to the first message received.
+class reconnect_engine {
+public:
+  reconnect_engine(boost::asio::io_context &ioc, backoff_policy policy,
+                   std::function<void()> connect)
+      : ioc_(ioc), timer_(ioc), backoff_(policy),
+        connect_(std::move(connect)) {}
+
+  void retry() {
+    if (stopped_ || pending_) {
+      return;
+    }
+    if (!lost_ns_) {
+      lost_ns_ = get_ns();
+    }
+    pending_ = true;
+    ++attempts_;
+    auto delay = backoff_.next();
+    if (delay.count() == 0) {
+      boost::asio::post(ioc_, [this] { attempt(); });
+      return;
+    }
+    timer_.expires_after(delay);
+    timer_.async_wait([this](boost::system::error_code const &error) {
+      if (!error) {
+        attempt();
+      }
+    });
+  }
+
+  void on_connected() {
+    connected_ns_ = get_ns();
+    if (lost_ns_) {
+      client_metrics().reconnects.add();
+      to_reconnect_.record(connected_ns_ - lost_ns_);
+      awaiting_message_ = true;
+      lost_ns_ = 0;
+    }
+    backoff_.reset();
+  }
+
+  void on_message() {
+    if (awaiting_message_) {
+      to_first_message_.record(get_ns() - connected_ns_);
+      awaiting_message_ = false;
+    }
+  }
+
+  void stop() {
+    stopped_ = true;
+    timer_.cancel();
+  }
+
+  std::uint64_t attempts() const { return attempts_; }
+  const latency_histogram &time_to_reconnect() const { return to_reconnect_; }
+  const latency_histogram &time_to_first_message() const {
+    return to_first_message_;
+  }
+
+private:
+  void attempt() {
+    pending_ = false;
+    if (!stopped_) {
+      connect_();
+    }
+  }
+
+  boost::asio::io_context &ioc_;
+  boost::asio::steady_timer timer_;
+  backoff backoff_;
+  std::function<void()> connect_;
+  bool stopped_ = false;
+  bool pending_ = false;
+  bool awaiting_message_ = false;
+  std::int64_t lost_ns_ = 0;
+  std::int64_t connected_ns_ = 0;
+  std::uint64_t attempts_ = 0;
+  latency_histogram to_reconnect_;
+  latency_histogram to_first_message_;
+};
+
+inline std::ostream &operator<<(std::ostream &os, const reconnect_engine &e) {
+  return os << "attempts=" << e.attempts()
+            << " reconnects=" << e.time_to_reconnect().count()
+            << "\n  to reconnect " << e.time_to_reconnect()
+            << "\n  to first message " << e.time_to_first_message();
+}
+
+inline std::string to_string(const reconnect_engine &e) {
+  std::ostringstream os;
+  os << e;
+  return os.str();
+}
+
+// Resolves host once up front, so that reconnects skip the DNS lookup: a host
+// with a single address is replaced by that numeric address. One with several
+// addresses, or none right now, comes back unchanged; mqtt_cpp's client then
+// resolves it on every connect and tries each address in turn, which keeps a
+// broker listening on only one of them (localhost as ::1 and 127.0.0.1, say)
+// reachable.
+inline std::string resolve_once(const std::string &host, std::uint16_t port) {
+  boost::asio::io_context ioc;
+  boost::asio::ip::tcp::resolver resolver(ioc);
+  boost::system::error_code ec;
+  auto results = resolver.resolve(host, std::to_string(port), ec);
+  if (ec || results.size() != 1) {
+    return host;
+  }
+  return results.begin()->endpoint().address().to_string();
+}
@@ -0,0 +1,72 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "mqtt_client_cpp.hpp"
+#include "payload_pool.hpp"
+#include "probe_payload.hpp"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string_view>
+
+// Immutable, ref-counted payloads for the zero-copy publish path.
+//
+// async_publish(std::string, std::string, ...) copies both into buffers the
+// client owns. async_publish(MQTT_NS::buffer, MQTT_NS::buffer, ...) only
+// takes a reference: the socket write gathers straight from the caller's
+// storage, which the buffer keeps alive until the write (or, for QoS 1/2,
+// the acknowledgement) is done. A payload built once in a buffer can be
+// queued, batched and fanned out to any number of topics without being
+// copied again.
+
+// Points at a string that outlives every publish, e.g. a literal topic.
+inline MQTT_NS::buffer static_buffer(std::string_view s) {
+  return MQTT_NS::buffer(MQTT_NS::string_view(s.data(), s.size()));
+}
+
+// Copies s once into shared storage; for payloads that exist elsewhere first.
+inline MQTT_NS::buffer make_shared_payload(std::string_view s) {
+  return MQTT_NS::allocate_buffer(s.begin(), s.end());
+}
+
+// Stamps each probe into a fresh buffer, so the payload is written exactly
+// once and never copied afterwards. Unlike probe_encoder the result stays
+// valid after the next call, since the client may still hold it. Buffers come
+// from pool when one is given (the pool must belong to the calling thread),
+// otherwise from the heap.
+class shared_probe_encoder {
+public:
+  explicit shared_probe_encoder(std::uint32_t publisher_id,
+                                std::size_t payload_size = probe_header_size,
+                                payload_pool *pool = nullptr)
+      : publisher_id_(publisher_id),
+        size_(std::max(payload_size, probe_header_size)), pool_(pool) {}
+
+  MQTT_NS::buffer next(std::int64_t send_ns = get_ns()) {
+    auto write = [&](char *p) {
+      encode_probe(p, {publisher_id_, seq_++, send_ns, PROBE_CLOCK_MONOTONIC});
+      std::memset(p + probe_header_size, 0, size_ - probe_header_size);
+    };
+    if (pool_) {
+      return pool_->make(size_, write);
+    }
+    std::shared_ptr<char[]> p(new char[size_]);
+    write(p.get());
+    MQTT_NS::string_view view(p.get(), size_);
+    return MQTT_NS::buffer(view, std::move(p));
+  }
+
+  std::uint64_t sent() const { return seq_; }
+  std::size_t size() const { return size_; }
+
+private:
+  std::uint32_t publisher_id_;
+  std::size_t size_;
+  payload_pool *pool_;
+  std::uint64_t seq_ = 0;
+};
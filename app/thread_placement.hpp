@@ -0,0 +1,191 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "bench_options.hpp"
+#include <linux/mempolicy.h>
+#include <optional>
+#include <pthread.h>
+#include <sched.h>
+#include <stdexcept>
+#include <string>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// CPU sets given as "0-3,6" lists.
+struct cpu_list {
+  std::string spec;
+  std::vector<int> cpus;
+
+  static std::optional<cpu_list> parse(const std::string &spec) {
+    cpu_list l{spec, {}};
+    std::size_t pos = 0;
+    while (pos < spec.size()) {
+      auto end = spec.find(',', pos);
+      auto item = spec.substr(pos, end == std::string::npos ? end : end - pos);
+      auto dash = item.find('-');
+      try {
+        int first = std::stoi(item.substr(0, dash));
+        int last = first;
+        if (dash != std::string::npos) {
+          last = std::stoi(item.substr(dash + 1));
+        }
+        for (int c = first; c <= last; ++c) {
+          l.cpus.push_back(c);
+        }
+      } catch (std::exception const &) {
+        return std::nullopt;
+      }
+      if (end == std::string::npos) {
+        break;
+      }
+      pos = end + 1;
+    }
+    if (l.cpus.empty()) {
+      return std::nullopt;
+    }
+    return l;
+  }
+
+  cpu_set_t to_cpu_set() const {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto c : cpus) {
+      CPU_SET(c, &set);
+    }
+    return set;
+  }
+
+  // The k-th CPU alone, for spreading a pool one thread per CPU.
+  cpu_list nth(std::size_t k) const {
+    auto c = cpus[k % cpus.size()];
+    return {std::to_string(c), {c}};
+  }
+};
+
+inline bool pin_thread(pthread_t thread, const cpu_list &cpus) {
+  auto set = cpus.to_cpu_set();
+  return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+
+inline bool pin_this_thread(const cpu_list &cpus) {
+  return pin_thread(pthread_self(), cpus);
+}
+
+// Makes later allocations of the calling thread come from the NUMA node it
+// runs on. Pages are placed on first touch, so buffers should be allocated
+// and initialised after the thread has been pinned.
+inline bool use_local_memory() {
+  return syscall(SYS_set_mempolicy, MPOL_LOCAL, nullptr, 0) == 0;
+}
+
+// CPUs the process may run on that are in none of the given lists; used to
+// keep logging threads away from the I/O threads.
+inline std::optional<cpu_list>
+remaining_cpus(const std::vector<const cpu_list *> &taken) {
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return std::nullopt;
+  }
+  for (auto l : taken) {
+    if (l) {
+      for (auto c : l->cpus) {
+        CPU_CLR(c, &allowed);
+      }
+    }
+  }
+  cpu_list rest;
+  for (int c = 0; c < CPU_SETSIZE; ++c) {
+    if (CPU_ISSET(c, &allowed)) {
+      rest.cpus.push_back(c);
+      rest.spec += (rest.spec.empty() ? "" : ",") + std::to_string(c);
+    }
+  }
+  if (rest.cpus.empty()) {
+    return std::nullopt;
+  }
+  return rest;
+}
+
+// Named thread placement profile read from the command line:
+//
+//   --placement=<name> --pin-sub=<cpus> --pin-pub=<cpus>
+//   --pin-consumer=<cpus> --pin-producers=<cpus> --pin-io=<cpus>
+//   --pin-log=<cpus> --isolate-log --numa-local
+//
+// Unset roles are left to the scheduler. --isolate-log puts logging threads
+// on every allowed CPU not used by an I/O role (unless --pin-log is given).
+// The consumer, which polls the sub thread's receive queue, has a role of
+// its own so that it does not compete for the sub thread's CPUs. The name
+// labels the latency report, so runs can be compared per profile.
+struct thread_placement {
+  std::string name;
+  std::optional<cpu_list> sub;
+  std::optional<cpu_list> pub;
+  std::optional<cpu_list> consumer;
+  std::optional<cpu_list> producers;
+  std::optional<cpu_list> io;
+  std::optional<cpu_list> log;
+  bool numa_local = false;
+
+  static thread_placement from_options(const bench_options &opts) {
+    thread_placement p;
+    p.name = opts.get("placement", "default");
+    p.sub = cpu_list::parse(opts.get("pin-sub", ""));
+    p.pub = cpu_list::parse(opts.get("pin-pub", ""));
+    p.consumer = cpu_list::parse(opts.get("pin-consumer", ""));
+    p.producers = cpu_list::parse(opts.get("pin-producers", ""));
+    p.io = cpu_list::parse(opts.get("pin-io", ""));
+    p.log = cpu_list::parse(opts.get("pin-log", ""));
+    if (!p.log && opts.get("isolate-log", false)) {
+      p.log = remaining_cpus({p.sub ? &*p.sub : nullptr,
+                              p.pub ? &*p.pub : nullptr,
+                              p.consumer ? &*p.consumer : nullptr,
+                              p.producers ? &*p.producers : nullptr,
+                              p.io ? &*p.io : nullptr});
+    }
+    p.numa_local = opts.get("numa-local", false);
+    return p;
+  }
+
+  // Pins the calling thread to cpus (if set) and applies the memory policy.
+  void enter(const std::optional<cpu_list> &cpus) const {
+    if (cpus) {
+      pin_this_thread(*cpus);
+    }
+    if (numa_local) {
+      use_local_memory();
+    }
+  }
+
+  // Runs f on a temporary thread placed like a role, so that memory f
+  // allocates and touches lands on that role's NUMA node.
+  template <typename F>
+  void run_as(const std::optional<cpu_list> &cpus, F f) const {
+    if (!cpus && !numa_local) {
+      f();
+      return;
+    }
+    std::thread t([&] {
+      enter(cpus);
+      f();
+    });
+    t.join();
+  }
+
+  std::string describe() const {
+    auto spec = [](const std::optional<cpu_list> &l) {
+      return l ? l->spec : std::string("any");
+    };
+    return name + " (sub " + spec(sub) + ", pub " + spec(pub) +
+           ", consumer " + spec(consumer) + ", producers " + spec(producers) +
+           ", io " + spec(io) + ", log " + spec(log) +
+           (numa_local ? ", numa-local" : "") + ")";
+  }
+};
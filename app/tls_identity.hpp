@@ -0,0 +1,108 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <memory>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+#include <stdexcept>
+#include <string>
+
+// A throwaway self-signed certificate for the TLS benchmarks, generated in
+// memory at startup so no key material lives in the tree. The certificate is
+// for localhost and 127.0.0.1 (P-256, valid for a day); clients trust it by
+// adding it as their only certificate authority. Failures are thrown as
+// std::runtime_error.
+struct tls_identity {
+  std::string cert_pem;
+  std::string key_pem;
+
+  static tls_identity generate() {
+    auto fail = [](const char *what) {
+      throw std::runtime_error(std::string("tls_identity: ") + what);
+    };
+    std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> kctx(
+        EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr), EVP_PKEY_CTX_free);
+    EVP_PKEY *raw_key = nullptr;
+    if (!kctx || EVP_PKEY_keygen_init(kctx.get()) <= 0 ||
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid(kctx.get(),
+                                               NID_X9_62_prime256v1) <= 0 ||
+        EVP_PKEY_keygen(kctx.get(), &raw_key) <= 0) {
+      fail("key generation failed");
+    }
+    std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key(raw_key,
+                                                            EVP_PKEY_free);
+
+    std::unique_ptr<X509, decltype(&X509_free)> cert(X509_new(), X509_free);
+    if (!cert) {
+      fail("X509_new failed");
+    }
+    X509_set_version(cert.get(), 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert.get()), -60);
+    X509_gmtime_adj(X509_getm_notAfter(cert.get()), 24 * 60 * 60);
+    X509_set_pubkey(cert.get(), key.get());
+    auto *name = X509_get_subject_name(cert.get());
+    X509_NAME_add_entry_by_txt(
+        name, "CN", MBSTRING_ASC,
+        reinterpret_cast<const unsigned char *>("localhost"), -1, -1, 0);
+    X509_set_issuer_name(cert.get(), name);
+    X509V3_CTX v3;
+    X509V3_set_ctx_nodb(&v3);
+    X509V3_set_ctx(&v3, cert.get(), cert.get(), nullptr, nullptr, 0);
+    auto *san = X509V3_EXT_conf_nid(nullptr, &v3, NID_subject_alt_name,
+                                    "DNS:localhost,IP:127.0.0.1");
+    if (!san || !X509_add_ext(cert.get(), san, -1)) {
+      X509_EXTENSION_free(san);
+      fail("subjectAltName failed");
+    }
+    X509_EXTENSION_free(san);
+    if (!X509_sign(cert.get(), key.get(), EVP_sha256())) {
+      fail("signing failed");
+    }
+
+    tls_identity id;
+    id.cert_pem =
+        to_pem([&](BIO *b) { return PEM_write_bio_X509(b, cert.get()); });
+    id.key_pem = to_pem([&](BIO *b) {
+      return PEM_write_bio_PrivateKey(b, key.get(), nullptr, nullptr, 0,
+                                      nullptr, nullptr);
+    });
+    return id;
+  }
+
+  // Server side: presents the certificate.
+  boost::asio::ssl::context server_context() const {
+    boost::asio::ssl::context ctx(boost::asio::ssl::context::tls_server);
+    ctx.use_certificate_chain(boost::asio::buffer(cert_pem));
+    ctx.use_private_key(boost::asio::buffer(key_pem),
+                        boost::asio::ssl::context::pem);
+    return ctx;
+  }
+
+  // Client side: verifies the server against the certificate.
+  void trust(boost::asio::ssl::context &ctx) const {
+    ctx.add_certificate_authority(boost::asio::buffer(cert_pem));
+    ctx.set_verify_mode(boost::asio::ssl::verify_peer);
+  }
+
+private:
+  template <typename F> static std::string to_pem(F &&write) {
+    std::unique_ptr<BIO, decltype(&BIO_free)> bio(BIO_new(BIO_s_mem()),
+                                                  BIO_free);
+    if (!bio || !write(bio.get())) {
+      throw std::runtime_error("tls_identity: PEM encoding failed");
+    }
+    char *data = nullptr;
+    auto size = BIO_get_mem_data(bio.get(), &data);
+    return std::string(data, static_cast<std::size_t>(size));
+  }
+};
@@ -0,0 +1,280 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "mqtt_client_cpp.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Routes received topic names to the handlers of the filters they match, for
+// a client holding thousands of subscriptions instead of one catch-all
+// publish handler. Matching follows MQTT: '+' is exactly one level, '#' the
+// rest of the tree including its parent ("a/#" matches "a"), and wildcards in
+// the first level never match topics starting with '$'.
+//
+// The filters form a trie whose nodes sit in one vector and refer to each
+// other by index. The literal children of all nodes share one open-addressing
+// table keyed on (parent, level), with the level text kept in one string;
+// '+' and '#' children hang off their parent directly. match() walks the
+// topic a level at a time, following the literal child and the '+' child of
+// each node, so its cost grows with the topic's depth and the wildcards met
+// on the way rather than with the number of filters, and it neither allocates
+// nor copies the topic.
+//
+// Routes are added while setting up; add() must not run concurrently with
+// match().
+template <typename Handler> class topic_router {
+public:
+  using id_t = std::uint32_t;
+
+  topic_router() : nodes_(1), edges_(16) {}
+
+  // Routes topics matching filter to handler; a filter may have several
+  // handlers, called in the order they were added. Throws
+  // std::invalid_argument for a malformed filter.
+  id_t add(std::string_view filter, Handler handler) {
+    if (filter.empty()) {
+      throw std::invalid_argument("topic_router: empty filter");
+    }
+    std::uint32_t n = 0;
+    for (std::string_view rest = filter;;) {
+      auto slash = rest.find('/');
+      auto level = rest.substr(0, slash);
+      bool last = slash == std::string_view::npos;
+      if (level == "#") {
+        if (!last) {
+          throw std::invalid_argument("topic_router: '#' not last in " +
+                                      std::string(filter));
+        }
+        n = child(n, &node::multi);
+        break;
+      }
+      if (level.find_first_of("+#") == std::string_view::npos) {
+        n = literal_child(n, level);
+      } else if (level == "+") {
+        n = child(n, &node::single);
+      } else {
+        throw std::invalid_argument("topic_router: wildcard inside level of " +
+                                    std::string(filter));
+      }
+      if (last) {
+        break;
+      }
+      rest.remove_prefix(slash + 1);
+    }
+
+    auto id = static_cast<id_t>(routes_.size());
+    routes_.push_back({std::move(handler), none});
+    auto &nd = nodes_[n];
+    if (nd.first == none) {
+      nd.first = id;
+      filters_.emplace_back(filter);
+    } else {
+      routes_[nd.last].next = id;
+    }
+    nd.last = id;
+    return id;
+  }
+
+  // Calls f(handler) for every route whose filter matches topic; returns how
+  // many there were.
+  template <typename F> std::size_t match(std::string_view topic, F &&f) {
+    if (topic.empty()) {
+      return 0;
+    }
+    std::size_t count = 0;
+    walk(0, topic, false, topic.front() != '$', f, count);
+    return count;
+  }
+
+  // Calls every handler whose filter matches topic with args.
+  template <typename... Args>
+  std::size_t dispatch(std::string_view topic, Args &&...args) {
+    return match(topic, [&](Handler &h) { h(args...); });
+  }
+
+  // The distinct filters, in the order they were first added.
+  const std::vector<std::string> &filters() const { return filters_; }
+  std::size_t routes() const { return routes_.size(); }
+  std::size_t nodes() const { return nodes_.size(); }
+
+  // Bytes held by the trie itself, handlers excluded.
+  std::size_t memory_bytes() const {
+    return nodes_.capacity() * sizeof(node) +
+           edges_.capacity() * sizeof(edge) + labels_.capacity();
+  }
+
+private:
+  static constexpr std::uint32_t none = UINT32_MAX;
+
+  struct node {
+    std::uint32_t single = none; // '+' child
+    std::uint32_t multi = none;  // '#' child
+    std::uint32_t first = none;  // routes ending here
+    std::uint32_t last = none;
+  };
+
+  // A literal child: slot of the edge table. child == none when empty.
+  struct edge {
+    std::uint32_t hash = 0;
+    std::uint32_t parent = 0;
+    std::uint32_t child = none;
+    std::uint32_t label = 0;
+    std::uint32_t label_size = 0;
+  };
+
+  struct route {
+    Handler handler;
+    std::uint32_t next;
+  };
+
+  // FNV-1a over the level, mixed with the parent so that equal levels under
+  // different parents spread out.
+  static std::uint32_t hash_of(std::uint32_t parent, std::string_view level) {
+    std::uint64_t h = 0xcbf29ce484222325u ^ (parent * 0x9e3779b97f4a7c15u);
+    for (auto ch : level) {
+      h = (h ^ static_cast<unsigned char>(ch)) * 0x100000001b3u;
+    }
+    return static_cast<std::uint32_t>(h ^ (h >> 32));
+  }
+
+  // Slot holding (parent, level), or the empty slot where it would go.
+  std::size_t find_slot(std::uint32_t parent, std::string_view level,
+                        std::uint32_t hash) const {
+    auto mask = edges_.size() - 1;
+    for (auto i = hash & mask;; i = (i + 1) & mask) {
+      const auto &e = edges_[i];
+      if (e.child == none ||
+          (e.hash == hash && e.parent == parent &&
+           std::string_view(labels_.data() + e.label, e.label_size) ==
+               level)) {
+        return i;
+      }
+    }
+  }
+
+  std::uint32_t find_child(std::uint32_t parent,
+                           std::string_view level) const {
+    return edges_[find_slot(parent, level, hash_of(parent, level))].child;
+  }
+
+  std::uint32_t literal_child(std::uint32_t parent, std::string_view level) {
+    auto hash = hash_of(parent, level);
+    auto slot = find_slot(parent, level, hash);
+    if (edges_[slot].child != none) {
+      return edges_[slot].child;
+    }
+    // Keep the table at most half full, so probes stay short.
+    if (2 * (edge_count_ + 1) > edges_.size()) {
+      grow();
+      slot = find_slot(parent, level, hash);
+    }
+    auto n = static_cast<std::uint32_t>(nodes_.size());
+    nodes_.emplace_back();
+    edges_[slot] = {hash, parent, n, static_cast<std::uint32_t>(labels_.size()),
+                    static_cast<std::uint32_t>(level.size())};
+    labels_.append(level);
+    ++edge_count_;
+    return n;
+  }
+
+  std::uint32_t child(std::uint32_t parent, std::uint32_t node::*which) {
+    if (nodes_[parent].*which == none) {
+      auto n = static_cast<std::uint32_t>(nodes_.size());
+      nodes_.emplace_back();
+      nodes_[parent].*which = n;
+    }
+    return nodes_[parent].*which;
+  }
+
+  void grow() {
+    std::vector<edge> old(edges_.size() * 2);
+    old.swap(edges_);
+    auto mask = edges_.size() - 1;
+    for (const auto &e : old) {
+      if (e.child == none) {
+        continue;
+      }
+      auto i = e.hash & mask;
+      while (edges_[i].child != none) {
+        i = (i + 1) & mask;
+      }
+      edges_[i] = e;
+    }
+  }
+
+  // n has matched the topic up to rest; done once every level is consumed.
+  // wild tells whether wildcards may match the next level.
+  template <typename F>
+  void walk(std::uint32_t n, std::string_view rest, bool done, bool wild,
+            F &f, std::size_t &count) {
+    const auto &nd = nodes_[n];
+    if (wild && nd.multi != none) {
+      count += emit(nodes_[nd.multi].first, f);
+    }
+    if (done) {
+      count += emit(nd.first, f);
+      return;
+    }
+    auto slash = rest.find('/');
+    auto level = rest.substr(0, slash);
+    bool last = slash == std::string_view::npos;
+    auto tail = last ? std::string_view() : rest.substr(slash + 1);
+    auto c = find_child(n, level);
+    if (c != none) {
+      walk(c, tail, last, true, f, count);
+    }
+    if (wild && nd.single != none) {
+      walk(nd.single, tail, last, true, f, count);
+    }
+  }
+
+  template <typename F> std::size_t emit(std::uint32_t r, F &f) {
+    std::size_t count = 0;
+    for (; r != none; r = routes_[r].next) {
+      f(routes_[r].handler);
+      ++count;
+    }
+    return count;
+  }
+
+  std::vector<node> nodes_;
+  std::vector<edge> edges_;
+  std::size_t edge_count_ = 0;
+  std::string labels_;
+  std::vector<route> routes_;
+  std::vector<std::string> filters_;
+};
+
+// Subscribes c to every filter of router at qos, per_packet filters to a
+// SUBSCRIBE packet rather than a packet (and a SUBACK round trip) each. Call
+// it from the connack handler so a reconnect restores the subscriptions.
+// Returns the number of SUBSCRIBE packets sent.
+template <typename Client, typename Handler>
+std::size_t subscribe_routes(Client &c, const topic_router<Handler> &router,
+                             MQTT_NS::qos qos, std::size_t per_packet = 256) {
+  const auto &filters = router.filters();
+  std::size_t packets = 0;
+  for (std::size_t i = 0; i < filters.size(); i += per_packet) {
+    auto end = std::min(filters.size(), i + per_packet);
+    std::vector<std::tuple<std::string, MQTT_NS::subscribe_options>> batch;
+    batch.reserve(end - i);
+    for (auto k = i; k < end; ++k) {
+      batch.emplace_back(filters[k], qos);
+    }
+    c.async_subscribe(std::move(batch));
+    ++packets;
+  }
+  return packets;
+}
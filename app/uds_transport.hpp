@@ -0,0 +1,220 @@
+// Copyright ips_gateway contributors 2026
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "broker_address.hpp"
+#include "mqtt_client_cpp.hpp"
+#include <atomic>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// MQTT over Unix domain stream sockets, for a client and broker on the same
+// host: no TCP/IP stack, checksums or loopback device between them.
+//
+// mqtt_cpp's endpoint reads and writes through the type-erased MQTT_NS::socket,
+// so a local stream socket plugs in underneath it (uds_socket) without
+// touching the protocol code. Its client, however, resolves and connects
+// TCP itself, hence uds_client: the same endpoint and handler overlay, with
+// its own connect over a socket path. Code written against make_async_client()
+// works unchanged against make_uds_client(), reconnects included.
+//
+// Limits: only plain MQTT (no TLS or WebSocket layer over the socket); there
+// is no TCP socket underneath, so lowest_layer(), which the interface insists
+// on, throws; and the path must fit sun_path (108 bytes on Linux).
+
+// A connected (or accepted) local stream socket as seen by an mqtt_cpp
+// endpoint. Completion handlers run on the socket's strand, as with
+// mqtt_cpp's TCP socket.
+class uds_socket : public MQTT_NS::socket {
+public:
+  using stream_t = boost::asio::local::stream_protocol::socket;
+
+  explicit uds_socket(boost::asio::io_context &ioc)
+      : stream_(ioc), strand_(ioc) {}
+
+  stream_t &next_layer() { return stream_; }
+
+  // When the last write was started, for the client's keep alive.
+  std::chrono::steady_clock::time_point last_write() const {
+    return std::chrono::steady_clock::time_point(
+        std::chrono::steady_clock::duration(
+            last_write_.load(std::memory_order_relaxed)));
+  }
+
+  void async_read(boost::asio::mutable_buffer buffers,
+                  std::function<void(MQTT_NS::error_code, std::size_t)>
+                      handler) override {
+    boost::asio::async_read(
+        stream_, buffers,
+        boost::asio::bind_executor(strand_, std::move(handler)));
+  }
+
+  void async_write(std::vector<boost::asio::const_buffer> buffers,
+                   std::function<void(MQTT_NS::error_code, std::size_t)>
+                       handler) override {
+    touch();
+    boost::asio::async_write(
+        stream_, buffers,
+        boost::asio::bind_executor(strand_, std::move(handler)));
+  }
+
+  std::size_t write(std::vector<boost::asio::const_buffer> buffers,
+                    boost::system::error_code &ec) override {
+    touch();
+    return boost::asio::write(stream_, buffers, ec);
+  }
+
+  void post(std::function<void()> handler) override {
+    boost::asio::post(strand_, std::move(handler));
+  }
+  void dispatch(std::function<void()> handler) override {
+    boost::asio::dispatch(strand_, std::move(handler));
+  }
+  void defer(std::function<void()> handler) override {
+    boost::asio::defer(strand_, std::move(handler));
+  }
+  bool running_in_this_thread() const override {
+    return strand_.running_in_this_thread();
+  }
+
+  boost::asio::ip::tcp::socket::lowest_layer_type &lowest_layer() override {
+    throw std::logic_error("uds_socket: no TCP socket underneath");
+  }
+  MQTT_NS::any native_handle() override { return stream_.native_handle(); }
+
+  void clean_shutdown_and_close(boost::system::error_code &ec) override {
+    if (stream_.is_open()) {
+      stream_.shutdown(stream_t::shutdown_both, ec);
+      stream_.close(ec);
+    }
+  }
+  void async_clean_shutdown_and_close(
+      std::function<void(MQTT_NS::error_code)> handler) override {
+    boost::system::error_code ec;
+    clean_shutdown_and_close(ec);
+    post([handler = std::move(handler), ec] { handler(ec); });
+  }
+  void force_shutdown_and_close(boost::system::error_code &ec) override {
+    clean_shutdown_and_close(ec);
+  }
+
+  boost::asio::any_io_executor get_executor() override {
+    return stream_.get_executor();
+  }
+
+private:
+  void touch() {
+    last_write_.store(
+        std::chrono::steady_clock::now().time_since_epoch().count(),
+        std::memory_order_relaxed);
+  }
+
+  stream_t stream_;
+  boost::asio::io_context::strand strand_;
+  std::atomic<std::chrono::steady_clock::rep> last_write_{0};
+};
+
+// Client endpoint over a socket path. Mirrors the parts of mqtt_cpp's client
+// the benchmarks use: client id, keep alive (a PINGREQ once nothing has been
+// sent for keep_alive_sec), clean session and async_connect() with or without
+// v5 properties; everything else is the endpoint's. Like make_async_client(),
+// it sends every packet asynchronously, automatic acks included.
+class uds_client_base
+    : public MQTT_NS::endpoint<std::mutex, std::lock_guard, 2> {
+  using base = MQTT_NS::endpoint<std::mutex, std::lock_guard, 2>;
+
+public:
+  using async_handler_t = std::function<void(MQTT_NS::error_code)>;
+
+  uds_client_base(boost::asio::io_context &ioc, std::string path,
+                  MQTT_NS::protocol_version version)
+      : base(ioc, version, true), ioc_(ioc), path_(std::move(path)),
+        ping_timer_(ioc) {}
+
+  void set_client_id(std::string id) { client_id_ = std::move(id); }
+  void set_keep_alive_sec(std::uint16_t sec) { keep_alive_sec_ = sec; }
+  void set_clean_session(bool cs) { base::set_clean_start(cs); }
+
+  const std::string &path() const { return path_; }
+
+  void async_connect(async_handler_t func = {}) {
+    async_connect(MQTT_NS::v5::properties{}, std::move(func));
+  }
+
+  void async_connect(MQTT_NS::v5::properties props,
+                     async_handler_t func = {}) {
+    auto socket = std::make_shared<uds_socket>(ioc_);
+    auto &stream = socket->next_layer();
+    stream.async_connect(
+        boost::asio::local::stream_protocol::endpoint(path_),
+        [this, self = this->shared_from_this(), socket,
+         props = std::move(props),
+         func = std::move(func)](boost::system::error_code ec) mutable {
+          if (ec) {
+            if (func) {
+              func(ec);
+            }
+            return;
+          }
+          socket_ = socket;
+          base::set_socket(socket);
+          start_ping_timer(std::chrono::seconds(keep_alive_sec_));
+          base::async_read_control_packet_type(self);
+          base::async_connect(
+              MQTT_NS::allocate_buffer(client_id_.begin(), client_id_.end()),
+              MQTT_NS::nullopt, MQTT_NS::nullopt, MQTT_NS::nullopt,
+              keep_alive_sec_, std::move(props), std::move(func));
+        });
+  }
+
+private:
+  void start_ping_timer(std::chrono::steady_clock::duration after) {
+    if (keep_alive_sec_ == 0) {
+      return;
+    }
+    ping_timer_.expires_after(after);
+    ping_timer_.async_wait(
+        [this, wp = this->weak_from_this()](boost::system::error_code ec) {
+          auto sp = wp.lock();
+          if (ec || !sp || !this->connected()) {
+            return;
+          }
+          // Any packet sent in the meantime kept the connection alive.
+          auto keep_alive = std::chrono::seconds(keep_alive_sec_);
+          auto idle = std::chrono::steady_clock::now() - socket_->last_write();
+          if (idle < keep_alive) {
+            start_ping_timer(keep_alive - idle);
+            return;
+          }
+          base::async_pingreq();
+          start_ping_timer(keep_alive);
+        });
+  }
+
+  boost::asio::io_context &ioc_;
+  std::string path_;
+  std::string client_id_;
+  std::uint16_t keep_alive_sec_ = 0;
+  boost::asio::steady_timer ping_timer_;
+  std::shared_ptr<uds_socket> socket_;
+};
+
+using uds_client = MQTT_NS::callable_overlay<uds_client_base>;
+
+inline std::shared_ptr<uds_client>
+make_uds_client(boost::asio::io_context &ioc, std::string path,
+                MQTT_NS::protocol_version version =
+                    MQTT_NS::protocol_version::v3_1_1) {
+  return std::make_shared<uds_client>(ioc, std::move(path), version);
+}